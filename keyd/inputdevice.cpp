@@ -0,0 +1,280 @@
+/*!
+ * @file inputdevice.cpp
+ * @brief InputDevice and InputDeviceRegistry
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include "inputdevice.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INPUT_DIR "/dev/input"
+
+/* Well-known names of the built-in devices, usually links to an eventN node */
+static const struct {
+    const char *path;
+    InputDevice::DeviceClass deviceClass;
+} deviceAliases[] = {
+    { INPUT_DIR "/gpio-keys", InputDevice::GPIOKeysDevice },
+    { INPUT_DIR "/keypad", InputDevice::KeypadDevice },
+    { INPUT_DIR "/eci", InputDevice::ECIDevice },
+    { INPUT_DIR "/pwrbutton", InputDevice::PowerButtonDevice },
+};
+
+InputDevice::InputDevice(const QByteArray &path) :
+    path(path),
+    deviceClass(GenericDevice),
+    fd(-1),
+    clock(CLOCK_REALTIME),
+    generation(0),
+    dropping(false),
+    discarded(false),
+    notifier(0)
+{
+    memset(events, 0, sizeof(events));
+    memset(keys, 0, sizeof(keys));
+    memset(switches, 0, sizeof(switches));
+}
+
+/* Read the capabilities of the device. They do not change for the
+   lifetime of the device node, so this is done only once. */
+bool InputDevice::probe()
+{
+    int probeFd = open(path.constData(), O_RDONLY | O_NONBLOCK);
+    if (probeFd == -1) {
+        syslog(LOG_WARNING, "Could not open %s for probing\n", path.constData());
+        return false;
+    }
+
+    bool ok = ioctl(probeFd, EVIOCGBIT(0, sizeof(events)), events) != -1;
+    if (ok && test_bit(EV_KEY, events)) {
+        ok = ioctl(probeFd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) != -1;
+    }
+    if (ok && test_bit(EV_SW, events)) {
+        ok = ioctl(probeFd, EVIOCGBIT(EV_SW, sizeof(switches)), switches) != -1;
+    }
+
+    close(probeFd);
+    return ok;
+}
+
+bool InputDevice::hasCode(int type, int code) const
+{
+    if (type == EV_KEY && code >= 0 && code < KEY_MAX) {
+        return test_bit(code, keys);
+    } else if (type == EV_SW && code >= 0 && code < SW_MAX) {
+        return test_bit(code, switches);
+    }
+    return false;
+}
+
+/* Ask the kernel whether the key is down or the switch on */
+bool InputDevice::isActive(int type, int code) const
+{
+    uint8_t bits[KEY_MAX/8 + 1];
+
+    if (fd == -1 || !hasCode(type, code)) {
+        return false;
+    }
+
+    memset(bits, 0, sizeof(bits));
+    if (type == EV_KEY) {
+        ioctl(fd, EVIOCGKEY(sizeof(bits)), bits);
+    } else {
+        ioctl(fd, EVIOCGSW(sizeof(bits)), bits);
+    }
+
+    return !!(bits[code/8] & (1 << (code % 8)));
+}
+
+/* A BT headset reports the media keys, and relative and repeat events */
+bool InputDevice::isHeadset() const
+{
+    if (!(test_bit(EV_SYN, events) && test_bit(EV_REL, events) && test_bit(EV_REP, events))) {
+        return false;
+    }
+
+    return test_bit(EV_KEY, events) &&
+           test_bit(KEY_PAUSECD, keys) && test_bit(KEY_PLAYCD, keys) &&
+           test_bit(KEY_STOPCD, keys) && test_bit(KEY_NEXTSONG, keys) &&
+           test_bit(KEY_FASTFORWARD, keys) && test_bit(KEY_PREVIOUSSONG, keys) &&
+           test_bit(KEY_REWIND, keys);
+}
+
+const char *InputDevice::className() const
+{
+    switch (deviceClass) {
+    case GenericDevice:
+        return "generic";
+    case BluetoothDevice:
+        return "bluetooth";
+    case GPIOKeysDevice:
+        return "gpio keys";
+    case KeypadDevice:
+        return "keypad";
+    case ECIDevice:
+        return "eci";
+    case PowerButtonDevice:
+        return "power button";
+    case DeviceClassCount:
+        break;
+    }
+    return "unknown";
+}
+
+InputDeviceRegistry::InputDeviceRegistry()
+{
+    memset(supportedKeys, 0, sizeof(supportedKeys));
+    memset(supportedSwitches, 0, sizeof(supportedSwitches));
+}
+
+InputDeviceRegistry::~InputDeviceRegistry()
+{
+    qDeleteAll(deviceList);
+}
+
+void InputDeviceRegistry::setSupported(int type, int code)
+{
+    if (type == EV_KEY && code >= 0 && code < KEY_MAX) {
+        supportedKeys[LONG(code)] |= BIT(code);
+    } else if (type == EV_SW && code >= 0 && code < SW_MAX) {
+        supportedSwitches[LONG(code)] |= BIT(code);
+    }
+}
+
+/* Probe everything already in /dev/input, returns the devices found */
+QList<InputDevice*> InputDeviceRegistry::scan()
+{
+    QList<InputDevice*> found;
+    DIR *dir = opendir(INPUT_DIR);
+    struct dirent *entry;
+
+    if (!dir) {
+        syslog(LOG_WARNING, "Could not scan %s\n", INPUT_DIR);
+        return found;
+    }
+
+    while ((entry = readdir(dir)) != 0) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        QByteArray path = QByteArray(INPUT_DIR "/") + entry->d_name;
+        InputDevice *device = add(path.constData());
+        if (device) {
+            found.append(device);
+        }
+    }
+
+    closedir(dir);
+    return found;
+}
+
+/* Register the device behind path, which may be a well-known alias of a
+   device that is already registered. Returns the device if it is new and
+   reports a supported key or switch, 0 otherwise. */
+InputDevice *InputDeviceRegistry::add(const char *path)
+{
+    char realPath[PATH_MAX];
+    struct stat st;
+
+    if (!realpath(path, realPath) || stat(realPath, &st) != 0 || !S_ISCHR(st.st_mode)) {
+        return 0;
+    }
+
+    InputDevice *device = find(realPath);
+    if (device) {
+        /* A link created after the device node */
+        device->deviceClass = classify(device);
+        return 0;
+    }
+
+    device = new InputDevice(realPath);
+    if (!device->probe() || !isUseful(device)) {
+        delete device;
+        return 0;
+    }
+
+    device->deviceClass = classify(device);
+    deviceList.append(device);
+    return device;
+}
+
+/* Unregister the device node at path. The caller closes and deletes the device. */
+InputDevice *InputDeviceRegistry::take(const char *path)
+{
+    InputDevice *device = find(path);
+    if (device) {
+        deviceList.removeOne(device);
+    }
+    return device;
+}
+
+InputDevice *InputDeviceRegistry::find(const QByteArray &path) const
+{
+    foreach (InputDevice *device, deviceList) {
+        if (device->path == path) {
+            return device;
+        }
+    }
+    return 0;
+}
+
+InputDevice::DeviceClass InputDeviceRegistry::classify(const InputDevice *device) const
+{
+    char realPath[PATH_MAX];
+
+    for (unsigned int i = 0; i < sizeof(deviceAliases) / sizeof(deviceAliases[0]); i++) {
+        if (realpath(deviceAliases[i].path, realPath) && device->path == realPath) {
+            return deviceAliases[i].deviceClass;
+        }
+    }
+
+    if (device->isHeadset()) {
+        return InputDevice::BluetoothDevice;
+    }
+    return InputDevice::GenericDevice;
+}
+
+/* Only devices that can report a key or switch a client may care about are kept */
+bool InputDeviceRegistry::isUseful(const InputDevice *device) const
+{
+    for (unsigned int i = 0; i < NBITS(KEY_MAX); i++) {
+        if (device->keys[i] & supportedKeys[i]) {
+            return true;
+        }
+    }
+    for (unsigned int i = 0; i < NBITS(SW_MAX); i++) {
+        if (device->switches[i] & supportedSwitches[i]) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+/*!
+ * @file inputdevice.h
+ * @brief InputDevice and InputDeviceRegistry
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef INPUTDEVICE_H
+#define INPUTDEVICE_H
+
+#include <QByteArray>
+#include <QList>
+
+#include <linux/input.h>
+#include <time.h>
+
+#define BITS_PER_LONG (sizeof(long) * 8)
+#define NBITS(x) ((((x)-1)/BITS_PER_LONG)+1)
+#define OFF(x)  ((x)%BITS_PER_LONG)
+#define BIT(x)  (1UL<<OFF(x))
+#define LONG(x) ((x)/BITS_PER_LONG)
+#define test_bit(bit, array)	((array[LONG(bit)] >> OFF(bit)) & 1)
+
+class QSocketNotifier;
+
+/*
+ * An evdev device under /dev/input, with the capabilities it reported
+ * when it appeared. The device is open only while qmkeyd has clients.
+ */
+class InputDevice
+{
+public:
+    enum DeviceClass
+    {
+        GenericDevice,
+        BluetoothDevice,
+        GPIOKeysDevice,
+        KeypadDevice,
+        /*
+         * Enhancement Control Interface device, for example
+         * a multimedia headset accessory
+         */
+        ECIDevice,
+        PowerButtonDevice,
+        DeviceClassCount
+    };
+
+    InputDevice(const QByteArray &path);
+
+    bool probe();
+    bool hasCode(int type, int code) const;
+    bool isActive(int type, int code) const;
+    bool isHeadset() const;
+    const char *className() const;
+
+    QByteArray path;
+    DeviceClass deviceClass;
+    int fd;                         /* -1 while the device is closed */
+    clockid_t clock;                /* clock of the event timestamps */
+    unsigned int generation;        /* of its records in the InputReader ring */
+    bool dropping;                  /* discarding up to a SYN_REPORT */
+    bool discarded;                 /* a key or switch event since */
+    QSocketNotifier *notifier;      /* only used without epoll */
+
+    unsigned long events[NBITS(EV_MAX)];
+    unsigned long keys[NBITS(KEY_MAX)];
+    unsigned long switches[NBITS(SW_MAX)];
+};
+
+/*
+ * The input devices that report at least one supported key or switch.
+ * /dev/input is scanned once at startup, after that the registry is kept
+ * up to date from the inotify events qmkeyd receives for the directory.
+ */
+class InputDeviceRegistry
+{
+public:
+    InputDeviceRegistry();
+    ~InputDeviceRegistry();
+
+    void setSupported(int type, int code);
+    bool isSupported(int type, int code) const
+    {
+        if (type == EV_KEY && code >= 0 && code < KEY_MAX) {
+            return test_bit(code, supportedKeys);
+        } else if (type == EV_SW && code >= 0 && code < SW_MAX) {
+            return test_bit(code, supportedSwitches);
+        }
+        return false;
+    }
+
+    QList<InputDevice*> scan();
+    InputDevice *add(const char *path);
+    InputDevice *take(const char *path);
+    const QList<InputDevice*> &devices() const { return deviceList; }
+
+private:
+    InputDevice *find(const QByteArray &path) const;
+    InputDevice::DeviceClass classify(const InputDevice *device) const;
+    bool isUseful(const InputDevice *device) const;
+
+    QList<InputDevice*> deviceList;
+
+    unsigned long supportedKeys[NBITS(KEY_MAX)];
+    unsigned long supportedSwitches[NBITS(SW_MAX)];
+};
+
+#endif // INPUTDEVICE_H
@@ -0,0 +1,279 @@
+/*!
+ * @file inputreader.cpp
+ * @brief InputReader
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include "inputreader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/* Maximum number of ready descriptors taken from epoll at a time */
+#define READER_MAX_EVENTS 16
+
+/* Events read from a device with a single read */
+#define READER_CHUNK 64
+
+static int nonBlockingEventFd()
+{
+    int fd = eventfd(0, 0);
+    if (fd != -1) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd;
+}
+
+InputReader::InputReader() :
+    epollFd(-1), eventFd(-1), stopFd(-1),
+    nextGeneration(0),
+    head(0), tail(0),
+    dropped(0)
+{
+    epollFd = epoll_create(READER_MAX_EVENTS);
+    eventFd = nonBlockingEventFd();
+    stopFd = nonBlockingEventFd();
+
+    if (epollFd != -1 && stopFd != -1) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = stopFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev) == -1) {
+            close(epollFd), epollFd = -1;
+        }
+    }
+}
+
+InputReader::~InputReader()
+{
+    stop();
+
+    if (epollFd != -1) {
+        close(epollFd), epollFd = -1;
+    }
+    if (eventFd != -1) {
+        close(eventFd), eventFd = -1;
+    }
+    if (stopFd != -1) {
+        close(stopFd), stopFd = -1;
+    }
+}
+
+bool InputReader::isValid() const
+{
+    return epollFd != -1 && eventFd != -1 && stopFd != -1;
+}
+
+/* Returns the generation the records of the device carry */
+unsigned int InputReader::addDevice(int fd)
+{
+    QMutexLocker locker(&deviceLock);
+
+    unsigned int generation = ++nextGeneration;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        syslog(LOG_WARNING, "Could not add a device to the reader: %s\n", strerror(errno));
+        return generation;
+    }
+    deviceGenerations.insert(fd, generation);
+    return generation;
+}
+
+/* Once this returns, the reader no longer touches fd and it may be closed */
+void InputReader::removeDevice(int fd)
+{
+    QMutexLocker locker(&deviceLock);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &ev);
+    deviceGenerations.remove(fd);
+    overflowedFds.remove(fd);
+}
+
+/* Called by the main loop before it takes the records, so that records
+   pushed after take() wake it up again */
+void InputReader::acknowledge()
+{
+    uint64_t count;
+    if (read(eventFd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        syslog(LOG_WARNING, "Reader wakeup read: %s\n", strerror(errno));
+    }
+}
+
+/* Consumer side of the ring, only called by the main loop */
+int InputReader::take(InputRecord *records, int max)
+{
+    unsigned int available = head - tail;
+    int count = 0;
+
+    /* Read the records only after seeing the head that published them */
+    __sync_synchronize();
+
+    while (count < max && available > 0) {
+        records[count++] = ring[tail & (READER_RING_SIZE - 1)];
+        available--;
+        /* Hand the slot back only after the copy is done */
+        __sync_synchronize();
+        tail = tail + 1;
+    }
+    return count;
+}
+
+void InputReader::stop()
+{
+    if (isRunning()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) != sizeof(one)) {
+            syslog(LOG_WARNING, "Could not stop the reader: %s\n", strerror(errno));
+            return;
+        }
+        wait();
+    }
+}
+
+void InputReader::run()
+{
+    struct epoll_event events[READER_MAX_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(epollFd, events, READER_MAX_EVENTS, -1);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_WARNING, "Reader epoll_wait: %s\n", strerror(errno));
+            return;
+        }
+
+        bool pushed = false;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == stopFd) {
+                return;
+            }
+
+            /* Generations start from one */
+            QMutexLocker locker(&deviceLock);
+            unsigned int generation = deviceGenerations.value(events[i].data.fd);
+            if (generation) {
+                pushed |= readDevice(events[i].data.fd, generation);
+            }
+        }
+
+        if (pushed) {
+            uint64_t one = 1;
+            if (write(eventFd, &one, sizeof(one)) != sizeof(one)) {
+                syslog(LOG_WARNING, "Could not wake up the main loop: %s\n", strerror(errno));
+            }
+        }
+    }
+}
+
+/* Producer side of the ring, returns false if the ring is full */
+bool InputReader::push(int fd, unsigned int generation, const struct input_event &ev)
+{
+    if (head - tail == READER_RING_SIZE) {
+        return false;
+    }
+
+    InputRecord &record = ring[head & (READER_RING_SIZE - 1)];
+    record.fd = fd;
+    record.generation = generation;
+    record.ev = ev;
+
+    /* Publish the head only after the record is complete */
+    __sync_synchronize();
+    head = head + 1;
+    return true;
+}
+
+/* Drains the device. Once an event has not fit in the ring, the rest of
+   the packet is worthless, and a SYN_DROPPED goes before the packet end. */
+bool InputReader::readDevice(int fd, unsigned int generation)
+{
+    struct input_event events[READER_CHUNK];
+    struct input_event marker;
+    bool overflow = overflowedFds.contains(fd);
+    bool pushed = false;
+
+    for (;;) {
+        int ret = read(fd, events, sizeof(events));
+        if (ret <= 0) {
+            break;
+        }
+
+        int count = ret / sizeof(struct input_event);
+        for (int i = 0; i < count; i++) {
+            const struct input_event &ev = events[i];
+
+            if (overflow) {
+                if (ev.type == EV_SYN && ev.code == SYN_REPORT && hasRoom(2)) {
+                    marker = ev;
+                    marker.code = SYN_DROPPED;
+                    push(fd, generation, marker);
+                    push(fd, generation, ev);
+                    overflow = false;
+                    pushed = true;
+                } else {
+                    dropped++;
+                }
+                continue;
+            }
+
+            if (!push(fd, generation, ev)) {
+                dropped++;
+                overflow = true;
+                continue;
+            }
+            pushed = true;
+        }
+    }
+
+    /* Nothing more is coming for now, the states can be read right away.
+       The rest of the packet is discarded by the main loop when it comes. */
+    if (overflow) {
+        memset(&marker, 0, sizeof(marker));
+        marker.type = EV_SYN;
+        marker.code = SYN_DROPPED;
+        overflow = !push(fd, generation, marker);
+        pushed |= !overflow;
+    }
+
+    if (overflow) {
+        overflowedFds.insert(fd);
+    } else {
+        overflowedFds.remove(fd);
+    }
+    return pushed;
+}
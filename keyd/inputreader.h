@@ -0,0 +1,105 @@
+/*!
+ * @file inputreader.h
+ * @brief InputReader
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef INPUTREADER_H
+#define INPUTREADER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QThread>
+
+#include <linux/input.h>
+
+#ifndef SYN_DROPPED
+#define SYN_DROPPED 3
+#endif
+
+/* Number of events the ring holds, must be a power of two */
+#define READER_RING_SIZE 1024
+
+struct InputRecord
+{
+    int fd;
+    unsigned int generation;    /* of the device, see InputReader::addDevice() */
+    struct input_event ev;
+};
+
+/*
+ * Reads the input devices on a thread of its own, so that the kernel
+ * buffers are emptied even while the main loop is busy with clients.
+ * The events are handed to the main loop through a lock-free ring with
+ * a single producer, the reader thread, and a single consumer, the main
+ * loop, which is woken up through wakeupFd().
+ *
+ * When the ring is full the reader drops the events of the device up to
+ * the end of a packet, and puts an EV_SYN/SYN_DROPPED before the packet
+ * end, as the kernel does when its own buffer overflows. As with the
+ * kernel, the main loop discards the events after a SYN_DROPPED up to
+ * the next SYN_REPORT, and reads the key states of the device again.
+ *
+ * The records still in the ring when a device is removed carry its
+ * descriptor, which a device added later may get. Each addition of a
+ * descriptor is therefore a new generation, which the records carry.
+ */
+class InputReader : public QThread
+{
+public:
+    InputReader();
+    ~InputReader();
+
+    bool isValid() const;
+    int wakeupFd() const { return eventFd; }
+
+    unsigned int addDevice(int fd);
+    void removeDevice(int fd);
+
+    void acknowledge();
+    int take(InputRecord *records, int max);
+    void stop();
+
+    unsigned long droppedEvents() const { return dropped; }
+
+protected:
+    void run();
+
+private:
+    bool readDevice(int fd, unsigned int generation);
+    bool push(int fd, unsigned int generation, const struct input_event &ev);
+    bool hasRoom(unsigned int count) const { return READER_RING_SIZE - (head - tail) >= count; }
+
+    int epollFd, eventFd, stopFd;
+
+    /* Held by the reader while it reads, and by the main loop while it
+       removes a device, so that a descriptor is never read after close */
+    QMutex deviceLock;
+    QHash<int, unsigned int> deviceGenerations;
+    unsigned int nextGeneration;
+    QSet<int> overflowedFds;    /* devices waiting for their SYN_DROPPED */
+
+    InputRecord ring[READER_RING_SIZE];
+    volatile unsigned int head;     /* written by the reader only */
+    volatile unsigned int tail;     /* written by the main loop only */
+    unsigned long dropped;
+};
+
+#endif // INPUTREADER_H
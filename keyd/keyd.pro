@@ -10,9 +10,17 @@ CONFIG -= app_bundle
 TEMPLATE = app
 SOURCES += main.cpp \
     qmkeyd.cpp \
+    inputdevice.cpp \
+    inputreader.cpp \
+    keymap.cpp \
     keytranslator.cpp
 HEADERS += qmkeyd.h \
-    keytranslator.h
+    inputdevice.h \
+    inputreader.h \
+    keymap.h \
+    keytranslator.h \
+    ../system/qmkeydprotocol_p.h
+INCLUDEPATH += ../system
 LIBS += -lrt
 
 target.path = $$(DESTDIR)/usr/sbin
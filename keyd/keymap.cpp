@@ -0,0 +1,341 @@
+/*!
+ * @file keymap.cpp
+ * @brief KeyMap
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include "keymap.h"
+
+#include <QMap>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qmkeydprotocol_p.h"
+
+const static int    defaultLongPressThresholdInMs = 1000;
+const static int    defaultDoublePressWindowInMs  = 300;
+
+static const struct {
+    const char *name;
+    int deviceClass;
+} classNames[] = {
+    { "any", KEYMAP_ANY_CLASS },
+    { "generic", InputDevice::GenericDevice },
+    { "bluetooth", InputDevice::BluetoothDevice },
+    { "gpio-keys", InputDevice::GPIOKeysDevice },
+    { "keypad", InputDevice::KeypadDevice },
+    { "eci", InputDevice::ECIDevice },
+    { "pwrbutton", InputDevice::PowerButtonDevice },
+};
+
+static const char *pressNames[] = { "short", "long", "double" };
+
+static const struct {
+    const char *name;
+    __u16 code;
+} keyNames[] = {
+    { "CAMERA", KEY_CAMERA },
+    { "CAMERA_FOCUS", KEY_CAMERA_FOCUS },
+    { "VOLUMEUP", KEY_VOLUMEUP },
+    { "VOLUMEDOWN", KEY_VOLUMEDOWN },
+    { "PHONE", KEY_PHONE },
+    { "PLAYPAUSE", KEY_PLAYPAUSE },
+    { "STOP", KEY_STOP },
+    { "STOPCD", KEY_STOPCD },
+    { "FORWARD", KEY_FORWARD },
+    { "FASTFORWARD", KEY_FASTFORWARD },
+    { "REWIND", KEY_REWIND },
+    { "MUTE", KEY_MUTE },
+    { "LEFT", KEY_LEFT },
+    { "RIGHT", KEY_RIGHT },
+    { "UP", KEY_UP },
+    { "DOWN", KEY_DOWN },
+    { "END", KEY_END },
+    { "NEXTSONG", KEY_NEXTSONG },
+    { "PREVIOUSSONG", KEY_PREVIOUSSONG },
+    { "PAUSECD", KEY_PAUSECD },
+    { "PLAYCD", KEY_PLAYCD },
+    { "RIGHTCTRL", KEY_RIGHTCTRL },
+    { "POWER", KEY_POWER },
+    { "MEDIA", KEY_MEDIA },
+    { "PLAY", KEY_PLAY },
+    { "PAUSE", KEY_PAUSE },
+    { "SEND", KEY_SEND },
+    { "CLOSECD", KEY_CLOSECD },
+    { "EJECTCD", KEY_EJECTCD },
+};
+
+/* Translations used when there is no table */
+static const struct keymap_rule defaultRules[] = {
+    { InputDevice::ECIDevice, SHORT_PRESS, KEY_FORWARD, KEY_NEXTSONG, 0 },
+    { InputDevice::ECIDevice, LONG_PRESS, KEY_FORWARD, KEY_FORWARD, 0 },
+    { InputDevice::ECIDevice, SHORT_PRESS, KEY_REWIND, KEY_PREVIOUSSONG, 0 },
+    { InputDevice::ECIDevice, LONG_PRESS, KEY_REWIND, KEY_REWIND, 0 },
+};
+
+static int parseClass(const char *name)
+{
+    for (unsigned int i = 0; i < sizeof(classNames) / sizeof(classNames[0]); i++) {
+        if (!strcmp(classNames[i].name, name)) {
+            return classNames[i].deviceClass;
+        }
+    }
+    return -1;
+}
+
+static int parsePress(const char *name)
+{
+    for (unsigned int i = 0; i < sizeof(pressNames) / sizeof(pressNames[0]); i++) {
+        if (!strcmp(pressNames[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int parseKey(const char *name)
+{
+    char *end = 0;
+    long code;
+
+    for (unsigned int i = 0; i < sizeof(keyNames) / sizeof(keyNames[0]); i++) {
+        if (!strcmp(keyNames[i].name, name)) {
+            return keyNames[i].code;
+        }
+    }
+
+    code = strtol(name, &end, 0);
+    if (*name == '\0' || *end != '\0' || code <= 0 || code >= KEY_MAX) {
+        return -1;
+    }
+    return code;
+}
+
+KeyMap::KeyMap()
+{
+    memset(index, 0xff, sizeof(index));
+}
+
+/* Map the table and index it. Returns false if there is no usable table. */
+bool KeyMap::load(const char *path)
+{
+    struct stat st;
+    void *map;
+    bool ok = false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct keymap_header)) {
+        syslog(LOG_WARNING, "Invalid key map %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        syslog(LOG_WARNING, "Could not map %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    const struct keymap_header *header = (const struct keymap_header *)map;
+    const struct keymap_rule *rules = (const struct keymap_rule *)(header + 1);
+
+    if (header->magic == KEYMAP_MAGIC && header->version == KEYMAP_VERSION &&
+        st.st_size == (off_t)(sizeof(*header) + header->count * sizeof(*rules))) {
+        ok = true;
+        for (int i = 0; ok && i < header->count; i++) {
+            ok = (rules[i].deviceClass < InputDevice::DeviceClassCount ||
+                  rules[i].deviceClass == KEYMAP_ANY_CLASS) &&
+                 rules[i].press <= DOUBLE_PRESS &&
+                 rules[i].code < KEY_MAX && rules[i].output < KEY_MAX;
+        }
+    }
+
+    if (ok) {
+        build(rules, header->count);
+    } else {
+        syslog(LOG_WARNING, "Invalid key map %s\n", path);
+    }
+
+    munmap(map, st.st_size);
+    return ok;
+}
+
+void KeyMap::loadDefaults()
+{
+    build(defaultRules, sizeof(defaultRules) / sizeof(defaultRules[0]));
+}
+
+/* Collect the rules of each key of each class into an entry, and index
+   the entries by class and key code */
+void KeyMap::build(const struct keymap_rule *rules, int count)
+{
+    QMap<quint32, Entry> entries;
+
+    for (int i = 0; i < count; i++) {
+        const struct keymap_rule &rule = rules[i];
+        quint32 key = (rule.deviceClass << 16) | rule.code;
+
+        if (!entries.contains(key)) {
+            Entry entry;
+            entry.deviceClass = rule.deviceClass;
+            entry.code = rule.code;
+            entry.shortPressKey = rule.code;
+            entry.longPressKey = 0;
+            entry.doublePressKey = 0;
+            entry.longPressThreshold = defaultLongPressThresholdInMs;
+            entry.doublePressWindow = defaultDoublePressWindowInMs;
+            entries.insert(key, entry);
+        }
+
+        Entry &entry = entries[key];
+        switch (rule.press) {
+        case SHORT_PRESS:
+            entry.shortPressKey = rule.output;
+            break;
+        case LONG_PRESS:
+            entry.longPressKey = rule.output;
+            if (rule.time) {
+                entry.longPressThreshold = rule.time;
+            }
+            break;
+        case DOUBLE_PRESS:
+            entry.doublePressKey = rule.output;
+            if (rule.time) {
+                entry.doublePressWindow = rule.time;
+            }
+            break;
+        }
+    }
+
+    entryList.clear();
+    memset(index, 0xff, sizeof(index));
+
+    /* The entries of the classes first, then class any where they left gaps */
+    foreach (const Entry &entry, entries) {
+        if (entry.deviceClass != KEYMAP_ANY_CLASS) {
+            index[entry.deviceClass][entry.code] = entryList.count();
+            entryList.append(entry);
+        }
+    }
+    foreach (const Entry &any, entries) {
+        if (any.deviceClass != KEYMAP_ANY_CLASS) {
+            continue;
+        }
+        for (int deviceClass = 0; deviceClass < InputDevice::DeviceClassCount; deviceClass++) {
+            if (index[deviceClass][any.code] == -1) {
+                Entry entry = any;
+                entry.deviceClass = deviceClass;
+                index[deviceClass][entry.code] = entryList.count();
+                entryList.append(entry);
+            }
+        }
+    }
+}
+
+/* Compile the text rules of source into the binary table target */
+bool KeyMap::compile(const char *source, const char *target)
+{
+    QVector<struct keymap_rule> rules;
+    char line[256];
+    int lineNumber = 0;
+
+    FILE *in = fopen(source, "r");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", source, strerror(errno));
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        char className[32], keyName[32], pressName[32], outputName[32];
+        unsigned int time = 0;
+
+        lineNumber++;
+
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') {
+            continue;
+        }
+
+        int fields = sscanf(start, "%31s %31s %31s %31s %u", className, keyName, pressName, outputName, &time);
+
+        struct keymap_rule rule;
+        int deviceClass = fields >= 4 ? parseClass(className) : -1;
+        int code = fields >= 4 ? parseKey(keyName) : -1;
+        int press = fields >= 4 ? parsePress(pressName) : -1;
+        int output = fields >= 4 ? parseKey(outputName) : -1;
+
+        if (deviceClass == -1 || code == -1 || press == -1 || output == -1 || time > 0xffff) {
+            fprintf(stderr, "%s:%d: invalid rule\n", source, lineNumber);
+            fclose(in);
+            return false;
+        }
+
+        rule.deviceClass = deviceClass;
+        rule.press = press;
+        rule.code = code;
+        rule.output = output;
+        rule.time = time;
+        rules.append(rule);
+    }
+    fclose(in);
+
+    if (rules.count() > 0xffff) {
+        fprintf(stderr, "%s: too many rules\n", source);
+        return false;
+    }
+
+    struct keymap_header header;
+    header.magic = KEYMAP_MAGIC;
+    header.version = KEYMAP_VERSION;
+    header.count = rules.count();
+
+    /* Replace the table atomically, qmkeyd may be reading it */
+    QByteArray temp = QByteArray(target) + ".tmp";
+    FILE *out = fopen(temp.constData(), "w");
+    if (!out) {
+        fprintf(stderr, "%s: %s\n", temp.constData(), strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              (rules.isEmpty() || fwrite(rules.constData(), sizeof(struct keymap_rule), rules.count(), out) == (size_t)rules.count());
+    ok = (fclose(out) == 0) && ok;
+
+    if (!ok || rename(temp.constData(), target) != 0) {
+        fprintf(stderr, "%s: %s\n", target, strerror(errno));
+        unlink(temp.constData());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,122 @@
+/*!
+ * @file keymap.h
+ * @brief KeyMap
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <QVector>
+
+#include <linux/types.h>
+#include <linux/input.h>
+
+#include "inputdevice.h"
+
+/*
+ * The key translations are read from a binary table, which is compiled
+ * from a text file with "qmkeyd2 -c keymap.conf keymap.bin". Each line of
+ * the text file is a rule
+ *
+ *     <class> <key> <press> <output> [<ms>]
+ *
+ * where class is one of any, generic, bluetooth, gpio-keys, keypad, eci
+ * or pwrbutton, key and output are key names without the KEY_ prefix or
+ * key codes, and press is short, long or double. ms is the long press
+ * threshold of a long rule, or the double press window of a double rule.
+ * Lines starting with # are comments. Rules of a class override the
+ * rules of class any for the same key.
+ *
+ * Without the table, the ECI REWIND and FORWARD keys are translated to
+ * PREVIOUSSONG and NEXTSONG on a short press.
+ */
+#define KEYMAP_PATH "/etc/qmkeyd2/keymap.bin"
+
+#define KEYMAP_MAGIC 0x716b6d70
+#define KEYMAP_VERSION 1
+#define KEYMAP_ANY_CLASS 0xff
+
+enum KeyMapPress {
+    SHORT_PRESS,
+    LONG_PRESS,
+    DOUBLE_PRESS
+};
+
+struct keymap_header
+{
+    __u32 magic;
+    __u16 version;
+    __u16 count;        /* number of struct keymap_rule following */
+};
+
+/* The rules are in the order of the text file. qmkeyd reads them once,
+   into the entries and index of KeyMap, and does not keep the table
+   mapped. A later rule for the same class, key and press overrides an
+   earlier one. */
+struct keymap_rule
+{
+    __u8 deviceClass;   /* InputDevice::DeviceClass or KEYMAP_ANY_CLASS */
+    __u8 press;         /* KeyMapPress */
+    __u16 code;
+    __u16 output;
+    __u16 time;         /* in milliseconds, zero for the default */
+};
+
+class KeyMap
+{
+public:
+    /* The translation of one key of one device class */
+    struct Entry
+    {
+        int deviceClass;
+        __u16 code;
+        __u16 shortPressKey;
+        __u16 longPressKey;
+        __u16 doublePressKey;
+        int longPressThreshold;
+        int doublePressWindow;
+    };
+
+    KeyMap();
+
+    bool load(const char *path);
+    void loadDefaults();
+    static bool compile(const char *source, const char *target);
+
+    /* Returns the index of the entry of the key, or -1 if it is not translated */
+    int lookup(int deviceClass, int code) const
+    {
+        if (deviceClass < 0 || deviceClass >= InputDevice::DeviceClassCount ||
+            code < 0 || code >= KEY_MAX) {
+            return -1;
+        }
+        return index[deviceClass][code];
+    }
+
+    const QVector<Entry> &entries() const { return entryList; }
+
+private:
+    void build(const struct keymap_rule *rules, int count);
+
+    QVector<Entry> entryList;
+    qint16 index[InputDevice::DeviceClassCount][KEY_MAX];
+};
+
+#endif // KEYMAP_H
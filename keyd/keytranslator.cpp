@@ -26,26 +26,76 @@
 #include "keytranslator.h"
 
 #include <sys/time.h>
+#include <sys/timerfd.h>
 
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <syslog.h>
+#include <unistd.h>
 
-const static bool   debug                = false;
-const static int    longPressTimeoutInMs = 1000;
+const static bool   debug                      = false;
+const static int    defaultLongPressThresholdInMs = 1000;
+const static int    defaultDoublePressWindowInMs  = 300;
 
 KeyTranslator::KeyTranslator(QObject *parent) :
     QObject(parent),
-    state(WAIT_FOR_KEYPRESS)
+    state(WAIT_FOR_KEYPRESS),
+    clock(-1),
+    timerFd(-1),
+    timerNotifier(0),
+    shortPressKey(0),
+    longPressKey(0),
+    doublePressKey(0),
+    longPressThreshold(defaultLongPressThresholdInMs),
+    doublePressWindow(defaultDoublePressWindowInMs)
 {
-    longPressTimer.setSingleShot(true);
-    connect(&longPressTimer, SIGNAL(timeout()), this, SLOT(longPressTimeout()));
+    memset(&pressTime, 0, sizeof pressTime);
+    memset(&releaseTime, 0, sizeof releaseTime);
+    memset(&deadline, 0, sizeof deadline);
+
+    setClock(CLOCK_MONOTONIC);
 }
 
 KeyTranslator::~KeyTranslator()
 {
+    setClock(-1);
+}
+
+/* The deadline timer has to run on the clock the kernel stamps the events with */
+void KeyTranslator::setClock(clockid_t eventClock)
+{
+    if (eventClock == clock) {
+        return;
+    }
+
+    if (timerFd != -1) {
+        delete timerNotifier, timerNotifier = 0;
+        close(timerFd), timerFd = -1;
+    }
+
+    clock = eventClock;
+    if (clock == (clockid_t)-1) {
+        return;
+    }
+
+    timerFd = timerfd_create(clock, TFD_NONBLOCK);
+    if (timerFd == -1) {
+        syslog(LOG_WARNING, "Could not create a long press timer: %s\n", strerror(errno));
+        return;
+    }
+
+    timerNotifier = new QSocketNotifier(timerFd, QSocketNotifier::Read, this);
+    connect(timerNotifier, SIGNAL(activated(int)), this, SLOT(deadlineExpired()));
+
+    /* A deadline of the old clock means nothing on the new one */
+    if (state == WAIT_FOR_LONG_PRESS || state == WAIT_FOR_DOUBLE_PRESS) {
+        armTimer();
+    }
 }
 
-void KeyTranslator::handleEvent(struct input_event &ev)
+void KeyTranslator::handleEvent(const struct input_event &ev, clockid_t eventClock)
 {
     if (debug) {
         syslog(LOG_DEBUG,
@@ -57,94 +107,181 @@ void KeyTranslator::handleEvent(struct input_event &ev)
                ev.value);
     }
 
+    if (!longPressKey && !doublePressKey) {
+        /* a plain remapping, repeats included */
+        emitKey(shortPressKey, ev.value, ev.time);
+        return;
+    }
+
+    setClock(eventClock);
+
+    /* an event at or past the deadline settles the pending press first,
+       even if the timer has not been serviced yet */
+    checkDeadline(ev.time);
+
     if (ev.value == 1) {
-        state = WAIT_FOR_LONG_PRESS;
-        handleKeyDown();
+        handleKeyDown(ev.time);
     } else if (ev.value == 2) {
-        /* ignore key repeats */
+        /* key repeats are not translated */
     } else if (ev.value == 0) {
-        handleKeyUp();
-        state = WAIT_FOR_KEYPRESS;
+        handleKeyUp(ev.time);
     }
 }
 
-void KeyTranslator::handleKeyDown()
+void KeyTranslator::handleKeyDown(const struct timeval &time)
 {
-    if (longPressTimer.isActive()) {
-        /* this should never happen, as we should get KeyUp
-           before KeyDown, but let's make sure */
-        longPressTimer.stop();
+    if (state == WAIT_FOR_DOUBLE_PRESS) {
+        /* pressed again within the window */
+        disarmTimer();
+        state = DOUBLE_PRESS_DETECTED;
+        emitKey(doublePressKey, 1, time);
+        return;
     }
 
-    longPressTimer.start(longPressTimeoutInMs);
+    /* a second KeyDown without KeyUp in between should never happen,
+       simply start over from the latest one */
+    pressTime = time;
+    state = WAIT_FOR_LONG_PRESS;
+
+    if (longPressKey) {
+        setDeadline(pressTime, longPressThreshold);
+    } else {
+        disarmTimer();
+    }
 
     if (debug) {
         syslog(LOG_DEBUG,
-               "handleKeyDown");
+               "handleKeyDown, deadline=%ld.%06ld", deadline.tv_sec, deadline.tv_usec);
     }
 }
 
-void KeyTranslator::handleKeyUp()
+void KeyTranslator::handleKeyUp(const struct timeval &time)
 {
-    struct input_event keyDownEvent, keyUpEvent;
+    disarmTimer();
+
+    if (state == WAIT_FOR_LONG_PRESS && doublePressKey) {
+        /* released before the deadline, wait for a second press before
+           deciding this was a short press */
+        releaseTime = time;
+        state = WAIT_FOR_DOUBLE_PRESS;
+        setDeadline(releaseTime, doublePressWindow);
+        return;
+    }
 
-    memset(&keyDownEvent, 0, sizeof keyDownEvent);
-    memset(&keyUpEvent, 0, sizeof keyUpEvent);
+    if (state == WAIT_FOR_LONG_PRESS) {
+        /* released before the deadline, so this was a short press:
+           send the KeyDown event with the time of the press */
+        emitKey(shortPressKey, 1, pressTime);
+    }
 
-    if (longPressTimer.isActive()) {
-        /* long press timer is still running,
-           so this was a short press */
-        longPressTimer.stop();
+    /* now send the KeyUp event */
+    if (state == LONG_PRESS_DETECTED) {
+        emitKey(longPressKey, 0, time);
+    } else if (state == DOUBLE_PRESS_DETECTED) {
+        emitKey(doublePressKey, 0, time);
+    } else {
+        emitKey(shortPressKey, 0, time);
+    }
 
-        /* since this was a short press, send the KeyDown
-           event */
-        keyDownEvent.time = monotime();
-        keyDownEvent.type = EV_KEY;
-        keyDownEvent.code = shortPressKey;
-        keyDownEvent.value = 1;
+    state = WAIT_FOR_KEYPRESS;
+}
 
-        emit keyTranslated(keyDownEvent);
+bool KeyTranslator::checkDeadline(const struct timeval &now)
+{
+    if (timercmp(&now, &deadline, <)) {
+        return false;
     }
 
-    /* now send the KeyUp event */
-    keyUpEvent.time = monotime();
-    keyUpEvent.type = EV_KEY;
-    keyUpEvent.code = (state == LONG_PRESS_DETECTED ? longPressKey : shortPressKey);
-    keyUpEvent.value = 0;
+    if (state == WAIT_FOR_LONG_PRESS && longPressKey) {
+        disarmTimer();
+
+        /* long press detected, send the KeyDown event with the time
+           the press became long */
+        emitKey(longPressKey, 1, deadline);
+
+        state = LONG_PRESS_DETECTED;
+        return true;
+    } else if (state == WAIT_FOR_DOUBLE_PRESS) {
+        disarmTimer();
 
-    emit keyTranslated(keyUpEvent);
+        /* no second press came, so the first one was a short press */
+        emitKey(shortPressKey, 1, pressTime);
+        emitKey(shortPressKey, 0, releaseTime);
+
+        state = WAIT_FOR_KEYPRESS;
+        return true;
+    }
+    return false;
 }
 
-void KeyTranslator::longPressTimeout()
+void KeyTranslator::deadlineExpired()
 {
-    struct input_event keyDownEvent;
+    uint64_t expirations;
+    struct timespec ts;
+    struct timeval now;
 
-    memset(&keyDownEvent, 0, sizeof keyDownEvent);
+    if (read(timerFd, &expirations, sizeof expirations) != sizeof expirations) {
+        return;
+    }
 
-    if (state != WAIT_FOR_LONG_PRESS) {
-       /* we shouldn't have an active timer if
-          we are not waiting for a long press */
-       return;
+    if (clock_gettime(clock, &ts) != 0) {
+        return;
     }
+    TIMESPEC_TO_TIMEVAL(&now, &ts);
 
-    /* long press detected, send the KeyDown event */
-    keyDownEvent.time = monotime();
-    keyDownEvent.type = EV_KEY;
-    keyDownEvent.code = longPressKey;
-    keyDownEvent.value = 1;
+    if (!checkDeadline(now) && (state == WAIT_FOR_LONG_PRESS || state == WAIT_FOR_DOUBLE_PRESS)) {
+        /* woken up early, e.g. after the clock was set back */
+        armTimer();
+    }
+}
 
-    emit keyTranslated(keyDownEvent);
+void KeyTranslator::setDeadline(const struct timeval &time, int ms)
+{
+    struct timeval delay;
+    delay.tv_sec = ms / 1000;
+    delay.tv_usec = (ms % 1000) * 1000;
 
-    state = LONG_PRESS_DETECTED;
+    timeradd(&time, &delay, &deadline);
+    armTimer();
 }
 
-struct timeval KeyTranslator::monotime()
+void KeyTranslator::armTimer()
 {
-    struct timeval tv;
-    struct timespec ts = { 0, 0 };
+    struct itimerspec its;
 
-    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-        TIMESPEC_TO_TIMEVAL(&tv, &ts);
+    if (timerFd == -1) {
+        return;
     }
-    return tv;
+
+    memset(&its, 0, sizeof its);
+    TIMEVAL_TO_TIMESPEC(&deadline, &its.it_value);
+
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, 0) == -1) {
+        syslog(LOG_WARNING, "Could not arm the long press timer: %s\n", strerror(errno));
+    }
+}
+
+void KeyTranslator::disarmTimer()
+{
+    struct itimerspec its;
+
+    if (timerFd == -1) {
+        return;
+    }
+
+    memset(&its, 0, sizeof its);
+    timerfd_settime(timerFd, 0, &its, 0);
+}
+
+void KeyTranslator::emitKey(__u16 code, int value, const struct timeval &time)
+{
+    struct input_event ev;
+
+    memset(&ev, 0, sizeof ev);
+    ev.time = time;
+    ev.type = EV_KEY;
+    ev.code = code;
+    ev.value = value;
+
+    emit keyTranslated(ev);
 }
@@ -26,42 +26,74 @@
 #define KEYTRANSLATOR_H
 
 #include <QObject>
-#include <QTimer>
+#include <QSocketNotifier>
 
 #include <linux/types.h>
 #include <linux/input.h>
+#include <time.h>
 
 enum State {
     WAIT_FOR_KEYPRESS,
     WAIT_FOR_LONG_PRESS,
     LONG_PRESS_DETECTED,
+    WAIT_FOR_DOUBLE_PRESS,
+    DOUBLE_PRESS_DETECTED
 };
 
+/*
+ * Translates the presses of a key into short, long and double press keys.
+ * The decision is made from the kernel timestamps of the events alone: a
+ * press is long if the key is still down, or is released, at or after
+ * press time + longPressThreshold, and a press is double if the key is
+ * pressed again before release time + doublePressWindow. A timerfd armed
+ * at the pending deadline reports what happened when no further event
+ * comes, and the translated events carry the kernel time of the press,
+ * the release, or the deadline. A key without long and double press keys
+ * is simply renamed to shortPressKey.
+ */
 class KeyTranslator : public QObject
 {
     Q_OBJECT
 
 private:
-    QTimer longPressTimer;
     State state;
-
-    void handleKeyDown();
-    void handleKeyUp();
-
-    static struct timeval monotime();
+    clockid_t clock;
+    struct timeval pressTime;
+    struct timeval releaseTime;
+    struct timeval deadline;
+
+    int timerFd;
+    QSocketNotifier *timerNotifier;
+
+    void handleKeyDown(const struct timeval &time);
+    void handleKeyUp(const struct timeval &time);
+    void setClock(clockid_t eventClock);
+    void setDeadline(const struct timeval &time, int ms);
+    void armTimer();
+    void disarmTimer();
+    void emitKey(__u16 code, int value, const struct timeval &time);
 
 private Q_SLOTS:
 
-    void longPressTimeout();
+    void deadlineExpired();
 
 public:
     __u16 shortPressKey;
-    __u16 longPressKey;
+    __u16 longPressKey;         /* zero if the key has no long press */
+    __u16 doublePressKey;       /* zero if the key has no double press */
+    int longPressThreshold;     /* in milliseconds */
+    int doublePressWindow;      /* in milliseconds */
 
     KeyTranslator(QObject *parent = 0);
     ~KeyTranslator();
 
-    void handleEvent(struct input_event &ev);
+    /* eventClock is the clock of ev.time, see EVIOCSCLOCKID */
+    void handleEvent(const struct input_event &ev, clockid_t eventClock = CLOCK_MONOTONIC);
+
+    /* Reports the long press, or the short press that did not become a
+       double press, if its deadline is at or before now, which is a time
+       of the event clock. Returns true if something was reported. */
+    bool checkDeadline(const struct timeval &now);
 
 Q_SIGNALS:
     void keyTranslated(struct input_event &event);
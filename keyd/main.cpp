@@ -24,8 +24,15 @@
  */
 #include "qmkeyd.h"
 
+#include <string.h>
+
 int main(int argc, char *argv[])
 {
+    /* qmkeyd2 -c keymap.conf keymap.bin compiles a key map, see keymap.h */
+    if (argc == 4 && !strcmp(argv[1], "-c")) {
+        return KeyMap::compile(argv[2], argv[3]) ? 0 : 1;
+    }
+
     QmKeyd server(argc, argv);
 
     return server.exec();
@@ -31,32 +31,19 @@
 #include <syslog.h>
 #include <errno.h>
 
+#include <sys/epoll.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <QFile>
 
-#define GPIO_KEYS "/dev/input/gpio-keys"
-#define KEYPAD "/dev/input/keypad"
-#define ECI "/dev/input/eci"
-#define PWRBUTTON "/dev/input/pwrbutton"
-
-#ifndef KEY_CAMERA_FOCUS
-#define KEY_CAMERA_FOCUS 0x210
-#endif
-#ifndef SW_KEYPAD_SLIDE
-#define SW_KEYPAD_SLIDE 0x0a
+#ifndef EVIOCSCLOCKID
+#define EVIOCSCLOCKID _IOW('E', 0xa0, int)
 #endif
 
-#define BITS_PER_LONG (sizeof(long) * 8)
-#define NBITS(x) ((((x)-1)/BITS_PER_LONG)+1)
-#define OFF(x)  ((x)%BITS_PER_LONG)
-#define BIT(x)  (1UL<<OFF(x))
-#define LONG(x) ((x)/BITS_PER_LONG)
-#define test_bit(bit, array)	((array[LONG(bit)] >> OFF(bit)) & 1)
-
 /*
  * lea  --  helper for address + offset calculations
  */
@@ -65,21 +52,34 @@ static inline void *lea(void *base, int offs)
     return ((char *)base) + offs;
 }
 
+/* Maximum number of ready descriptors taken from epoll at a time */
+#define MAX_EPOLL_EVENTS 16
+
 static int  debugmode = 0;
+static int  epollmode = 0;
+static int  threadmode = 0;
 
 QmKeyd::QmKeyd(int argc, char**argv) : QCoreApplication(argc, argv),
     server(0),
     connections(0),
-    gpioFile(-1), keypadFile(-1), eciFile(-1), powerButtonFile(-1), btFile(-1),
-    gpioNotifier(0), keypadNotifier(0), eciNotifier(0), powerButtonNotifier(0), btNotifier(0), inputNotifier(0),
+    pendingCount(0), draining(false),
+    inputNotifier(0),
+    epollFd(-1), epollNotifier(0),
+    reader(0), readerNotifier(0),
+    stateTable(0),
     inotifyWd(-1), inotifyFd(-1),
-    btfname(0),
     users(0)
 {
     openlog("qmkeyd", LOG_NDELAY|LOG_PID, LOG_DAEMON);
 
-    if (argc > 1 && !strcmp(argv[1], "-d"))
-        debugmode = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d"))
+            debugmode = 1;
+        else if (!strcmp(argv[i], "-e"))
+            epollmode = 1;
+        else if (!strcmp(argv[i], "-t"))
+            threadmode = 1;
+    }
 
     server = new QLocalServer();
     if (!connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()))) {
@@ -96,32 +96,86 @@ QmKeyd::QmKeyd(int argc, char**argv) : QCoreApplication(argc, argv),
         failStart("Could not set permissions %s\n", SERVER_NAME);
     }
 
-    inotifyFd = inotify_init();
-    if (inotifyFd < 0) {
-        failStart("Could not create inotify watch for /dev/input\n");
+    for (unsigned int i = 0; i < QMKEYD_CODE_COUNT; i++) {
+        registry.setSupported(qmkeyd_codes[i].type, qmkeyd_codes[i].code);
     }
 
-    inotifyWd = inotify_add_watch(inotifyFd, "/dev/input", IN_CREATE | IN_DELETE);
-    inputNotifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read);
-    if (!connect(inputNotifier, SIGNAL(activated(int)), this, SLOT(detectBT(int)))) {
-        failStart("Failed to connect the inotify activated signal\n");
+    if (!keyMap.load(KEYMAP_PATH)) {
+        keyMap.loadDefaults();
     }
 
-    keyTranslator[0].shortPressKey = KEY_PREVIOUSSONG;
-    keyTranslator[0].longPressKey = KEY_REWIND;
+    /* One translator for each translated key, at the index of its entry */
+    foreach (const KeyMap::Entry &entry, keyMap.entries()) {
+        KeyTranslator *translator = new KeyTranslator(this);
+        translator->shortPressKey = entry.shortPressKey;
+        translator->longPressKey = entry.longPressKey;
+        translator->doublePressKey = entry.doublePressKey;
+        translator->longPressThreshold = entry.longPressThreshold;
+        translator->doublePressWindow = entry.doublePressWindow;
+
+        if (!connect(translator, SIGNAL(keyTranslated(struct input_event&)),
+                     this, SLOT(translatedKeyReceived(struct input_event&)))) {
+            failStart("Failed to connect the keyTranslator signal\n");
+        }
+        translators.append(translator);
 
-    keyTranslator[1].shortPressKey = KEY_NEXTSONG;
-    keyTranslator[1].longPressKey = KEY_FORWARD;
+        /* New accessories may have keys that are only supported translated */
+        registry.setSupported(EV_KEY, entry.code);
+    }
+
+    createStateTable();
 
-    if (!connect(&keyTranslator[0], SIGNAL(keyTranslated(struct input_event&)),
-                                   this, SLOT(translatedKeyReceived(struct input_event&)))) {
-        failStart("Failed to connect the keyTranslator[0] signal\n");
+    /* In epoll mode all the descriptors share a single notifier */
+    if (epollmode) {
+        epollFd = epoll_create(MAX_EPOLL_EVENTS);
+        if (epollFd < 0) {
+            failStart("Could not create epoll instance\n");
+        }
+
+        epollNotifier = new QSocketNotifier(epollFd, QSocketNotifier::Read);
+        if (!connect(epollNotifier, SIGNAL(activated(int)), this, SLOT(epollActivated(int)))) {
+            failStart("Failed to connect the epoll activated signal\n");
+        }
     }
 
-    if (!connect(&keyTranslator[1], SIGNAL(keyTranslated(struct input_event&)),
-                                   this, SLOT(translatedKeyReceived(struct input_event&)))) {
-        failStart("Failed to connect the keyTranslator[1] signal\n");
+    /* In thread mode the devices are read by a thread of their own */
+    if (threadmode) {
+        reader = new InputReader();
+        if (!reader->isValid()) {
+            failStart("Could not create the input reader\n");
+        }
+
+        readerNotifier = new QSocketNotifier(reader->wakeupFd(), QSocketNotifier::Read);
+        if (!connect(readerNotifier, SIGNAL(activated(int)), this, SLOT(readerActivated(int)))) {
+            failStart("Failed to connect the reader activated signal\n");
+        }
+        reader->start();
     }
+
+    inotifyFd = inotify_init();
+    if (inotifyFd < 0) {
+        failStart("Could not create inotify watch for /dev/input\n");
+    }
+
+    inotifyWd = inotify_add_watch(inotifyFd, "/dev/input", IN_CREATE | IN_DELETE);
+    if (epollFd != -1) {
+        /* Level triggered, as detectDevices() reads a single buffer at a time */
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = inotifyFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, inotifyFd, &ev) == -1) {
+            failStart("Could not add the inotify watch to epoll\n");
+        }
+    } else {
+        inputNotifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read);
+        if (!connect(inputNotifier, SIGNAL(activated(int)), this, SLOT(detectDevices(int)))) {
+            failStart("Failed to connect the inotify activated signal\n");
+        }
+    }
+
+    /* Watch first, so that no device can appear unnoticed during the scan */
+    registry.scan();
 }
 
 QmKeyd::~QmKeyd()
@@ -132,7 +186,21 @@ QmKeyd::~QmKeyd()
 
     removeInotifyWatch();
     closeHandles();
-    closeBT();
+    destroyStateTable();
+
+    if (reader) {
+        reader->stop();
+        if (reader->droppedEvents()) {
+            syslog(LOG_INFO, "The input reader dropped %lu events\n", reader->droppedEvents());
+        }
+        delete readerNotifier, readerNotifier = 0;
+        delete reader, reader = 0;
+    }
+
+    if (epollFd != -1) {
+        delete epollNotifier, epollNotifier = 0;
+        close(epollFd), epollFd = -1;
+    }
 }
 
 void QmKeyd::failStart(const char *fmt, ...)
@@ -148,37 +216,6 @@ void QmKeyd::failStart(const char *fmt, ...)
     QCoreApplication::exit(1);
 }
 
-/* Check if the newly created device is BT headset, if not return false */
-bool QmKeyd::isHeadset(int fd)
-{
-    bool headsetDetected = false;
-    unsigned long events[NBITS(EV_MAX)];
-    unsigned long bits[NBITS(KEY_MAX)];
-
-    if (ioctl(fd, EVIOCGBIT(0, EV_MAX), events) == -1) {
-        goto PROBING_DONE;
-    }
-
-    if (!(test_bit(EV_SYN, events) && test_bit(EV_REL, events) && test_bit(EV_REP, events))) {
-        goto PROBING_DONE;
-    }
-
-    if (test_bit(EV_KEY, events)) {
-        if (ioctl(fd, EVIOCGBIT(EV_KEY, KEY_MAX), bits) == -1) {
-            goto PROBING_DONE;
-        }
-        if (test_bit(KEY_PAUSECD, bits) && test_bit(KEY_PLAYCD, bits) &&
-            test_bit(KEY_STOPCD, bits) && test_bit(KEY_NEXTSONG, bits) &&
-            test_bit(KEY_FASTFORWARD, bits) && test_bit(KEY_PREVIOUSSONG, bits) &&
-            test_bit(KEY_REWIND, bits)) {
-            headsetDetected = true;
-        }
-    }
-
-PROBING_DONE:
-    return headsetDetected;
-}
-
 void QmKeyd::cleanSocket()
 {
     QFile serverSocket(SERVER_NAME);
@@ -193,7 +230,8 @@ void QmKeyd::cleanSocket()
     }
 }
 
-void QmKeyd::detectBT(int inotify)
+/* Keep the device registry in sync with /dev/input */
+void QmKeyd::detectDevices(int inotify)
 {
     char buf[2<<10];
     struct inotify_event *ev = 0;
@@ -224,40 +262,33 @@ void QmKeyd::detectBT(int inotify)
                 break;
             }
 
+            InputDevice *device = 0;
+
             switch (ev->mask) {
                 case IN_DELETE:
-                     /* Check if the current headset was disconnected */
-                     if (btfname && strcmp(btfname, fname) == 0) {
-                         closeBT();
+                     if ((device = registry.take(fname)) != 0) {
+                         if (debugmode) {
+                             syslog(LOG_DEBUG, "Removed %s device %s\n", device->className(), fname);
+                         }
+                         closeDevice(device);
+                         delete device;
+                         refreshStateTable();
                      }
                      break;
 
                 case IN_CREATE:
-                     int fd;
-
-                     /* Check if a headset was connected */
-                     if ((fd = open(fname, O_RDONLY | O_NONBLOCK)) == -1) {
-                         syslog(LOG_WARNING, "Could not open %s for detecting a headset\n", fname);
-                         goto next_ev;
-                     }
-
-                     if (isHeadset(fd)) {
-                         /* Yes, found a new headset. Close an existing headset, if there's one */
-                         closeBT();
-
-                         btfname = strdup(fname);
-                         btFile = fd;
-
-                         /* Receive notifications for the headset */
-                         btNotifier = new QSocketNotifier(btFile, QSocketNotifier::Read);
-                         connect(btNotifier, SIGNAL(activated(int)), this, SLOT(didReceiveKeyFromBluetooth(int)));
-                     } else {
-                         close(fd);
+                     if ((device = registry.add(fname)) != 0) {
+                         if (debugmode) {
+                             syslog(LOG_DEBUG, "Added %s device %s\n", device->className(), fname);
+                         }
+                         if (users > 0) {
+                             openDevice(device);
+                             refreshStateTable();
+                         }
                      }
                      break;
             }
 
-next_ev:
             if (fname) {
                 free(fname);
             }
@@ -274,7 +305,19 @@ void QmKeyd::newConnection()
         QLocalSocket *socket = server->nextPendingConnection();
         connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
         connect(socket, SIGNAL(readyRead()), this, SLOT(clientSocketReadyRead()));
-        connections.push_back(socket);
+        connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(clientBytesWritten(qint64)));
+
+        /* Every client starts with the legacy protocol until it says hello */
+        KeydClient *client = new KeydClient;
+        client->socket = socket;
+        client->protocolVersion = QMKEYD_PROTOCOL_LEGACY;
+        client->subscription = QMKEYD_SUBSCRIBE_ALL;
+        client->queueHead = 0;
+        client->queueCount = 0;
+        client->overflow = false;
+        client->dropped = 0;
+        client->coalesced = 0;
+        connections.push_back(client);
         users++;
 
         if (debugmode) {
@@ -300,15 +343,20 @@ void QmKeyd::newConnection()
 void QmKeyd::disconnected()
 {
     QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
-    for (QVector<QLocalSocket*>::iterator it = connections.begin(); it != connections.end(); it++) {
-        if (*it == socket) {
+    for (QVector<KeydClient*>::iterator it = connections.begin(); it != connections.end(); it++) {
+        if ((*it)->socket == socket) {
 
             users--;
 
             if (debugmode) {
                 syslog(LOG_DEBUG, "Client with socket %p disappeared, clients now %d\n", socket, users);
             }
+            if ((*it)->dropped || (*it)->coalesced) {
+                syslog(LOG_INFO, "Client with socket %p was too slow: %lu events dropped, %lu repeats coalesced\n",
+                       socket, (*it)->dropped, (*it)->coalesced);
+            }
 
+            delete *it;
             connections.erase(it);
 
             if (!users)
@@ -319,11 +367,22 @@ void QmKeyd::disconnected()
     socket->deleteLater();
 }
 
+KeydClient *QmKeyd::findClient(QLocalSocket *socket)
+{
+    foreach (KeydClient *client, connections) {
+        if (client->socket == socket) {
+            return client;
+        }
+    }
+    return 0;
+}
+
 /* Client socket ready: received data (an event) for querying the state of a key.
    If the key is pressed, we bounce back the event with ev.value = 1 */
 void QmKeyd::clientSocketReadyRead() {
     QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
-    if (!socket) {
+    KeydClient *client = findClient(socket);
+    if (!client) {
         syslog(LOG_WARNING, "An invalid socket to be read\n");
         return;
     }
@@ -338,244 +397,712 @@ void QmKeyd::clientSocketReadyRead() {
             break;
         }
 
-        if (ret == sizeof(ev) && isKeySupported(ev)) {
-            ev.value = 0;
-
-            if ((gpioFile != -1 && isKeyPressed(gpioFile, ev.code)) ||
-                (keypadFile != -1 && isKeyPressed(keypadFile, ev.code)) ||
-                (eciFile != -1 && isKeyPressed(eciFile, ev.code)) ||
-                (powerButtonFile != -1 && isKeyPressed(powerButtonFile, ev.code)) ||
-                (btFile != -1 && isKeyPressed(btFile, ev.code))) {
-                ev.value = 1;
-            }
+        if (ret == sizeof(ev) && ev.type == QMKEYD_EV_CONTROL) {
+            handleControlEvent(client, ev);
+        } else if (ret == sizeof(ev) && isKeySupported(ev)) {
+            ev.value = isKeyPressed(ev) ? 1 : 0;
 
             // Bounce the event back
-            if (socket->write((char*)&ev, sizeof(ev)) != sizeof(ev)) {
-                int          fd = socket->socketDescriptor();
-                syslog(LOG_WARNING, "Could not write to a socket %d\n", fd);
-            }
+            sendToClient(client, &ev, 1);
         }
     }
 }
 
-bool QmKeyd::isKeyPressed(int fd, int key)
+void QmKeyd::handleControlEvent(KeydClient *client, struct input_event &ev)
 {
-    uint8_t keys[KEY_MAX/8 + 1];
-    memset(keys, 0, sizeof *keys);
-    ioctl(fd, EVIOCGKEY(sizeof(keys)), keys);
+    switch (ev.code) {
+    case QMKEYD_CONTROL_HELLO:
+        if (ev.value < QMKEYD_PROTOCOL_LEGACY) {
+            break;
+        }
+        /* Agree on the highest version both ends speak. The answer still goes
+           out in the legacy format, everything after it in the new one. */
+        ev.value = qMin((int)ev.value, QMKEYD_PROTOCOL_VERSION);
+        drainQueue(client, true);
+        writeToClient(client, &ev, 1);
+        client->protocolVersion = ev.value;
 
-    return !!(keys[key/8] & (1 << (key % 8)));
+        if (debugmode) {
+            syslog(LOG_DEBUG, "Client with socket %p speaks protocol version %d\n", client->socket, client->protocolVersion);
+        }
+        sendSnapshot(client);
+        break;
+    case QMKEYD_CONTROL_SUBSCRIBE:
+        client->subscription = (__u32)ev.value;
+
+        if (debugmode) {
+            syslog(LOG_DEBUG, "Client with socket %p subscribed to 0x%08x\n", client->socket, client->subscription);
+        }
+        sendSnapshot(client);
+        break;
+    case QMKEYD_CONTROL_QUERY:
+        if (client->protocolVersion >= QMKEYD_PROTOCOL_QUERY) {
+            answerQuery(client, (__u32)ev.value, (__u32)ev.time.tv_sec);
+        }
+        break;
+    default:
+        break;
+    }
 }
 
-void QmKeyd::didReceiveKeyFromBluetooth(int fd)
+/* Fill states with the current state of each code in the mask */
+int QmKeyd::collectStates(__u32 mask, struct input_event *states)
 {
-    if (debugmode) {
-        syslog(LOG_DEBUG, "Received a key from bluetooth");
+    int count = 0;
+
+    for (unsigned int i = 0; i < QMKEYD_CODE_COUNT; i++) {
+        if (!(mask & (1U << i))) {
+            continue;
+        }
+        struct input_event &ev = states[count];
+        memset(&ev, 0, sizeof(ev));
+        ev.type = qmkeyd_codes[i].type;
+        ev.code = qmkeyd_codes[i].code;
+        if (!isKeySupported(ev)) {
+            continue;
+        }
+        ev.value = isKeyPressed(ev) ? 1 : 0;
+        count++;
     }
-    handleKeyEvent(fd, QmKeyd::BluetoothEvent);
+    return count;
 }
 
-void QmKeyd::didReceiveKeyFromGpioKeys(int fd)
+/* Answer with the state of each queried code, in a single batch */
+void QmKeyd::answerQuery(KeydClient *client, __u32 mask, __u32 cookie)
 {
-    if (debugmode) {
-        syslog(LOG_DEBUG, "Received a key from gpio keys");
+    struct input_event states[QMKEYD_CODE_COUNT];
+    int count = collectStates(mask, states);
+
+    /* The reply must not overtake the events queued before it */
+    drainQueue(client, true);
+    writeToClient(client, states, count, QMKEYD_BATCH_REPLY, cookie);
+}
+
+/* Tell the client the state of everything it subscribed to, so that it
+   does not have to query the keys one by one */
+void QmKeyd::sendSnapshot(KeydClient *client)
+{
+    if (client->protocolVersion < QMKEYD_PROTOCOL_SNAPSHOT) {
+        return;
     }
-    handleKeyEvent(fd, QmKeyd::GPIOKeysEvent);
+
+    struct input_event states[QMKEYD_CODE_COUNT];
+    int count = collectStates(client->subscription, states);
+
+    drainQueue(client, true);
+    writeToClient(client, states, count, QMKEYD_BATCH_SNAPSHOT);
 }
 
-void QmKeyd::didReceiveKeyFromKeypad(int fd)
+/* The state table mirrors the open devices, so only ask the devices
+   that can report the key if the table is not available */
+bool QmKeyd::isKeyPressed(const struct input_event &ev)
 {
-    if (debugmode) {
-        syslog(LOG_DEBUG, "Received a key from keypad");
+    if (stateTable) {
+        int value = qmkeyd_state_get(stateTable, ev.type, ev.code);
+        if (value != -1) {
+            return value;
+        }
     }
-    handleKeyEvent(fd, QmKeyd::KeypadEvent);
+
+    foreach (InputDevice *device, devices) {
+        if (device->isActive(ev.type, ev.code)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-void QmKeyd::didReceiveKeyFromEci(int fd)
+void QmKeyd::deviceActivated(int fd)
 {
-    if (debugmode) {
-        syslog(LOG_DEBUG, "Received a key from eci");
+    dispatchDevice(fd);
+}
+
+/* A single wakeup services every descriptor that has become ready */
+void QmKeyd::epollActivated(int)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int n;
+
+    do {
+        n = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, 0);
+
+        if (n == -1) {
+            if (errno != EINTR) {
+                syslog(LOG_WARNING, "epoll_wait: %s\n", strerror(errno));
+            }
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == inotifyFd) {
+                detectDevices(inotifyFd);
+            } else {
+                dispatchDevice(events[i].data.fd);
+            }
+        }
+    } while (n == MAX_EPOLL_EVENTS);
+}
+
+/* Process what the reader thread has read, see inputreader.h */
+void QmKeyd::readerActivated(int)
+{
+    InputRecord records[QMKEYD_MAX_BATCH];
+    struct input_event events[QMKEYD_MAX_BATCH];
+    int n;
+
+    reader->acknowledge();
+
+    draining = true;
+
+    while ((n = reader->take(records, QMKEYD_MAX_BATCH)) > 0) {
+        /* Runs of records from the same device are processed together */
+        for (int i = 0; i < n; ) {
+            int fd = records[i].fd;
+            unsigned int generation = records[i].generation;
+            int count = 0;
+
+            while (i < n && records[i].fd == fd && records[i].generation == generation) {
+                events[count++] = records[i++].ev;
+            }
+
+            /* The device may have been closed since, and its descriptor
+               even reused by another device */
+            InputDevice *device = devices.value(fd);
+            if (device && device->generation == generation) {
+                processEvents(device, events, count);
+            }
+        }
     }
-    handleKeyEvent(fd, QmKeyd::ECIEvent);
+
+    draining = false;
+    flushEvents();
 }
 
-void QmKeyd::didReceiveKeyFromPowerButton(int fd)
+void QmKeyd::dispatchDevice(int fd)
 {
+    InputDevice *device = devices.value(fd);
+    if (!device) {
+        /* Closed while the wakeup was pending */
+        return;
+    }
+
     if (debugmode) {
-        syslog(LOG_DEBUG, "Received a key from power button");
+        syslog(LOG_DEBUG, "Received a key from %s", device->className());
     }
-    handleKeyEvent(fd, QmKeyd::PowerButtonEvent);
+    handleKeyEvent(device);
 }
 
 void QmKeyd::translatedKeyReceived(struct input_event &ev)
 {
-    broadcastToClients(ev);
+    queueEvent(ev);
+
+    /* Translations made by a timer are not followed by an EV_SYN */
+    if (!draining) {
+        flushEvents();
+    }
 }
 
-void QmKeyd::handleKeyEvent(int fd, EventType eventType)
+/* Drain the device with as few reads as possible. Everything the kernel
+   reports up to an EV_SYN is sent to the clients as one batch. */
+void QmKeyd::handleKeyEvent(InputDevice *device)
 {
+    struct input_event events[QMKEYD_MAX_BATCH];
+
+    draining = true;
+
     for (;;) {
-        struct input_event ev;
-        memset(&ev, 0, sizeof(ev));
-        int ret = read(fd, &ev, sizeof(ev));
+        int ret = read(device->fd, events, sizeof(events));
 
         if (ret <= 0) {
             break;
         }
 
-        if (!(ret == sizeof(ev) && isKeySupported(ev))) {
+        processEvents(device, events, ret / sizeof(struct input_event));
+    }
+
+    draining = false;
+    flushEvents();
+}
+
+void QmKeyd::processEvents(InputDevice *device, struct input_event *events, int count)
+{
+    /* As with evdev, the events after a SYN_DROPPED up to the next
+       SYN_REPORT are what is left of a broken packet, and never make it
+       to the state table or to the clients. The packet may end in a
+       later batch. If keys changed in it, its end becomes another
+       SYN_DROPPED, so that the device is read again. */
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        struct input_event &ev = events[i];
+
+        if (device->dropping) {
+            if (ev.type == EV_KEY || ev.type == EV_SW) {
+                device->discarded = true;
+            } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                device->dropping = false;
+                if (device->discarded) {
+                    ev.code = SYN_DROPPED;
+                    events[kept++] = ev;
+                }
+            }
             continue;
         }
+        if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+            device->dropping = true;
+            device->discarded = false;
+        }
+        events[kept++] = ev;
+    }
+    count = kept;
 
-        switch (eventType) {
-            case ECIEvent:
-                if (ev.type == EV_KEY && ev.code == KEY_REWIND) {
-                    // KEY_REWIND short press is mapped to KEY_PREVIOUSSONG
-                    keyTranslator[0].handleEvent(ev);
-                } else if (ev.type == EV_KEY && ev.code == KEY_FORWARD) {
-                    // KEY_FORWARD short press is mapped to KEY_NEXTSONG
-                    keyTranslator[1].handleEvent(ev);
-                } else {
-                    broadcastToClients(ev);
-                }
-                break;
-            case BluetoothEvent:         /* FALL THROUGH */
-            case GPIOKeysEvent:          /* FALL THROUGH */
-            case KeypadEvent:            /* FALL THROUGH */
-            case PowerButtonEvent:       /* FALL THROUGH */
-            default:
-                broadcastToClients(ev); break;
+    /* Publish the new states before the clients hear about them */
+    if (stateTable) {
+        qmkeyd_state_write_begin(stateTable);
+        for (int i = 0; i < count; i++) {
+            qmkeyd_state_set(stateTable, events[i].type, events[i].code, events[i].value != 0);
+        }
+        qmkeyd_state_write_end(stateTable);
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct input_event &ev = events[i];
+
+        if (ev.type == EV_SYN) {
+            if (ev.code == SYN_DROPPED) {
+                resyncDevice(device);
+            }
+            flushEvents();
+            continue;
+        }
+
+        if (!isKeySupported(ev)) {
+            continue;
+        }
+
+        int entry = ev.type == EV_KEY ? keyMap.lookup(device->deviceClass, ev.code) : -1;
+        if (entry != -1) {
+            translators[entry]->handleEvent(ev, device->clock);
+        } else {
+            queueEvent(ev);
         }
     }
 }
 
-// Broadcast the input event back to the clients over the client socket.
-void QmKeyd::broadcastToClients(struct input_event &ev)
+/* Events of the device were lost, by the kernel or by the reader thread.
+   The keys whose state the kernel reports differently from the state
+   table go through as if their events had arrived. */
+void QmKeyd::resyncDevice(InputDevice *device)
 {
-    QLocalSocket *socket;
-    foreach (socket, connections) {
-        socket->write((char*)&ev, sizeof(ev));
+    struct timespec now;
+    clock_gettime(device->clock, &now);
+
+    for (unsigned int i = 0; i < QMKEYD_CODE_COUNT; i++) {
+        struct input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = qmkeyd_codes[i].type;
+        ev.code = qmkeyd_codes[i].code;
+        if (!device->hasCode(ev.type, ev.code)) {
+            continue;
+        }
+
+        ev.value = device->isActive(ev.type, ev.code) ? 1 : 0;
+        if (stateTable && qmkeyd_state_get(stateTable, ev.type, ev.code) == ev.value) {
+            continue;
+        }
+        ev.time.tv_sec = now.tv_sec;
+        ev.time.tv_usec = now.tv_nsec / 1000;
+
+        int entry = ev.type == EV_KEY ? keyMap.lookup(device->deviceClass, ev.code) : -1;
+        if (entry != -1) {
+            translators[entry]->handleEvent(ev, device->clock);
+        } else {
+            queueEvent(ev);
+        }
     }
+
+    refreshStateTable();
+    syslog(LOG_INFO, "Events of %s device were lost, its keys were read again\n", device->className());
 }
 
-bool QmKeyd::isKeySupported(struct input_event &ev)
+void QmKeyd::queueEvent(struct input_event &ev)
 {
-    bool supported = false;
-
-    if (ev.type == EV_KEY) {
-        switch (ev.code) {
-        case KEY_RIGHTCTRL:
-        case KEY_CAMERA:
-        case KEY_CAMERA_FOCUS:
-        case KEY_VOLUMEUP:
-        case KEY_VOLUMEDOWN:
-        case KEY_UP:
-        case KEY_LEFT:
-        case KEY_RIGHT:
-        case KEY_END:
-        case KEY_DOWN:
-        case KEY_MUTE:
-        case KEY_STOP:
-        case KEY_FORWARD:
-        case KEY_PLAYPAUSE:
-        case KEY_PHONE:
-        case KEY_PAUSECD:
-        case KEY_PLAYCD:
-        case KEY_STOPCD:
-        case KEY_NEXTSONG:
-        case KEY_FASTFORWARD:
-        case KEY_PREVIOUSSONG:
-        case KEY_REWIND:
-        case KEY_POWER:
-            supported = true;
-            break;
+    if (pendingCount == QMKEYD_MAX_BATCH) {
+        flushEvents();
+    }
+    pendingMasks[pendingCount] = qmkeyd_code_mask(ev.type, ev.code);
+    pendingEvents[pendingCount++] = ev;
+}
+
+// Broadcast the pending input events to the clients over the client sockets.
+// A client is not woken up at all if it subscribed to none of the events.
+// Events without a subscription bit go to everyone, see qmkeyd_subscribed().
+void QmKeyd::flushEvents()
+{
+    struct input_event events[QMKEYD_MAX_BATCH];
+    __u32 pendingMask = 0;
+
+    if (pendingCount == 0) {
+        return;
+    }
+
+    for (int i = 0; i < pendingCount; i++) {
+        pendingMask |= pendingMasks[i];
+    }
+
+    foreach (KeydClient *client, connections) {
+        if ((client->subscription & pendingMask) == pendingMask) {
+            sendToClient(client, pendingEvents, pendingCount);
+            continue;
         }
-    } else if (ev.type == EV_SW) {
-        switch (ev.code) {
-        case SW_KEYPAD_SLIDE:
-            supported = true;
-            break;
+
+        int count = 0;
+        for (int i = 0; i < pendingCount; i++) {
+            if (qmkeyd_subscribed(client->subscription, pendingMasks[i])) {
+                events[count++] = pendingEvents[i];
+            }
+        }
+        if (count > 0) {
+            sendToClient(client, events, count);
         }
     }
-    return supported;
+    pendingCount = 0;
 }
 
-void QmKeyd::openHandles()
+/* Send the events right away, unless the client is lagging behind:
+   then the events wait in the bounded queue of the client */
+void QmKeyd::sendToClient(KeydClient *client, const struct input_event *events, int count)
 {
-    if (gpioFile == -1) {
-        gpioFile = open(GPIO_KEYS, O_RDONLY | O_NONBLOCK);
-        if (gpioFile != -1) {
-            gpioNotifier = new QSocketNotifier(gpioFile, QSocketNotifier::Read);
-            connect(gpioNotifier, SIGNAL(activated(int)), this, SLOT(didReceiveKeyFromGpioKeys(int)));
-        } else {
-            syslog(LOG_WARNING, "Could not open %s\n", GPIO_KEYS);
-            gpioNotifier = 0;
+    if (client->queueCount == 0 && !client->overflow &&
+        client->socket->bytesToWrite() < CLIENT_BACKLOG_SIZE) {
+        writeToClient(client, events, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        enqueueEvent(client, events[i]);
+    }
+}
+
+void QmKeyd::enqueueEvent(KeydClient *client, const struct input_event &ev)
+{
+    /* Autorepeat carries no new state, successive repeats are merged */
+    if (ev.type == EV_KEY && ev.value == 2 && client->queueCount > 0) {
+        struct input_event &tail = client->queue[(client->queueHead + client->queueCount - 1) % CLIENT_QUEUE_SIZE];
+        if (tail.type == ev.type && tail.code == ev.code && tail.value == 2) {
+            tail = ev;
+            client->coalesced++;
+            return;
         }
     }
 
-    if (keypadFile == -1) {
-        keypadFile = open(KEYPAD, O_RDONLY | O_NONBLOCK);
-        if (keypadFile != -1) {
-            keypadNotifier = new QSocketNotifier(keypadFile, QSocketNotifier::Read);
-            connect(keypadNotifier, SIGNAL(activated(int)), this, SLOT(didReceiveKeyFromKeypad(int)));
-        } else {
-            syslog(LOG_WARNING, "Could not open %s\n", KEYPAD);
-            keypadNotifier = 0;
+    if (client->queueCount == CLIENT_QUEUE_SIZE) {
+        compactQueue(client);
+    }
+    if (client->queueCount == CLIENT_QUEUE_SIZE) {
+        /* Only control messages left, drop the oldest */
+        client->queueHead = (client->queueHead + 1) % CLIENT_QUEUE_SIZE;
+        client->queueCount--;
+        client->dropped++;
+        client->overflow = true;
+    }
+
+    client->queue[(client->queueHead + client->queueCount) % CLIENT_QUEUE_SIZE] = ev;
+    client->queueCount++;
+}
+
+/* Keep only the latest event of each key, which is all a client needs to
+   resynchronize. The order of the surviving events is preserved. */
+void QmKeyd::compactQueue(KeydClient *client)
+{
+    struct input_event kept[CLIENT_QUEUE_SIZE];
+    __u32 seen = 0;
+    int count = 0;
+
+    for (int i = client->queueCount - 1; i >= 0; i--) {
+        const struct input_event &ev = client->queue[(client->queueHead + i) % CLIENT_QUEUE_SIZE];
+        __u32 mask = qmkeyd_code_mask(ev.type, ev.code);
+
+        if (mask) {
+            if (seen & mask) {
+                continue;
+            }
+            seen |= mask;
         }
+        kept[CLIENT_QUEUE_SIZE - ++count] = ev;
     }
-    if (eciFile == -1) {
-        eciFile = open(ECI, O_RDONLY | O_NONBLOCK);
-        if (eciFile != -1) {
-            eciNotifier = new QSocketNotifier(eciFile, QSocketNotifier::Read);
-            connect(eciNotifier, SIGNAL(activated(int)), this, SLOT(didReceiveKeyFromEci(int)));
-        } else {
-            syslog(LOG_WARNING, "Could not open %s\n", ECI);
-            eciNotifier = 0;
+
+    int dropped = client->queueCount - count;
+    if (dropped > 0) {
+        memcpy(client->queue, kept + CLIENT_QUEUE_SIZE - count, count * sizeof(struct input_event));
+        client->queueHead = 0;
+        client->queueCount = count;
+        client->dropped += dropped;
+        client->overflow = true;
+
+        if (debugmode) {
+            syslog(LOG_DEBUG, "Client with socket %p lags behind, dropped %d events\n", client->socket, dropped);
         }
     }
-    if (powerButtonFile == -1) {
-        powerButtonFile = open(PWRBUTTON, O_RDONLY | O_NONBLOCK);
-        if (powerButtonFile != -1) {
-            powerButtonNotifier = new QSocketNotifier(powerButtonFile, QSocketNotifier::Read);
-            connect(powerButtonNotifier, SIGNAL(activated(int)), this, SLOT(didReceiveKeyFromPowerButton(int)));
-        } else {
-            syslog(LOG_WARNING, "Could not open %s\n", PWRBUTTON);
-            powerButtonNotifier = 0;
+}
+
+void QmKeyd::clientBytesWritten(qint64)
+{
+    KeydClient *client = findClient(qobject_cast<QLocalSocket*>(sender()));
+    if (client) {
+        drainQueue(client, false);
+    }
+}
+
+/* Move queued events to the socket as far as the backlog allows, or all
+   of them if forced. A lost event is announced before the ones that follow. */
+void QmKeyd::drainQueue(KeydClient *client, bool force)
+{
+    while (client->queueCount > 0 || client->overflow) {
+        if (!force && client->socket->bytesToWrite() >= CLIENT_BACKLOG_SIZE) {
+            break;
         }
+
+        if (client->overflow) {
+            struct input_event marker;
+            memset(&marker, 0, sizeof(marker));
+            marker.type = QMKEYD_EV_CONTROL;
+            marker.code = QMKEYD_CONTROL_OVERFLOW;
+            marker.value = client->dropped;
+            writeToClient(client, &marker, 1);
+            client->overflow = false;
+            continue;
+        }
+
+        /* Up to one batch, without wrapping around the end of the ring */
+        int count = qMin(client->queueCount, CLIENT_QUEUE_SIZE - client->queueHead);
+        count = qMin(count, QMKEYD_MAX_BATCH);
+
+        writeToClient(client, &client->queue[client->queueHead], count);
+        client->queueHead = (client->queueHead + count) % CLIENT_QUEUE_SIZE;
+        client->queueCount -= count;
     }
 }
 
+/* Write the events to the client with a single write, framed according
+   to the protocol version the client has negotiated */
+void QmKeyd::writeToClient(KeydClient *client, const struct input_event *events, int count,
+                           __u16 flags, __u32 cookie)
+{
+    char buf[sizeof(struct qmkeyd_batch) + QMKEYD_MAX_BATCH * sizeof(struct input_event)];
+    int len = 0;
+
+    if (client->protocolVersion >= QMKEYD_PROTOCOL_BATCH) {
+        struct qmkeyd_batch *batch = (struct qmkeyd_batch *)buf;
+        batch->count = count;
+        batch->flags = flags;
+        batch->cookie = cookie;
+        len = sizeof(*batch);
+    }
+
+    memcpy(buf + len, events, count * sizeof(struct input_event));
+    len += count * sizeof(struct input_event);
+
+    if (client->socket->write(buf, len) != len) {
+        syslog(LOG_WARNING, "Could not write to a socket %d\n", (int)client->socket->socketDescriptor());
+    }
+}
+
+bool QmKeyd::isKeySupported(struct input_event &ev)
+{
+    return registry.isSupported(ev.type, ev.code);
+}
+
+void QmKeyd::openHandles()
+{
+    foreach (InputDevice *device, registry.devices()) {
+        openDevice(device);
+    }
+
+    refreshStateTable();
+}
+
 void QmKeyd::closeHandles()
 {
-    if (gpioFile != -1) {
-        close(gpioFile), gpioFile = -1;
-        delete gpioNotifier, gpioNotifier = 0;
+    foreach (InputDevice *device, registry.devices()) {
+        closeDevice(device);
     }
-    if (keypadFile != -1) {
-        close(keypadFile), keypadFile = -1;
-        delete keypadNotifier, keypadNotifier = 0;
+
+    refreshStateTable();
+}
+
+void QmKeyd::openDevice(InputDevice *device)
+{
+    if (device->fd != -1) {
+        return;
     }
-    if (eciFile != -1) {
-        close(eciFile), eciFile = -1;
-        delete eciNotifier, eciNotifier = 0;
+
+    device->fd = open(device->path.constData(), O_RDONLY | O_NONBLOCK);
+    if (device->fd == -1) {
+        syslog(LOG_WARNING, "Could not open %s\n", device->path.constData());
+        return;
     }
-    if (powerButtonFile != -1) {
-        close(powerButtonFile), powerButtonFile = -1;
-        delete powerButtonNotifier, powerButtonNotifier = 0;
+
+    /* Key translation measures press lengths from the event timestamps,
+       which must not jump with the wall clock. Older kernels only have
+       wall clock timestamps. */
+    int clockId = CLOCK_MONOTONIC;
+    device->clock = ioctl(device->fd, EVIOCSCLOCKID, &clockId) == 0 ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+
+    addDevice(device);
+}
+
+void QmKeyd::closeDevice(InputDevice *device)
+{
+    if (device->fd != -1) {
+        removeDevice(device);
+        close(device->fd), device->fd = -1;
     }
 }
 
-void QmKeyd::closeBT()
+/* Add the device to the dispatch table, and have it read by the reader
+   thread, or watch it either with epoll or with a notifier of its own */
+void QmKeyd::addDevice(InputDevice *device)
 {
-    if (btNotifier) {
-        delete btNotifier, btNotifier = 0;
+    device->dropping = false;
+    device->discarded = false;
+
+    if (reader) {
+        device->generation = reader->addDevice(device->fd);
+    } else if (epollFd != -1) {
+        /* Edge triggered, as handleKeyEvent() drains the device */
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = device->fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, device->fd, &ev) == -1) {
+            syslog(LOG_WARNING, "Could not add %s device to epoll: %s\n", device->className(), strerror(errno));
+        }
+    } else {
+        device->notifier = new QSocketNotifier(device->fd, QSocketNotifier::Read);
+        connect(device->notifier, SIGNAL(activated(int)), this, SLOT(deviceActivated(int)));
     }
-    if (btFile != -1) {
-        close(btFile), btFile = -1;
+
+    devices.insert(device->fd, device);
+}
+
+void QmKeyd::removeDevice(InputDevice *device)
+{
+    if (!devices.remove(device->fd)) {
+        return;
     }
-    if (btfname) {
-        free(btfname), btfname = 0;
+
+    if (reader) {
+        reader->removeDevice(device->fd);
+    } else if (epollFd != -1) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, device->fd, &ev);
     }
+    delete device->notifier, device->notifier = 0;
+}
+
+/* Publish the key and switch states in shared memory, see qmkeydprotocol_p.h */
+void QmKeyd::createStateTable()
+{
+    int fd;
+    void *table;
+
+    /* Clients may still have the table of a previous instance mapped */
+    fd = shm_open(QMKEYD_STATE_NAME, O_RDWR, 0);
+    if (fd != -1) {
+        table = mmap(0, sizeof(struct qmkeyd_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (table != MAP_FAILED) {
+            invalidateStateTable((volatile struct qmkeyd_state *)table);
+            munmap(table, sizeof(struct qmkeyd_state));
+        }
+        close(fd);
+    }
+    shm_unlink(QMKEYD_STATE_NAME);
+
+    fd = shm_open(QMKEYD_STATE_NAME, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1) {
+        syslog(LOG_WARNING, "Could not create %s: %s\n", QMKEYD_STATE_NAME, strerror(errno));
+        return;
+    }
+
+    /* The umask must not keep the clients from reading the table */
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0 ||
+        ftruncate(fd, sizeof(struct qmkeyd_state)) != 0) {
+        syslog(LOG_WARNING, "Could not set up %s: %s\n", QMKEYD_STATE_NAME, strerror(errno));
+        close(fd);
+        shm_unlink(QMKEYD_STATE_NAME);
+        return;
+    }
+
+    table = mmap(0, sizeof(struct qmkeyd_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (table == MAP_FAILED) {
+        syslog(LOG_WARNING, "Could not map %s: %s\n", QMKEYD_STATE_NAME, strerror(errno));
+        shm_unlink(QMKEYD_STATE_NAME);
+        return;
+    }
+
+    stateTable = (volatile struct qmkeyd_state *)table;
+    stateTable->magic = QMKEYD_STATE_MAGIC;
+    refreshStateTable();
+}
+
+void QmKeyd::destroyStateTable()
+{
+    if (stateTable) {
+        invalidateStateTable(stateTable);
+        munmap((void *)stateTable, sizeof(struct qmkeyd_state)), stateTable = 0;
+        shm_unlink(QMKEYD_STATE_NAME);
+    }
+}
+
+/* Make the clients that have the table mapped fall back to socket queries */
+void QmKeyd::invalidateStateTable(volatile struct qmkeyd_state *table)
+{
+    qmkeyd_state_write_begin(table);
+    table->valid = 0;
+    qmkeyd_state_write_end(table);
+}
+
+/* Rebuild the table from the devices, whenever the set of open devices changes */
+void QmKeyd::refreshStateTable()
+{
+    uint8_t keys[sizeof(stateTable->keys)];
+    uint8_t switches[sizeof(stateTable->switches)];
+    bool valid = false;
+
+    if (!stateTable) {
+        return;
+    }
+
+    qmkeyd_state_write_begin(stateTable);
+
+    memset((void *)stateTable->keys, 0, sizeof(stateTable->keys));
+    memset((void *)stateTable->switches, 0, sizeof(stateTable->switches));
+
+    foreach (InputDevice *device, devices) {
+        valid = true;
+
+        memset(keys, 0, sizeof(keys));
+        memset(switches, 0, sizeof(switches));
+        if (test_bit(EV_KEY, device->events)) {
+            ioctl(device->fd, EVIOCGKEY(sizeof(keys)), keys);
+        }
+        if (test_bit(EV_SW, device->events)) {
+            ioctl(device->fd, EVIOCGSW(sizeof(switches)), switches);
+        }
+
+        for (unsigned int j = 0; j < sizeof(keys); j++) {
+            stateTable->keys[j] |= keys[j];
+        }
+        for (unsigned int j = 0; j < sizeof(switches); j++) {
+            stateTable->switches[j] |= switches[j];
+        }
+    }
+    stateTable->valid = valid;
+
+    qmkeyd_state_write_end(stateTable);
 }
 
 void QmKeyd::removeInotifyWatch()
@@ -583,6 +1110,11 @@ void QmKeyd::removeInotifyWatch()
     if (inputNotifier) {
         delete inputNotifier, inputNotifier = 0;
     }
+    if (epollFd != -1 && inotifyFd != -1) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, inotifyFd, &ev);
+    }
     if (inotifyFd != -1) {
         inotify_rm_watch(inotifyFd, inotifyWd);
         close(inotifyFd), inotifyFd = -1;
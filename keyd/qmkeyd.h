@@ -31,32 +31,42 @@
 #include <QCoreApplication>
 #include <QSocketNotifier>
 #include <QLocalSocket>
+#include <QHash>
 
 #include <linux/input.h>
 #include <stdint.h>
 
+#include "inputdevice.h"
+#include "inputreader.h"
+#include "keymap.h"
 #include "keytranslator.h"
+#include "qmkeydprotocol_p.h"
 
 #define SERVER_NAME "/tmp/qmkeyd"
 
+/* Events queued for a client whose socket does not drain */
+#define CLIENT_QUEUE_SIZE 128
+/* Bytes buffered in the socket before events are queued instead */
+#define CLIENT_BACKLOG_SIZE 4096
+
+struct KeydClient
+{
+    QLocalSocket *socket;
+    int protocolVersion;
+    __u32 subscription;     /* mask of qmkeyd_codes the client wants */
+
+    struct input_event queue[CLIENT_QUEUE_SIZE];
+    int queueHead, queueCount;
+    bool overflow;          /* events were dropped since the last drain */
+    unsigned long dropped;
+    unsigned long coalesced;
+};
+
 class QmKeyd : public QCoreApplication
 {
     Q_OBJECT
 
 public:
-    enum EventType
-    {
-        BluetoothEvent,
-        GPIOKeysEvent,
-        KeypadEvent,
-        /*
-         * Enhancement Control Interface event, for example
-         * a multimedia headset accessory
-         */
-        ECIEvent,
-        PowerButtonEvent
-    };
-
     QmKeyd(int argc, char** argv);
     ~QmKeyd();
 
@@ -64,39 +74,76 @@ private slots:
     void newConnection();
     void disconnected();
     void clientSocketReadyRead();
-    void detectBT(int);
+    void clientBytesWritten(qint64);
+    void detectDevices(int);
 
-    void didReceiveKeyFromBluetooth(int);
-    void didReceiveKeyFromGpioKeys(int);
-    void didReceiveKeyFromKeypad(int);
-    void didReceiveKeyFromEci(int);
-    void didReceiveKeyFromPowerButton(int);
+    void deviceActivated(int);
+    void epollActivated(int);
+    void readerActivated(int);
     void translatedKeyReceived(struct input_event &ev);
 
 private:
     void cleanSocket();
-    void handleKeyEvent(int fd, EventType eventType);
-    void broadcastToClients(struct input_event &ev);
+    void dispatchDevice(int fd);
+    void openDevice(InputDevice *device);
+    void closeDevice(InputDevice *device);
+    void addDevice(InputDevice *device);
+    void removeDevice(InputDevice *device);
+    void handleKeyEvent(InputDevice *device);
+    void processEvents(InputDevice *device, struct input_event *events, int count);
+    void resyncDevice(InputDevice *device);
+    void handleControlEvent(KeydClient *client, struct input_event &ev);
+    void queueEvent(struct input_event &ev);
+    void flushEvents();
+    void sendToClient(KeydClient *client, const struct input_event *events, int count);
+    int collectStates(__u32 mask, struct input_event *states);
+    void answerQuery(KeydClient *client, __u32 mask, __u32 cookie);
+    void sendSnapshot(KeydClient *client);
+    void writeToClient(KeydClient *client, const struct input_event *events, int count,
+                       __u16 flags = 0, __u32 cookie = 0);
+    void enqueueEvent(KeydClient *client, const struct input_event &ev);
+    void compactQueue(KeydClient *client);
+    void drainQueue(KeydClient *client, bool force);
+    KeydClient *findClient(QLocalSocket *socket);
     bool isKeySupported(struct input_event &ev);
-    bool isHeadset(int fd);
     void openHandles();
     void closeHandles();
-    void closeBT();
     void removeInotifyWatch();
     void failStart(const char *fmt, ...);
-    bool isKeyPressed(int fd, int key);
+    bool isKeyPressed(const struct input_event &ev);
+    void createStateTable();
+    void destroyStateTable();
+    void refreshStateTable();
+    void invalidateStateTable(volatile struct qmkeyd_state *table);
 
     QLocalServer *server;
-    QVector<QLocalSocket*> connections;
+    QVector<KeydClient*> connections;
+
+    struct input_event pendingEvents[QMKEYD_MAX_BATCH];
+    __u32 pendingMasks[QMKEYD_MAX_BATCH];
+    int pendingCount;
+    bool draining;
+
+    QSocketNotifier *inputNotifier;
+
+    InputDeviceRegistry registry;
+
+    /* Dispatch table of the open input devices, by descriptor */
+    QHash<int, InputDevice*> devices;
+    int epollFd;
+    QSocketNotifier *epollNotifier;
+
+    /* Only in thread mode, reads the devices instead of the main loop */
+    InputReader *reader;
+    QSocketNotifier *readerNotifier;
 
-    int gpioFile, keypadFile, eciFile, powerButtonFile, btFile;
-    QSocketNotifier *gpioNotifier, *keypadNotifier, *eciNotifier, *powerButtonNotifier, *btNotifier, *inputNotifier;
+    volatile struct qmkeyd_state *stateTable;
 
     int inotifyWd, inotifyFd;
-    char *btfname;
     int users;
 
-    KeyTranslator keyTranslator[2];
+    KeyMap keyMap;
+    QVector<KeyTranslator*> translators;
 };
 
 #endif // QMKEYD_H
@@ -34,6 +34,7 @@ namespace MeeGo {
     {
         QmAccelerometerPrivate *priv = new QmAccelerometerPrivate(this);
         connect(priv, SIGNAL(dataAvailable(MeeGo::QmAccelerometerReading)), this, SIGNAL(dataAvailable(MeeGo::QmAccelerometerReading)));
+        connect(priv, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmAccelerometerReading>)), this, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmAccelerometerReading>)));
         priv_ptr = priv;
     }
 
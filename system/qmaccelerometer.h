@@ -33,6 +33,7 @@
 #include "system_global.h"
 #include <QtCore/qobject.h>
 #include <qmsensor.h>
+#include <QVector>
 
 QT_BEGIN_HEADER
 
@@ -120,6 +121,12 @@ namespace MeeGo {
          */
         void dataAvailable(const MeeGo::QmAccelerometerReading& data);
 
+        /**
+         * Signals the availability of a batch of measurements, when the sensor
+         * is batching. See QmSensor::setBatching().
+         * @param data Available measurement data, the oldest first
+         */
+        void dataBatchAvailable(const QVector<MeeGo::QmAccelerometerReading>& data);
     };
 
 } // MeeGo namespace
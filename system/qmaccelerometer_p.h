@@ -31,6 +31,8 @@
 
 #include "qmaccelerometer.h"
 #include "qmsensor_p.h"
+#include "qmsensorhub_p.h"
+#include "qmsensortransform_p.h"
 #include "accelerometersensor_i.h"
 #include "sensormanagerinterface.h"
 
@@ -46,7 +48,7 @@ namespace MeeGo
     public:
         AccelerometerSensorChannelInterface* sensorIfc;
 
-        QmAccelerometerPrivate(QmAccelerometer *parent) : QmSensorPrivate(parent), sensorIfc(NULL) {
+        QmAccelerometerPrivate(QmAccelerometer *parent) : QmSensorPrivate(parent), sensorIfc(NULL), cursor_(0) {
             pub_ptr = parent;
         }
 
@@ -76,6 +78,16 @@ namespace MeeGo
             return AccelerometerSensorChannelInterface::listenInterface("accelerometersensor");
         }
 
+        bool sharesSession() const
+        {
+            return true;
+        }
+
+        QmSensorHub* acquireHub(QmSensor::SessionType type)
+        {
+            return QmSensorHub::get_hub<QmXYZHub>("accelerometersensor", this, type);
+        }
+
         bool setupSignals(bool setOn)
         {
             MEEGO_PUBLIC(QmAccelerometer);
@@ -83,14 +95,16 @@ namespace MeeGo
                 return false;
             }
             if (setOn) {
-                if (!connect(sensorIfc, SIGNAL(dataAvailable(const XYZ)), this, SLOT(slotDataAvailable(XYZ))))
+                // Read only the samples published from now on
+                cursor_ = static_cast<QmXYZHub*>(hub_)->ring.cursor();
+                if (!connect(hub_, SIGNAL(published()), this, SLOT(slotPublished())))
 
                 {
                     setError("Unable to connect signals");
                     return false;
                 }
             } else {
-                if (!disconnect(sensorIfc, SIGNAL(dataAvailable(const XYZ)), this, SLOT(slotDataAvailable(XYZ))))
+                if (!disconnect(hub_, SIGNAL(published()), this, SLOT(slotPublished())))
                 {
                     setError("Unable to disconnect signals");
                     return false;
@@ -99,22 +113,74 @@ namespace MeeGo
             return true;
         }
 
+        void reserveBatch(int capacity)
+        {
+            batch_.reserve(capacity);
+        }
+
+        bool filtersSamples() const
+        {
+            return true;
+        }
+
     Q_SIGNALS:
 
         void dataAvailable(const MeeGo::QmAccelerometerReading& data);
+        void dataBatchAvailable(const QVector<MeeGo::QmAccelerometerReading>& data);
 
     public Q_SLOTS:
 
-        void slotDataAvailable(const XYZ& data)
+        void flushBatch()
+        {
+            if (!batch_.isEmpty()) {
+                emit dataBatchAvailable(batch_.take());
+            }
+        }
+
+        void slotPublished()
         {
-            QmAccelerometerReading output;
-            output.timestamp = data.XYZData().timestamp_;
-            output.x = -data.y();
-            output.y = data.x();
-            output.z = data.z();
+            TimedXyzData sample;
+            while (static_cast<QmXYZHub*>(hub_)->ring.read(cursor_, sample)) {
+                if (block_.append(sample.timestamp_, sample.x_, sample.y_, sample.z_)) {
+                    deliverBlock();
+                }
+            }
+            deliverBlock();
+        }
 
+    private:
+        void deliverBlock()
+        {
+            QmSensorTransform::remapAccelerometer(block_.x, block_.y, block_.z,
+                                                  block_.x, block_.y, block_.z, block_.count);
+            for (int i = 0; i < block_.count; i++) {
+                QmAccelerometerReading output;
+                output.timestamp = block_.timestamp[i];
+                output.x = block_.x[i];
+                output.y = block_.y[i];
+                output.z = block_.z[i];
+                if (!filters_.isEmpty()) {
+                    filters_.apply(output.x, output.y, output.z);
+                }
+                deliver(output);
+            }
+            block_.count = 0;
+        }
+
+        void deliver(const QmAccelerometerReading& output)
+        {
+            if (batching()) {
+                if (batch_.append(output)) {
+                    flushBatch();
+                }
+                return;
+            }
             emit dataAvailable(output);
         }
+
+        QmSensorBatch<QmAccelerometerReading> batch_;
+        unsigned int cursor_;
+        QmXYZBlock block_;
     };
 }
 #endif // QMACCELEROMETER_P_H
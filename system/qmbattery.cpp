@@ -72,6 +72,24 @@ extern "C" {
 
 #define USETIME_METHOD_GET_CURRENT "getCurrent"
 
+/*
+ * How long the average currents from usetime and the currents learned from
+ * the measured drain are used, in seconds
+ */
+#define USETIME_CURRENT_TIMEOUT 300
+
+/* How long a calibration of the local use time estimates is used, in seconds */
+#define USETIME_CALIBRATION_TIMEOUT 600
+
+/* Weight of a new BME estimate in the calibration */
+#define USETIME_CALIBRATION_WEIGHT 0.25
+
+/* The window the drain of the battery is measured over, in seconds */
+#define MEASURED_CURRENT_WINDOW 60
+
+/* Weight of a new measured drain in the learned current */
+#define USETIME_LEARNING_WEIGHT 0.25
+
 
 #define dbg(a) qDebug() << __PRETTY_FUNCTION__ << ": " << a
 
@@ -244,20 +262,51 @@ public:
 
     inline bool is_opened() { return mq_ >= 0; }
 
-    bool measure(int &current)
+    bool measure(QmBatteryMeasurement &measurement)
+    {
+        return receive_(measurement) > 0;
+    }
+
+    /* Takes all the pending measurements without blocking */
+    int drain(QList<QmBatteryMeasurement> &measurements)
+    {
+        QmBatteryMeasurement measurement;
+        int count = 0;
+        int rc;
+
+        while ((rc = receive_(measurement)) >= 0) {
+            if (rc > 0) {
+                measurements.append(measurement);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    QSocketNotifier *notifier() const { return notifier_.data(); }
+
+private:
+
+    /*
+     * Returns 1 for a measurement, 0 for a message without one, and -1
+     * when the queue is empty or cannot be read
+     */
+    int receive_(QmBatteryMeasurement &measurement)
     {
-        current = 0;
+        memset(&measurement, 0, sizeof(measurement));
 
         if (!is_opened())
-            return false;
+            return -1;
 
         int n;
         bmeipc_meas_t msg;
         n = mq_receive(mq_, (char *)&msg, sizeof(msg), 0);
         
         if (0 > n) {
-            qDebug() << "failed to receive message: "
-                     << strerror(errno);
+            if (errno != EAGAIN)
+                qDebug() << "failed to receive message: "
+                         << strerror(errno);
+            return -1;
         } else if (n != sizeof(msg)) {
             qDebug() << "bad message size: need "
                      << sizeof (msg) << ", got " << n;
@@ -267,16 +316,16 @@ public:
             qDebug() << "measurements are off";
         } else {
             DUMP_MSG(msg);
-            current = msg.bat_current;
-            return true;
+            measurement.timestamp = (qint64)msg.timestamp.tv_sec * 1000000
+                                    + msg.timestamp.tv_usec;
+            measurement.current = msg.bat_current;
+            measurement.voltage = msg.bat_voltage;
+            measurement.temperature = msg.bat_temp;
+            return 1;
         }
-        return false;
+        return 0;
     }
 
-    QSocketNotifier const* notifier() const { return notifier_.data(); }
-
-private:
-
     inline bool request_measurements_(unsigned int period)
     {
         struct emsg_measurement_req req;
@@ -317,7 +366,7 @@ private:
         if (!request_measurements_(period_))
             return;
 
-        mq_ = mq_open(BMEIPC_MQNAME, O_RDONLY);
+        mq_ = mq_open(BMEIPC_MQNAME, O_RDONLY | O_NONBLOCK);
         if (!is_opened())
             return;
 
@@ -352,20 +401,114 @@ private:
 };
 
 
+/*------------ class MeasurementRing ------------*/
+void MeasurementRing::push(const QmBatteryMeasurement &measurement)
+{
+    ring_[head_ & (MEASUREMENT_RING_SIZE - 1)] = measurement;
+
+    /* Publish the head only after the measurement is complete */
+    __sync_synchronize();
+    head_ = head_ + 1;
+}
+
+QList<QmBatteryMeasurement> MeasurementRing::latest(int count) const
+{
+    QList<QmBatteryMeasurement> result;
+    unsigned int head = head_;
+
+    /* Read the measurements only after seeing the head that published them */
+    __sync_synchronize();
+
+    unsigned int available = qMin(head, (unsigned int)MEASUREMENT_RING_SIZE);
+    unsigned int first = head - qMin((unsigned int)count, available);
+
+    for (unsigned int i = first; i != head; i++)
+        result.append(ring_[i & (MEASUREMENT_RING_SIZE - 1)]);
+
+    /*
+     * Drop what the writer overwrote while the measurements were copied,
+     * including the one it may be writing now
+     */
+    __sync_synchronize();
+    unsigned int overwritten = head_ - first;
+    if (overwritten >= MEASUREMENT_RING_SIZE) {
+        result = result.mid(qMin((int)(overwritten - MEASUREMENT_RING_SIZE + 1),
+                                 result.count()));
+    }
+    return result;
+}
+
+
+/*------------ class UsetimeEstimator ------------*/
+int UsetimeEstimator::current(qint64 now) const
+{
+    return now < current_expire_ ? current_ : 0;
+}
+
+void UsetimeEstimator::learn(int current, qint64 now)
+{
+    if (current <= 0)
+	return;
+
+    if (now < current_expire_) {
+	current_ += (int)((current - current_) * USETIME_LEARNING_WEIGHT);
+    } else {
+	current_ = current;
+    }
+    current_expire_ = now + USETIME_CURRENT_TIMEOUT * 1000;
+}
+
+int UsetimeEstimator::estimate(int capacity, int current, bool charging,
+			       qint64 now) const
+{
+    if (scale_ <= 0 || now >= expire_ || charging != charging_)
+	return -1;
+    if (capacity < 0 || current <= 0)
+	return -1;
+
+    /* mAh / mA in seconds */
+    return (int)(capacity * 3600.0 / current * scale_);
+}
+
+void UsetimeEstimator::calibrate(int capacity, int current, int time,
+				 bool charging, qint64 now)
+{
+    if (capacity <= 0 || current <= 0 || time < 0)
+	return;
+
+    double scale = time / (capacity * 3600.0 / current);
+
+    if (scale_ > 0 && charging == charging_) {
+	scale_ += (scale - scale_) * USETIME_CALIBRATION_WEIGHT;
+    } else {
+	scale_ = scale;
+    }
+    charging_ = charging;
+    expire_ = now + USETIME_CALIBRATION_TIMEOUT * 1000;
+}
+
+
 /*------------ class QmBatteryPrivate ------------*/
 QmBatteryPrivate::QmBatteryPrivate()
 	: parent_(0),
       is_data_actual_(false),
-      cache_expire_(QDateTime::currentDateTime()),
+      cache_expire_(0),
       cc_offset_(0),
       prev_cc_restart_count_(-1),
+      cc_sample_(0),
+      cc_sample_time_(0),
+      cc_current_(0),
+      cc_current_expire_(0),
       ipc_(new EmIpc()),
-      events_(new EmEvents())
+      events_(new EmEvents()),
+      delivery_interval_(0),
+      learn_time_(0)
 {
     memset(&stat_, 0, sizeof(stat_));
     timer = new QTimer();
     connect(timer, SIGNAL(timeout()), this, SLOT(waitForUSB500mA()));
     usb100ma_emit_delayed = 0;
+    connect(&delivery_timer_, SIGNAL(timeout()), this, SLOT(onMeasurementDelivery()));
 }
 
 QmBatteryPrivate::~QmBatteryPrivate() {
@@ -385,13 +528,26 @@ bool QmBatteryPrivate::init(QmBattery *parent)
     return true;
 }
 
-void QmBatteryPrivate::queryStat_() const
+static qint64 monotonicMs()
 {
-    QDateTime now(QDateTime::currentDateTime());
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * The statistics are read from BME only when an event from BME has
+ * invalidated them, or when they are older than STAT_EXPIRATION_TIMEOUT,
+ * for the values BME does not send events for. Returns false if there
+ * are no statistics.
+ */
+bool QmBatteryPrivate::queryStat_() const
+{
+    qint64 now = monotonicMs();
 
     if (!is_data_actual_ || now >= cache_expire_) {
         if (!ipc_->open())
-	    return;
+	    return false;
 
 	int prev_cc = stat_[COULOMB_COUNTER];
 	
@@ -399,10 +555,10 @@ void QmBatteryPrivate::queryStat_() const
 	request.type = BME_SYSMSG_GETSTAT;
 	request.subtype = 0;
 	if (!ipc_->query(&request, sizeof(request), &stat_, sizeof(stat_)))
-	    return;
+	    return false;
 	    
 	is_data_actual_ = true;
-        cache_expire_ = now.addSecs(STAT_EXPIRATION_TIMEOUT);
+        cache_expire_ = now + STAT_EXPIRATION_TIMEOUT * 1000;
 
 	if (prev_cc_restart_count_ != ipc_->restart_count()) {
 	    /* 
@@ -418,7 +574,29 @@ void QmBatteryPrivate::queryStat_() const
 		     << "new offset:" << cc_offset_;
 	    prev_cc_restart_count_ = ipc_->restart_count();
 	}
+	sampleCoulombCounter_(now);
     }
+    return true;
+}
+
+/*
+ * The average drain since the previous sample of the coulomb counter, when
+ * the samples are at least MEASURED_CURRENT_WINDOW apart
+ */
+void QmBatteryPrivate::sampleCoulombCounter_(qint64 now) const
+{
+    int cc = stat_[COULOMB_COUNTER] + cc_offset_;
+
+    if (cc_sample_time_ != 0) {
+	if (now - cc_sample_time_ < MEASURED_CURRENT_WINDOW * 1000)
+	    return;
+
+	cc_current_ = (int)((qint64)(cc - cc_sample_) * 1000
+			    / (now - cc_sample_time_));
+	cc_current_expire_ = now + USETIME_CURRENT_TIMEOUT * 1000;
+    }
+    cc_sample_ = cc;
+    cc_sample_time_ = now;
 }
 
 void QmBatteryPrivate::saveStat_()
@@ -433,6 +611,14 @@ int QmBatteryPrivate::getStat(int index) const
     return stat_[index];
 }
 
+/* All the statistics with at most one query */
+bool QmBatteryPrivate::getStats(bmestat_t &stat) const
+{
+    bool ok = queryStat_();
+    memcpy(&stat, &stat_, sizeof(stat));
+    return ok;
+}
+
 int QmBatteryPrivate::getCumulativeBatteryCurrent()
 {
     return getStat(COULOMB_COUNTER) + cc_offset_;
@@ -446,15 +632,131 @@ int QmBatteryPrivate::getAverageCurrent(int usageMode,
 				  usageMode, psMode);
     if (result < 0)
 	result = defaultCurrent;
-    
+
     return result;
 }
 
+/*
+ * The average current from usetime for the local estimates, cached for
+ * USETIME_CURRENT_TIMEOUT. Returns -1 if usetime does not answer, which is
+ * not cached.
+ */
+int QmBatteryPrivate::usetimeCurrent_(int usageMode,
+				      QmBattery::RemainingTimeMode psMode,
+				      qint64 now) const
+{
+    UsetimeCurrent &cached =
+	usetime_currents_[usageMode - 1][psMode == QmBattery::PowersaveMode];
+
+    if (now >= cached.expire) {
+	int result = makeUsetimeQuery(USETIME_METHOD_GET_CURRENT,
+				      usageMode, psMode);
+	if (result < 0)
+	    return -1;
+
+	cached.current = result;
+	cached.expire = now + USETIME_CURRENT_TIMEOUT * 1000;
+    }
+
+    return cached.current;
+}
+
+/*
+ * The drain of the battery now: the mean of the current measurements of
+ * the last MEASURED_CURRENT_WINDOW while they are being made, otherwise
+ * the drain from the coulomb counter. Returns -1 if neither is known or
+ * the battery is not being drained.
+ */
+int QmBatteryPrivate::measuredCurrent_(qint64 now) const
+{
+    if (!measurements_.isNull()) {
+	QmBatteryMeasurementStats stats =
+	    getMeasurementStats(MEASURED_CURRENT_WINDOW * 1000);
+	if (stats.count > 0)
+	    return stats.meanCurrent > 0 ? stats.meanCurrent : -1;
+    }
+
+    if (now < cc_current_expire_ && cc_current_ > 0)
+	return cc_current_;
+
+    return -1;
+}
+
+/*
+ * Teaches the measured drain to the use time mode the device is in, which
+ * is taken to be the mode with the nearest average current. The drain is
+ * learned at most once per MEASURED_CURRENT_WINDOW.
+ */
+void QmBatteryPrivate::learnCurrent_(QmBattery::RemainingTimeMode psMode,
+				     bool charging, qint64 now) const
+{
+    static const int defaults[3] = {
+	DEFAULT_IDLE_CURRENT, DEFAULT_ACTIVE_CURRENT, DEFAULT_TALK_CURRENT
+    };
+    int ps = psMode == QmBattery::PowersaveMode;
+
+    if (charging || (learn_time_ != 0
+		     && now - learn_time_ < MEASURED_CURRENT_WINDOW * 1000))
+	return;
+
+    int measured = measuredCurrent_(now);
+    if (measured <= 0)
+	return;
+    learn_time_ = now;
+
+    int nearest = -1;
+    double nearest_ratio = 0;
+    for (int mode = 0; mode < 3; mode++) {
+	/* No IPC here, the modes not known yet use the defaults */
+	int current = usetime_estimators_[mode][ps].current(now);
+	if (current <= 0 && now < usetime_currents_[mode][ps].expire)
+	    current = usetime_currents_[mode][ps].current;
+	if (current <= 0)
+	    current = defaults[mode];
+
+	double ratio = measured > current ? (double)measured / current
+					  : (double)current / measured;
+	if (nearest < 0 || ratio < nearest_ratio) {
+	    nearest = mode;
+	    nearest_ratio = ratio;
+	}
+    }
+
+    usetime_estimators_[nearest][ps].learn(measured, now);
+}
+
+/*
+ * The remaining time is estimated locally while there is a calibration
+ * from BME, otherwise BME is asked and its answer calibrates the local
+ * estimates. The current of the mode the device is in is learned from the
+ * measured drain; the other modes use the average currents from usetime.
+ */
 int QmBatteryPrivate::getRemainingTime(int usageMode,
 				       QmBattery::RemainingTimeMode psMode,
 				       int defaultCurrent) const
 {
-    int current = getAverageCurrent(usageMode, psMode, defaultCurrent);
+    UsetimeEstimator &estimator =
+	usetime_estimators_[usageMode - 1][psMode == QmBattery::PowersaveMode];
+    qint64 now = monotonicMs();
+    bmestat_t stat;
+    bool have_stat = getStats(stat);
+    bool charging = stat[CHARGING_STATE] == CHARGING_STATE_STARTED;
+
+    if (have_stat)
+	learnCurrent_(psMode, charging, now);
+
+    int current = estimator.current(now);
+    if (current <= 0)
+	current = usetimeCurrent_(usageMode, psMode, now);
+    if (current <= 0)
+	current = defaultCurrent;
+
+    if (have_stat) {
+	int time = estimator.estimate(stat[BATTERY_CAPA_NOW], current,
+				      charging, now);
+	if (time >= 0)
+	    return time;
+    }
 
     union emsg_usetime_info msg;
     memset(&msg, 0, sizeof(msg));
@@ -469,6 +771,11 @@ int QmBatteryPrivate::getRemainingTime(int usageMode,
     qDebug() << __FUNCTION__ << usageMode << psMode
 	     << "current (mA):" << current
 	     << "remaining time (s):" << msg.reply.time;
+
+    if (have_stat) {
+	estimator.calibrate(stat[BATTERY_CAPA_NOW], current,
+			    msg.reply.time, charging, now);
+    }
     
     return msg.reply.time;
 }
@@ -545,12 +852,18 @@ bool QmBatteryPrivate::startCurrentMeasurement(QmBattery::Period rate)
 
     connect(measurements_->notifier(), SIGNAL(activated(int))
             , this, SLOT(onMeasurement(int)));
+    applyMeasurementDelivery_();
 
     return true;
 }
 
 bool QmBatteryPrivate::stopCurrentMeasurement()
 {
+    if (delivery_timer_.isActive()) {
+        delivery_timer_.stop();
+        onMeasurementDelivery();
+    }
+
     measurements_->close();
     if (measurements_->is_opened()) {
         qDebug() << "QmBattery::stopCurrentMeasurement failed";
@@ -562,16 +875,116 @@ bool QmBatteryPrivate::stopCurrentMeasurement()
 
 void QmBatteryPrivate::onMeasurement(int /*socket*/)
 {
-    bool rc;
-    int current;
+    QmBatteryMeasurement measurement;
 
     if (measurements_.isNull()) {
         qWarning() << "onMeasurement: null";
         return;
     }
 
-    rc = measurements_->measure(current);
-    emit parent_->batteryCurrent(current);
+    if (measurements_->measure(measurement))
+        history_.push(measurement);
+    emit parent_->batteryCurrent(measurement.current);
+}
+
+/* Delivers the measurements that arrived during the delivery interval */
+void QmBatteryPrivate::onMeasurementDelivery()
+{
+    QList<QmBatteryMeasurement> measurements;
+
+    if (measurements_.isNull())
+        return;
+
+    if (measurements_->drain(measurements) == 0)
+        return;
+
+    foreach (const QmBatteryMeasurement &measurement, measurements)
+        history_.push(measurement);
+    emit parent_->batteryMeasurements(measurements);
+}
+
+bool QmBatteryPrivate::setMeasurementDeliveryInterval(int interval)
+{
+    if (interval < 0)
+        return false;
+
+    /* Deliver what arrived at the old interval first */
+    if (delivery_timer_.isActive())
+        onMeasurementDelivery();
+
+    delivery_interval_ = interval;
+    applyMeasurementDelivery_();
+    return true;
+}
+
+/*
+ * At a delivery interval the queue is drained by the delivery timer, and
+ * the notifier stays disabled so that each message does not wake us up
+ */
+void QmBatteryPrivate::applyMeasurementDelivery_()
+{
+    if (measurements_.isNull() || !measurements_->is_opened()) {
+        delivery_timer_.stop();
+        return;
+    }
+
+    measurements_->notifier()->setEnabled(delivery_interval_ == 0);
+    if (delivery_interval_ > 0)
+        delivery_timer_.start(delivery_interval_);
+    else
+        delivery_timer_.stop();
+}
+
+QList<QmBatteryMeasurement> QmBatteryPrivate::getMeasurementHistory(int count) const
+{
+    if (count < 0 || count > MEASUREMENT_RING_SIZE)
+        count = MEASUREMENT_RING_SIZE;
+    return history_.latest(count);
+}
+
+QmBatteryMeasurementStats QmBatteryPrivate::getMeasurementStats(int window) const
+{
+    QmBatteryMeasurementStats stats;
+    QList<QmBatteryMeasurement> history = history_.latest(MEASUREMENT_RING_SIZE);
+
+    if (history.isEmpty())
+        return stats;
+
+    qint64 start = history.last().timestamp - (qint64)window * 1000;
+    int first = history.count() - 1;
+    while (first > 0 && history[first - 1].timestamp >= start)
+        first--;
+
+    const QmBatteryMeasurement &oldest = history[first];
+    qint64 current_sum = 0;
+    qint64 voltage_sum = 0;
+
+    stats.count = history.count() - first;
+    stats.duration = history.last().timestamp - oldest.timestamp;
+    stats.minCurrent = stats.maxCurrent = oldest.current;
+    stats.minVoltage = stats.maxVoltage = oldest.voltage;
+
+    for (int i = first; i < history.count(); i++) {
+        const QmBatteryMeasurement &m = history[i];
+
+        stats.minCurrent = qMin(stats.minCurrent, m.current);
+        stats.maxCurrent = qMax(stats.maxCurrent, m.current);
+        stats.minVoltage = qMin(stats.minVoltage, m.voltage);
+        stats.maxVoltage = qMax(stats.maxVoltage, m.voltage);
+        current_sum += m.current;
+        voltage_sum += m.voltage;
+
+        /* The power of a measurement holds until the next one; mA * mV * us = pJ */
+        if (i > first) {
+            const QmBatteryMeasurement &prev = history[i - 1];
+            stats.energy += (double)prev.current * prev.voltage
+                            * (m.timestamp - prev.timestamp) / 1e9;
+        }
+    }
+
+    stats.meanCurrent = current_sum / stats.count;
+    stats.meanVoltage = voltage_sum / stats.count;
+    return stats;
 }
 
 void QmBatteryPrivate::emitEventBatmon_()
@@ -641,6 +1054,77 @@ void QmBatteryPrivate::onEmEvent(int /*socket*/)
     }
 }
 
+/*------------ BME statistics to QmBattery values ------------*/
+
+static QmBattery::BatteryState toBatteryState(int state)
+{
+    switch (state) {
+    case BATTERY_STATE_EMPTY:
+        return QmBattery::StateEmpty;
+    case BATTERY_STATE_LOW:
+        return QmBattery::StateLow;
+    case BATTERY_STATE_OK:
+        return QmBattery::StateOK;
+    case BATTERY_STATE_FULL:
+        return QmBattery::StateFull;
+    case BATTERY_STATE_ERROR:
+    default:
+        return QmBattery::StateError;
+    }
+}
+
+static QmBattery::ChargerType toChargerType(int type)
+{
+    switch (type) {
+    case CHARGER_TYPE_USB100MA:
+        return QmBattery::USB_100mA;
+    case CHARGER_TYPE_USB500MA:
+        return QmBattery::USB_500mA;
+    case CHARGER_TYPE_USBWALL:
+    case CHARGER_TYPE_DYNAMO:
+        return QmBattery::Wall;
+    case CHARGER_TYPE_NONE:
+        return QmBattery::None;
+    case CHARGER_TYPE_ERROR:
+    default:
+        return QmBattery::Unknown;
+    }
+}
+
+static QmBattery::ChargingState toChargingState(int state)
+{
+    switch (state) {
+    case CHARGING_STATE_STOPPED:
+        return QmBattery::StateNotCharging;
+    case CHARGING_STATE_STARTED:
+        return QmBattery::StateCharging;
+    case CHARGING_STATE_ERROR:
+    default:
+        return QmBattery::StateChargingFailed;
+    }
+}
+
+static int toRemainingChargingTime(const bmestat_t &stat)
+{
+    if (stat[CHARGING_STATE] == CHARGING_STATE_STARTED) {
+	return stat[CHARGING_TIME] * 60;
+    } else {
+	return -1;
+    }
+}
+
+static QmBattery::BatteryCondition toBatteryCondition(int condition)
+{
+    switch (condition) {
+    case BATTERY_CONDITION_GOOD:
+	return QmBattery::ConditionGood;
+    case BATTERY_CONDITION_POOR:
+	return QmBattery::ConditionPoor;
+    default:
+	return QmBattery::ConditionUnknown;
+    }
+}
+
 /*------------ class QmBattery Implementation ------------*/
 
 QmBattery::QmBattery(QObject *parent)
@@ -661,6 +1145,8 @@ QmBattery::QmBattery(QObject *parent)
         ("MeeGo::QmBattery::RemainingTimeMode");
     qRegisterMetaType < Period >
         ("MeeGo::QmBattery::Period");
+    qRegisterMetaType < QList<QmBatteryMeasurement> >
+        ("QList<MeeGo::QmBatteryMeasurement>");
 
     /* Depreceated, use BatteryState */
     qRegisterMetaType < Level >
@@ -676,19 +1162,7 @@ int QmBattery::getNominalCapacity() const
 
 QmBattery::BatteryState QmBattery::getBatteryState() const
 {
-    switch (pimpl_->getStat(BATTERY_STATE)) {
-    case BATTERY_STATE_EMPTY:
-        return StateEmpty;
-    case BATTERY_STATE_LOW:
-        return StateLow;
-    case BATTERY_STATE_OK:
-        return StateOK;
-    case BATTERY_STATE_FULL:
-        return StateFull;
-    case BATTERY_STATE_ERROR:
-    default:
-        return StateError;
-    }
+    return toBatteryState(pimpl_->getStat(BATTERY_STATE));
 }
 
 int QmBattery::getRemainingCapacitymAh() const
@@ -728,42 +1202,19 @@ int QmBattery::getCumulativeBatteryCurrent() const
 
 QmBattery::ChargerType QmBattery::getChargerType() const
 {
-    switch (pimpl_->getStat(CHARGER_TYPE)) {
-    case CHARGER_TYPE_USB100MA:
-        return USB_100mA;
-    case CHARGER_TYPE_USB500MA:
-        return USB_500mA;
-    case CHARGER_TYPE_USBWALL:
-    case CHARGER_TYPE_DYNAMO:
-        return Wall;
-    case CHARGER_TYPE_NONE:
-        return None;
-    case CHARGER_TYPE_ERROR:
-    default:
-        return Unknown;
-    }
+    return toChargerType(pimpl_->getStat(CHARGER_TYPE));
 }
 
 QmBattery::ChargingState QmBattery::getChargingState() const
 {
-    switch (pimpl_->getStat(CHARGING_STATE)) {
-    case CHARGING_STATE_STOPPED:
-        return StateNotCharging;
-    case CHARGING_STATE_STARTED:
-        return StateCharging;
-    case CHARGING_STATE_ERROR:
-    default:
-        return StateChargingFailed;
-    }
+    return toChargingState(pimpl_->getStat(CHARGING_STATE));
 }
 
 int QmBattery::getRemainingChargingTime() const
 {
-    if (pimpl_->getStat(CHARGING_STATE) == CHARGING_STATE_STARTED) {
-	return pimpl_->getStat(CHARGING_TIME) * 60;
-    } else {
-	return -1;
-    }
+    bmestat_t stat;
+    pimpl_->getStats(stat);
+    return toRemainingChargingTime(stat);
 }
 
 bool QmBattery::startCurrentMeasurement(Period rate)
@@ -814,14 +1265,47 @@ int QmBattery::getRemainingIdleTime(QmBattery::RemainingTimeMode mode) const
 
 QmBattery::BatteryCondition QmBattery::getBatteryCondition() const
 {
-    switch (pimpl_->getStat(BATTERY_CONDITION)) {
-    case BATTERY_CONDITION_GOOD:
-	return ConditionGood;
-    case BATTERY_CONDITION_POOR:
-	return ConditionPoor;
-    default:
-	return ConditionUnknown;
-    }
+    return toBatteryCondition(pimpl_->getStat(BATTERY_CONDITION));
+}
+
+QList<QmBatteryMeasurement> QmBattery::getMeasurementHistory(int count) const
+{
+    return pimpl_->getMeasurementHistory(count);
+}
+
+QmBatteryMeasurementStats QmBattery::getMeasurementStats(int window) const
+{
+    return pimpl_->getMeasurementStats(window);
+}
+
+bool QmBattery::setMeasurementDeliveryInterval(int interval)
+{
+    return pimpl_->setMeasurementDeliveryInterval(interval);
+}
+
+QmBatterySnapshot QmBattery::getSnapshot() const
+{
+    QmBatterySnapshot snapshot;
+    bmestat_t stat;
+
+    snapshot.valid = pimpl_->getStats(stat);
+    if (!snapshot.valid)
+        return snapshot;
+
+    snapshot.nominalCapacity = stat[BATTERY_CAPA_MAX];
+    snapshot.batteryState = toBatteryState(stat[BATTERY_STATE]);
+    snapshot.remainingCapacitymAh = stat[BATTERY_CAPA_NOW];
+    snapshot.remainingCapacityPct = stat[BATTERY_LEVEL_PCT];
+    snapshot.remainingCapacityBars = stat[BATTERY_LEVEL_NOW];
+    snapshot.maxBars = stat[BATTERY_LEVEL_MAX];
+    snapshot.voltage = stat[BATTERY_VOLT_NOW];
+    snapshot.batteryCurrent = stat[BATTERY_CURRENT];
+    snapshot.cumulativeBatteryCurrent = pimpl_->getCumulativeBatteryCurrent();
+    snapshot.chargerType = toChargerType(stat[CHARGER_TYPE]);
+    snapshot.chargingState = toChargingState(stat[CHARGING_STATE]);
+    snapshot.remainingChargingTime = toRemainingChargingTime(stat);
+    snapshot.batteryCondition = toBatteryCondition(stat[BATTERY_CONDITION]);
+    return snapshot;
 }
 
 int QmBattery::getBatteryEnergyLevel() const
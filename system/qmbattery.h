@@ -46,6 +46,9 @@ QT_BEGIN_HEADER
 namespace MeeGo {
 
 class QmBatteryPrivate;
+struct QmBatterySnapshot;
+struct QmBatteryMeasurement;
+struct QmBatteryMeasurementStats;
 
 /*!
  *
@@ -269,19 +272,70 @@ public:
      */
     bool stopCurrentMeasurement();
 
+    /*!
+     * @brief Gets the latest current measurements.
+     *
+     * The measurements made since startCurrentMeasurement() are kept in
+     * a history of fixed size, which is also kept after
+     * stopCurrentMeasurement().
+     *
+     * @param count  The number of measurements, or -1 for the whole history
+     *
+     * @return The measurements, the oldest first
+     */
+    QList<QmBatteryMeasurement> getMeasurementHistory(int count = -1) const;
+
+    /*!
+     * @brief Gets statistics of the latest current measurements.
+     *
+     * @param window  The time before the latest measurement the statistics
+     *                cover, in milliseconds
+     *
+     * @return The statistics, with count zero if there are no measurements
+     */
+    QmBatteryMeasurementStats getMeasurementStats(int window) const;
+
+    /*!
+     * @brief Sets how often the current measurements are delivered.
+     *
+     * By default each measurement is delivered by its own batteryCurrent
+     * signal as soon as it arrives. With a delivery interval, the
+     * measurements that arrived during the interval are delivered together
+     * by one batteryMeasurements signal, and batteryCurrent is not sent.
+     * The interval should be shorter than the time BME takes to fill its
+     * measurement queue at the measurement rate.
+     *
+     * @param interval  The delivery interval in milliseconds, or 0 to
+     *                  deliver each measurement as it arrives
+     *
+     * @retval  TRUE   success
+     * @retval  FALSE  failure
+     */
+    bool setMeasurementDeliveryInterval(int interval);
+
     /*!
      * @brief Get the average current in talk mode.
      *
+     * The current is asked from usetime on each call.
+     *
      * @param mode: (PowersaveMode/Normal ) mode for which the current
      *               time is reported.
      *
-     * @returns Average current (mA)
+     * @returns Average current (mA), or a default if usetime is not available
      */
     int getAverageTalkCurrent(RemainingTimeMode mode) const;
 
     /*!
      * @brief Gets the remaining talk time or -1 if not known.
      *
+     * The remaining talk, active and idle times are estimated locally
+     * from the remaining capacity and the average current, and are
+     * calibrated against the estimates of BME every ten minutes.
+     * The average current of the use the device is in is learned from the
+     * measured drain of the battery, the others are asked from usetime at
+     * most every five minutes, so the estimates can lag behind a change of
+     * the use by that long.
+     *
      * @param mode: (PowersaveMode/Normal ) mode in which the remaining
      *               time is to be estimated
      *
@@ -292,10 +346,12 @@ public:
     /*!
      * @brief Get the average current in active use.
      *
+     * The current is asked from usetime on each call.
+     *
      * @param mode: (PowersaveMode/Normal ) mode for which the current
      *               time is reported.
      *
-     * @returns Average current (mA)
+     * @returns Average current (mA), or a default if usetime is not available
      */
     int getAverageActiveCurrent(RemainingTimeMode mode) const;
 
@@ -312,10 +368,12 @@ public:
     /*!
      * @brief Get the average current in idle mode.
      *
+     * The current is asked from usetime on each call.
+     *
      * @param mode: (PowersaveMode/Normal ) mode for which the current
      *               time is reported.
      *
-     * @returns Average current (mA)
+     * @returns Average current (mA), or a default if usetime is not available
      */
     int getAverageIdleCurrent(RemainingTimeMode mode) const;
 
@@ -336,6 +394,18 @@ public:
      */
     BatteryCondition getBatteryCondition() const;
 
+    /*!
+     * @brief Gets all the battery information at once.
+     *
+     * @details The getters above read the same battery statistics, which
+     * are cached until the battery management reports a change. Reading
+     * them through a snapshot guarantees that the values belong together,
+     * and costs at most one query however many of them are used.
+     *
+     * @return The battery information as QmBatterySnapshot
+     */
+    QmBatterySnapshot getSnapshot() const;
+
     /*!
      * @deprecated Deprecated, use getRemainingCapacityPct()
      */
@@ -390,6 +460,14 @@ Q_SIGNALS:
      */
     void batteryCurrent(int current);
 
+    /*!
+     * @brief Sent at the delivery interval when battery current measurement
+     * is enabled with a delivery interval (see setMeasurementDeliveryInterval)
+     *
+     * @param measurements The measurements since the previous signal, the oldest first
+     */
+    void batteryMeasurements(const QList<MeeGo::QmBatteryMeasurement> &measurements);
+
     /*!
      * @deprecated Deprecated, use batteryRemainingCapacityChanged(int, int)
      */
@@ -411,6 +489,80 @@ private:
     QScopedPointer<QmBatteryPrivate> pimpl_;
 };
 
+/*!
+ * @brief The battery information of QmBattery::getSnapshot(), with the
+ * meaning of the QmBattery getter of the same name.
+ */
+struct QmBatterySnapshot
+{
+    QmBatterySnapshot()
+        : valid(false),
+          nominalCapacity(0),
+          batteryState(QmBattery::StateError),
+          remainingCapacitymAh(0),
+          remainingCapacityPct(0),
+          remainingCapacityBars(0),
+          maxBars(0),
+          voltage(0),
+          batteryCurrent(0),
+          cumulativeBatteryCurrent(0),
+          chargerType(QmBattery::Unknown),
+          chargingState(QmBattery::StateChargingFailed),
+          remainingChargingTime(-1),
+          batteryCondition(QmBattery::ConditionUnknown)
+    { }
+
+    bool valid;                         //!< False if the information could not be read
+    int nominalCapacity;                //!< Battery nominal capacity (mAh)
+    QmBattery::BatteryState batteryState;
+    int remainingCapacitymAh;
+    int remainingCapacityPct;
+    int remainingCapacityBars;
+    int maxBars;
+    int voltage;                        //!< Battery voltage (mV)
+    int batteryCurrent;                 //!< Battery current (mA)
+    int cumulativeBatteryCurrent;       //!< Coulomb counter (mAs)
+    QmBattery::ChargerType chargerType;
+    QmBattery::ChargingState chargingState;
+    int remainingChargingTime;          //!< In seconds, -1 if not charging
+    QmBattery::BatteryCondition batteryCondition;
+};
+
+/*!
+ * @brief A battery measurement of the current measurement history.
+ */
+struct QmBatteryMeasurement
+{
+    qint64 timestamp;                   //!< Time of the measurement (us)
+    int current;                        //!< Battery current (mA)
+    int voltage;                        //!< Battery voltage (mV)
+    int temperature;                    //!< Battery temperature (K)
+};
+
+/*!
+ * @brief Statistics of the measurements in a window of the current
+ * measurement history.
+ */
+struct QmBatteryMeasurementStats
+{
+    QmBatteryMeasurementStats()
+        : count(0), duration(0),
+          minCurrent(0), maxCurrent(0), meanCurrent(0),
+          minVoltage(0), maxVoltage(0), meanVoltage(0),
+          energy(0)
+    { }
+
+    int count;                          //!< Number of measurements
+    qint64 duration;                    //!< From the first to the last measurement (us)
+    int minCurrent;                     //!< mA
+    int maxCurrent;                     //!< mA
+    int meanCurrent;                    //!< mA
+    int minVoltage;                     //!< mV
+    int maxVoltage;                     //!< mV
+    int meanVoltage;                    //!< mV
+    double energy;                      //!< Over the duration (mJ)
+};
+
 } // MeeGo namespace
 
 QT_END_HEADER
@@ -35,7 +35,6 @@
 
 #include <QtCore/qobject.h>
 #include <QThread>
-#include <QDateTime>
 #include <QScopedPointer>
 #include <QTimer>
 
@@ -55,6 +54,68 @@ class EmIpc;
 class EmEvents;
 class EmCurrentMeasurement;
 
+/* Measurements kept in the history, a power of two */
+#define MEASUREMENT_RING_SIZE 256
+
+/*
+ * The current measurement history. The measurements are pushed by one
+ * writer and can be read at the same time from other threads without
+ * locking; a reader drops the measurements the writer overwrote while
+ * they were being copied.
+ */
+class MeasurementRing
+{
+public:
+    MeasurementRing() : head_(0) { }
+
+    void push(const QmBatteryMeasurement &measurement);
+    QList<QmBatteryMeasurement> latest(int count) const;
+
+private:
+    QmBatteryMeasurement ring_[MEASUREMENT_RING_SIZE];
+    volatile unsigned int head_;
+};
+
+/*
+ * Estimates the remaining use times from the remaining capacity and the
+ * average current of the use, scaled to agree with the estimates of BME.
+ * The scale is learned from the BME estimates and expires after a while,
+ * or when the charging state changes. Each use time mode learns a scale
+ * of its own, as the ratio differs between talk, active and idle use.
+ * The mode the device is in also learns its current from the measured
+ * drain of the battery, which then replaces the average from usetime.
+ */
+class UsetimeEstimator
+{
+public:
+    UsetimeEstimator()
+	: scale_(0), expire_(0), charging_(false),
+	  current_(0), current_expire_(0) { }
+
+    int current(qint64 now) const;
+    void learn(int current, qint64 now);
+
+    int estimate(int capacity, int current, bool charging, qint64 now) const;
+    void calibrate(int capacity, int current, int time, bool charging, qint64 now);
+
+private:
+    double scale_;      /* BME estimate / (capacity / current), 0 if unknown */
+    qint64 expire_;     /* CLOCK_MONOTONIC, in milliseconds */
+    bool charging_;
+
+    int current_;               /* mA, 0 if not learned */
+    qint64 current_expire_;     /* CLOCK_MONOTONIC, in milliseconds */
+};
+
+/* An average current from usetime */
+struct UsetimeCurrent
+{
+    UsetimeCurrent() : current(0), expire(0) { }
+
+    int current;        /* mA */
+    qint64 expire;      /* CLOCK_MONOTONIC, in milliseconds */
+};
+
 class QmBatteryPrivate : public QObject
 {
     Q_OBJECT
@@ -70,21 +131,35 @@ public:
     bool stopCurrentMeasurement();
 
     int getStat(int) const;
+    bool getStats(bmestat_t &stat) const;
     int getCumulativeBatteryCurrent();
     int getAverageCurrent(int usageMode, QmBattery::RemainingTimeMode psMode,
 			  int defaultCurrent) const;
     int getRemainingTime(int usageMode, QmBattery::RemainingTimeMode psMode,
 			 int defaultCurrent) const;
 
+    QList<QmBatteryMeasurement> getMeasurementHistory(int count) const;
+    QmBatteryMeasurementStats getMeasurementStats(int window) const;
+    bool setMeasurementDeliveryInterval(int interval);
+
 private Q_SLOTS:
     void onEmEvent(int);
     void onMeasurement(int);
+    void onMeasurementDelivery();
     void waitForUSB500mA();
 
 private:
-    void queryStat_() const;
+    bool queryStat_() const;
     void emitEventBatmon_();
     void saveStat_();
+    void applyMeasurementDelivery_();
+    void sampleCoulombCounter_(qint64 now) const;
+
+    int usetimeCurrent_(int usageMode, QmBattery::RemainingTimeMode psMode,
+			qint64 now) const;
+    int measuredCurrent_(qint64 now) const;
+    void learnCurrent_(QmBattery::RemainingTimeMode psMode, bool charging,
+		       qint64 now) const;
 
     int makeUsetimeQuery(const QString& method, int usageMode,
 			 QmBattery::RemainingTimeMode psMode) const;
@@ -93,17 +168,31 @@ private:
 
     mutable bmestat_t stat_;
     mutable bool is_data_actual_;
-    mutable QDateTime cache_expire_;
+    mutable qint64 cache_expire_;    /* CLOCK_MONOTONIC, in milliseconds */
 
     mutable int cc_offset_;
     mutable int prev_cc_restart_count_;
+
+    /* The drain of the battery from the coulomb counter */
+    mutable int cc_sample_;             /* mAs, with cc_offset_ */
+    mutable qint64 cc_sample_time_;     /* CLOCK_MONOTONIC, in milliseconds */
+    mutable int cc_current_;            /* mA */
+    mutable qint64 cc_current_expire_;  /* CLOCK_MONOTONIC, in milliseconds */
     bmestat_t saved_stat_;
 
     QScopedPointer<EmIpc> ipc_;
     QScopedPointer<EmEvents> events_;
     QScopedPointer<EmCurrentMeasurement> measurements_;
+    MeasurementRing history_;
+    int delivery_interval_;
+    QTimer delivery_timer_;
     QTimer *timer;
     int usb100ma_emit_delayed;
+
+    /* Indexed by use time mode - 1 and power save mode */
+    mutable UsetimeCurrent usetime_currents_[3][2];
+    mutable UsetimeEstimator usetime_estimators_[3][2];
+    mutable qint64 learn_time_;         /* CLOCK_MONOTONIC, in milliseconds */
 };
 
 } /* MeeGo */
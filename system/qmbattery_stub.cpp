@@ -113,6 +113,21 @@ namespace MeeGo
         return false;
     }
 
+    QList<QmBatteryMeasurement> QmBattery::getMeasurementHistory(int) const
+    {
+        return QList<QmBatteryMeasurement>();
+    }
+
+    QmBatteryMeasurementStats QmBattery::getMeasurementStats(int) const
+    {
+        return QmBatteryMeasurementStats();
+    }
+
+    bool QmBattery::setMeasurementDeliveryInterval(int)
+    {
+        return false;
+    }
+
     int QmBattery::getAverageTalkCurrent(RemainingTimeMode mode) const
     {
         return 0;
@@ -148,6 +163,11 @@ namespace MeeGo
         return QmBattery::ConditionUnknown;
     }
 
+    QmBatterySnapshot QmBattery::getSnapshot() const
+    {
+        return QmBatterySnapshot();
+    }
+
     int QmBattery::getBatteryEnergyLevel() const
     {
         return 0;
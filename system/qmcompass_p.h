@@ -31,6 +31,7 @@
 #include "qmcompass.h"
 #include "qmsensor.h"
 #include "qmsensor_p.h"
+#include "qmsensorhub_p.h"
 #include "compasssensor_i.h"
 #include "sensormanagerinterface.h"
 
@@ -48,7 +49,7 @@ namespace MeeGo
     public:
         CompassSensorChannelInterface* sensorIfc;
 
-        QmCompassPrivate(QmCompass *compass) : QmSensorPrivate(compass), sensorIfc(NULL)
+        QmCompassPrivate(QmCompass *compass) : QmSensorPrivate(compass), sensorIfc(NULL), cursor_(0)
         {
         }
 
@@ -78,6 +79,16 @@ namespace MeeGo
             return CompassSensorChannelInterface::listenInterface("compasssensor");
         }
 
+        bool sharesSession() const
+        {
+            return true;
+        }
+
+        QmSensorHub* acquireHub(QmSensor::SessionType type)
+        {
+            return QmSensorHub::get_hub<QmCompassHub>("compasssensor", this, type);
+        }
+
 
         bool setupSignals(bool setOn)
         {
@@ -87,8 +98,9 @@ namespace MeeGo
             }
 
             if (setOn) {
-                bool result = connect(sensorIfc, SIGNAL(dataAvailable(const Compass&)),
-                                      this, SLOT(slotDataAvailable(const Compass&)));
+                // Read only the samples published from now on
+                cursor_ = static_cast<QmCompassHub*>(hub_)->ring.cursor();
+                bool result = connect(hub_, SIGNAL(published()), this, SLOT(slotPublished()));
 
                 if (!result) {
                     setError("Signal connect error");
@@ -96,8 +108,7 @@ namespace MeeGo
                 }
 
             } else {
-                bool result = disconnect(sensorIfc, SIGNAL(dataAvailable(const Compass&)),
-                                  this, SLOT(slotDataAvailable(const Compass&)));
+                bool result = disconnect(hub_, SIGNAL(published()), this, SLOT(slotPublished()));
 
                 if (!result) {
                     setError("Signal disconnect error");
@@ -112,6 +123,14 @@ namespace MeeGo
 
     public Q_SLOTS:
 
+        void slotPublished()
+        {
+            CompassData sample;
+            while (static_cast<QmCompassHub*>(hub_)->ring.read(cursor_, sample)) {
+                slotDataAvailable(Compass(sample));
+            }
+        }
+
         void slotDataAvailable(const Compass& value)
         {
             QmCompassReading output;
@@ -120,6 +139,9 @@ namespace MeeGo
             output.level = value.data().level_;
             emit dataAvailable(output);
         }
+
+    private:
+        unsigned int cursor_;
     };
 
     // ------------------ END PRIVATE CLASS DEFINITION ------------------ //
@@ -0,0 +1,195 @@
+/*!
+ * @file qmfusion.cpp
+ * @brief QmFusion
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmfusion.h"
+#include "qmfusion_p.h"
+
+namespace MeeGo {
+
+QmFusionPrivate::QmFusionPrivate()
+    : running(false), interval(0)
+{
+    reading.timestamp = 0;
+    reading.w = 1;
+    reading.x = reading.y = reading.z = 0;
+    reading.heading = reading.pitch = reading.roll = 0;
+
+    connect(&accelerometer, SIGNAL(dataAvailable(const MeeGo::QmAccelerometerReading&)),
+            this, SLOT(slotAcceleration(const MeeGo::QmAccelerometerReading&)));
+    connect(&magnetometer, SIGNAL(dataAvailable(const MeeGo::QmMagnetometerReading&)),
+            this, SLOT(slotMagneticField(const MeeGo::QmMagnetometerReading&)));
+}
+
+QmFusionPrivate::~QmFusionPrivate()
+{
+    stop();
+}
+
+void QmFusionPrivate::setError(QString error)
+{
+    errorString = error;
+    emit errorSignal(errorString);
+}
+
+bool QmFusionPrivate::openSession(QmSensor &sensor)
+{
+    if (sensor.sessionType() == QmSensor::SessionTypeNone
+        && sensor.requestSession(QmSensor::SessionTypeControl) == QmSensor::SessionTypeNone) {
+        setError(sensor.lastError());
+        return false;
+    }
+    return true;
+}
+
+bool QmFusionPrivate::start()
+{
+    if (running) {
+        return true;
+    }
+    if (!openSession(magnetometer) || !openSession(accelerometer)) {
+        return false;
+    }
+
+    accelerometer.setInterval(interval);
+
+    // Start over, as the device may have turned meanwhile
+    filter.reset();
+
+    if (!magnetometer.start()) {
+        setError(magnetometer.lastError());
+        return false;
+    }
+    if (!accelerometer.start()) {
+        setError(accelerometer.lastError());
+        magnetometer.stop();
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+bool QmFusionPrivate::stop()
+{
+    if (!running) {
+        return true;
+    }
+    // Both, even if the first fails, not to leave the other running
+    bool accelerometerStopped = accelerometer.stop();
+    bool magnetometerStopped = magnetometer.stop();
+    bool result = accelerometerStopped && magnetometerStopped;
+    if (!result) {
+        setError("Unable to stop the sensors");
+    }
+    running = false;
+    return result;
+}
+
+void QmFusionPrivate::slotMagneticField(const MeeGo::QmMagnetometerReading& data)
+{
+    filter.setField(data.x, data.y, data.z);
+}
+
+void QmFusionPrivate::slotAcceleration(const MeeGo::QmAccelerometerReading& data)
+{
+    if (!filter.update(data.x, data.y, data.z, reading)) {
+        return;
+    }
+    reading.timestamp = data.timestamp;
+    emit dataAvailable(reading);
+}
+
+QmFusion::QmFusion(QObject *parent) : QObject(parent)
+{
+    MEEGO_INITIALIZE(QmFusion);
+
+    connect(priv, SIGNAL(dataAvailable(const MeeGo::QmFusionReading&)),
+            this, SIGNAL(dataAvailable(const MeeGo::QmFusionReading&)));
+    connect(priv, SIGNAL(errorSignal(QString)), this, SIGNAL(errorSignal(QString)));
+}
+
+QmFusion::~QmFusion()
+{
+    MEEGO_UNINITIALIZE(QmFusion);
+}
+
+bool QmFusion::start()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->start();
+}
+
+bool QmFusion::stop()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->stop();
+}
+
+bool QmFusion::isRunning()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->running;
+}
+
+int QmFusion::interval()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->interval;
+}
+
+void QmFusion::setInterval(int value)
+{
+    MEEGO_PRIVATE(QmFusion);
+    priv->interval = qMax(value, 0);
+    if (priv->accelerometer.sessionType() != QmSensor::SessionTypeNone) {
+        priv->accelerometer.setInterval(priv->interval);
+    }
+}
+
+qreal QmFusion::gain()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->filter.gain();
+}
+
+bool QmFusion::setGain(qreal value)
+{
+    MEEGO_PRIVATE(QmFusion);
+    if (value <= 0 || value > 1) {
+        return false;
+    }
+    priv->filter.setGain(value);
+    return true;
+}
+
+QmFusionReading QmFusion::reading()
+{
+    MEEGO_PRIVATE(QmFusion);
+    return priv->reading;
+}
+
+QString QmFusion::lastError() const
+{
+    MEEGO_PRIVATE_CONST(QmFusion);
+    return priv->errorString;
+}
+
+} // namespace MeeGo
@@ -0,0 +1,178 @@
+/*!
+ * @file qmfusion.h
+ * @brief Contains QmFusion
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMFUSION_H
+#define QMFUSION_H
+
+#include <QtCore/qobject.h>
+#include "system_global.h"
+#include <qmsensor.h>
+
+QT_BEGIN_HEADER
+
+namespace MeeGo {
+
+    class QmFusionPrivate;
+
+    /**
+     * Device orientation, see #QmFusion
+     */
+    class QmFusionReading : public QmSensorReading
+    {
+    public:
+        /** Unit quaternion rotating device coordinates to east, north, up */
+        qreal w;
+        qreal x;
+        qreal y;
+        qreal z;
+
+        /** Degrees clockwise from magnetic north to the y-axis, [0, 360) */
+        qreal heading;
+
+        /** Degrees the y-axis points above the horizon, [-90, 90] */
+        qreal pitch;
+
+        /** Degrees the device is rolled right around the y-axis, [-180, 180] */
+        qreal roll;
+    };
+
+    /**
+     * @scope Internal
+     *
+     * @brief Provides the device orientation fused from the accelerometer
+     * and the magnetometer.
+     *
+     * The orientation is computed in the process from the accelerometer
+     * and magnetometer measurements, with one reading for each accelerometer
+     * measurement, timestamped with it. The sessions of the two sensors are
+     * shared with the QmAccelerometer and QmMagnetometer objects of the
+     * process, so heading and tilt do not need the sessions of QmCompass and
+     * QmRotation. Axes are as in #QmAccelerometer.
+     *
+     * A complementary filter smooths the orientation: each measurement
+     * moves the orientation by the share #gain of the way to the
+     * orientation the measurement alone gives.
+     */
+    class MEEGO_SYSTEM_EXPORT QmFusion : public QObject
+    {
+        Q_OBJECT;
+
+    public:
+        /**
+         * Constructor
+         * @param parent Parent QObject
+         */
+        QmFusion(QObject *parent = 0);
+
+        /**
+         * Destructor
+         */
+        ~QmFusion();
+
+        /**
+         * Opens the sessions of the accelerometer and magnetometer, if not
+         * yet open, and starts them.
+         *
+         * @return \c true on success or already running, \c false on error
+         */
+        bool start();
+
+        /**
+         * Stops the sensors.
+         *
+         * @return \c true on success or already stopped, \c false on error
+         */
+        bool stop();
+
+        /**
+         * Returns whether the fusion is running.
+         * @return \c true if running
+         */
+        bool isRunning();
+
+        /**
+         * Returns the interval requested for the accelerometer.
+         * @return Interval in milliseconds, 0 for the default
+         */
+        int interval();
+
+        /**
+         * Requests an interval for the accelerometer, which sets the rate
+         * of the readings. The request is made when the fusion is started,
+         * or at once if it is running.
+         * @param value Interval in milliseconds, 0 for the default
+         */
+        void setInterval(int value);
+
+        /**
+         * Returns the gain of the filter, see #setGain.
+         * @return Gain
+         */
+        qreal gain();
+
+        /**
+         * Sets the share of each measurement in the orientation, between 0
+         * and 1. The smaller the gain, the smoother and slower to follow
+         * the orientation is. The default is 0.1, and 1 turns the
+         * smoothing off.
+         *
+         * @param value Gain
+         * @return \c false if the gain is out of range
+         */
+        bool setGain(qreal value);
+
+        /**
+         * Returns the latest reading.
+         * @return Latest reading, with timestamp 0 before the first one
+         */
+        QmFusionReading reading();
+
+        /**
+         * Gets an explanatory message for previous error.
+         * @return Human readable error description
+         */
+        QString lastError() const;
+
+    Q_SIGNALS:
+        /**
+         * Signals a new orientation, for each accelerometer measurement
+         * once the magnetometer has measured.
+         * @param data The orientation
+         */
+        void dataAvailable(const MeeGo::QmFusionReading& data);
+
+        /**
+         * Emitted when an error occurs. See #lastError().
+         * @param error Human readable string describing the error
+         */
+        void errorSignal(QString error);
+
+    private:
+        Q_DISABLE_COPY(QmFusion)
+        MEEGO_DECLARE_PRIVATE(QmFusion)
+    };
+
+} // MeeGo namespace
+
+QT_END_HEADER
+
+#endif // QMFUSION_H
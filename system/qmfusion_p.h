@@ -0,0 +1,71 @@
+/*!
+ * @file qmfusion_p.h
+ * @brief Contains QmFusionPrivate
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMFUSION_P_H
+#define QMFUSION_P_H
+
+#include "qmfusion.h"
+#include "qmfusionfilter_p.h"
+#include "qmaccelerometer.h"
+#include "qmmagnetometer.h"
+
+namespace MeeGo
+{
+    class QmFusionPrivate : public QObject
+    {
+        Q_OBJECT;
+        MEEGO_DECLARE_PUBLIC(QmFusion)
+
+    public:
+        QmFusionPrivate();
+        ~QmFusionPrivate();
+
+        bool start();
+        bool stop();
+
+        void setError(QString error);
+
+        QmAccelerometer accelerometer;
+        QmMagnetometer magnetometer;
+
+        bool running;
+        int interval;
+        QmFusionFilter filter;
+        QString errorString;
+        QmFusionReading reading;
+
+    Q_SIGNALS:
+        void dataAvailable(const MeeGo::QmFusionReading& data);
+        void errorSignal(QString error);
+
+    public Q_SLOTS:
+        void slotAcceleration(const MeeGo::QmAccelerometerReading& data);
+        void slotMagneticField(const MeeGo::QmMagnetometerReading& data);
+
+    private:
+        bool openSession(QmSensor &sensor);
+    };
+}
+
+#endif // QMFUSION_P_H
@@ -0,0 +1,175 @@
+/*!
+ * @file qmfusionfilter.cpp
+ * @brief QmFusionFilter
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmfusionfilter_p.h"
+#include "qmsensortransform_p.h"
+
+#include <math.h>
+
+#define FUSION_DEFAULT_GAIN 0.1
+
+namespace MeeGo {
+
+static const qreal RAD_TO_DEG = 180.0 / M_PI;
+
+static void cross(const qreal *a, const qreal *b, qreal *result)
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool normalize(qreal *v, int size)
+{
+    qreal norm = 0;
+    for (int i = 0; i < size; i++) {
+        norm += v[i] * v[i];
+    }
+    norm = sqrt(norm);
+    if (norm < 1e-9) {
+        return false;
+    }
+    for (int i = 0; i < size; i++) {
+        v[i] /= norm;
+    }
+    return true;
+}
+
+/* Quaternion w, x, y, z of the rotation matrix with rows m */
+static void toQuaternion(const qreal m[3][3], qreal *q)
+{
+    qreal trace = m[0][0] + m[1][1] + m[2][2];
+
+    if (trace > 0) {
+        qreal s = 0.5 / sqrt(trace + 1.0);
+        q[0] = 0.25 / s;
+        q[1] = (m[2][1] - m[1][2]) * s;
+        q[2] = (m[0][2] - m[2][0]) * s;
+        q[3] = (m[1][0] - m[0][1]) * s;
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        qreal s = 2.0 * sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]);
+        q[0] = (m[2][1] - m[1][2]) / s;
+        q[1] = 0.25 * s;
+        q[2] = (m[0][1] + m[1][0]) / s;
+        q[3] = (m[0][2] + m[2][0]) / s;
+    } else if (m[1][1] > m[2][2]) {
+        qreal s = 2.0 * sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]);
+        q[0] = (m[0][2] - m[2][0]) / s;
+        q[1] = (m[0][1] + m[1][0]) / s;
+        q[2] = 0.25 * s;
+        q[3] = (m[1][2] + m[2][1]) / s;
+    } else {
+        qreal s = 2.0 * sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]);
+        q[0] = (m[1][0] - m[0][1]) / s;
+        q[1] = (m[0][2] + m[2][0]) / s;
+        q[2] = (m[1][2] + m[2][1]) / s;
+        q[3] = 0.25 * s;
+    }
+}
+
+QmFusionFilter::QmFusionFilter()
+    : gain_(FUSION_DEFAULT_GAIN), haveField_(false), primed_(false)
+{
+}
+
+void QmFusionFilter::reset()
+{
+    haveField_ = false;
+    primed_ = false;
+}
+
+void QmFusionFilter::setField(int x, int y, int z)
+{
+    QmSensorTransform::remapAccelerometer(&x, &y, &z, &x, &y, &z, 1);
+    field_[0] = x;
+    field_[1] = y;
+    field_[2] = z;
+    haveField_ = true;
+}
+
+bool QmFusionFilter::update(int x, int y, int z, QmFusionReading &reading)
+{
+    if (!haveField_) {
+        return false;
+    }
+
+    // At rest the accelerometer measures the gravity, pointing down
+    qreal down[3] = { (qreal)x, (qreal)y, (qreal)z };
+    qreal m[3][3];
+    cross(down, field_, m[0]);
+    if (!normalize(down, 3) || !normalize(m[0], 3)) {
+        // Free fall, or the field along the gravity
+        return false;
+    }
+    cross(m[0], down, m[1]);
+    for (int i = 0; i < 3; i++) {
+        m[2][i] = -down[i];
+    }
+
+    // Rows east, north and up in device coordinates rotate to the world
+    qreal measured[4];
+    toQuaternion(m, measured);
+
+    if (!primed_) {
+        for (int i = 0; i < 4; i++) {
+            q_[i] = measured[i];
+        }
+        primed_ = true;
+    } else {
+        // Along the shorter way, as q and -q are the same rotation
+        qreal dot = 0;
+        for (int i = 0; i < 4; i++) {
+            dot += q_[i] * measured[i];
+        }
+        qreal sign = dot < 0 ? -1 : 1;
+        for (int i = 0; i < 4; i++) {
+            q_[i] += gain_ * (sign * measured[i] - q_[i]);
+        }
+        normalize(q_, 4);
+    }
+
+    qreal w = q_[0], qx = q_[1], qy = q_[2], qz = q_[3];
+
+    reading.w = w;
+    reading.x = qx;
+    reading.y = qy;
+    reading.z = qz;
+
+    // The y-axis and the up row of the filtered rotation
+    qreal east = 2 * (qx * qy - w * qz);
+    qreal north = 1 - 2 * (qx * qx + qz * qz);
+    qreal upX = 2 * (qx * qz - w * qy);
+    qreal upY = 2 * (qy * qz + w * qx);
+    qreal upZ = 1 - 2 * (qx * qx + qy * qy);
+
+    reading.heading = atan2(east, north) * RAD_TO_DEG;
+    if (reading.heading < 0) {
+        reading.heading += 360;
+    }
+    reading.pitch = asin(qBound((qreal)-1, upY, (qreal)1)) * RAD_TO_DEG;
+    reading.roll = atan2(-upX, upZ) * RAD_TO_DEG;
+
+    return true;
+}
+
+} // namespace MeeGo
+
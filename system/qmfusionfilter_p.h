@@ -0,0 +1,75 @@
+/*!
+ * @file qmfusionfilter_p.h
+ * @brief Contains QmFusionFilter
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMFUSIONFILTER_P_H
+#define QMFUSIONFILTER_P_H
+
+#include "qmfusion.h"
+
+namespace MeeGo
+{
+    /**
+     * The orientation of #QmFusion from accelerometer and magnetometer
+     * samples, apart from the sensors so that it can be fed samples.
+     */
+    class QmFusionFilter
+    {
+    public:
+        QmFusionFilter();
+
+        qreal gain() const { return gain_; }
+        void setGain(qreal value) { gain_ = value; }
+
+        /**
+         * Starts over, forgetting the field and the orientation.
+         */
+        void reset();
+
+        /**
+         * Sets the magnetic field, in the axes of QmMagnetometer, which
+         * are remapped to the ones of QmAccelerometer.
+         */
+        void setField(int x, int y, int z);
+
+        /**
+         * Moves the orientation toward the one an acceleration in the axes
+         * of QmAccelerometer gives with the field, and sets all of reading
+         * but the timestamp.
+         *
+         * @return \c false if there is no field yet, or no orientation
+         * can be told from the samples
+         */
+        bool update(int x, int y, int z, QmFusionReading &reading);
+
+    private:
+        qreal gain_;
+        bool haveField_;
+        qreal field_[3];
+        bool primed_;
+        qreal q_[4];
+    };
+
+} // MeeGo namespace
+
+#endif // QMFUSIONFILTER_P_H
@@ -0,0 +1,257 @@
+/*!
+ * @file qmkeydprotocol_p.h
+ * @brief Wire protocol between qmkeyd and QmKeys
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMKEYDPROTOCOL_P_H
+#define QMKEYDPROTOCOL_P_H
+
+#include <linux/types.h>
+#include <linux/input.h>
+
+#ifndef KEY_CAMERA_FOCUS
+#define KEY_CAMERA_FOCUS 0x210
+#endif
+#ifndef SW_KEYPAD_SLIDE
+#define SW_KEYPAD_SLIDE 0x0a
+#endif
+
+/*
+ * Clients always talk to qmkeyd with a stream of struct input_event.
+ * A plain EV_KEY/EV_SW event is a key state query, which qmkeyd answers
+ * by bouncing the event back with ev.value set to the current state.
+ *
+ * Events of type QMKEYD_EV_CONTROL carry protocol control messages.
+ * Legacy servers drop them silently, as they are not supported keys,
+ * and legacy clients ignore them, as they are neither EV_KEY nor EV_SW.
+ *
+ * Until the client has sent QMKEYD_CONTROL_HELLO and the server has
+ * answered it, the server talks to the client with a stream of struct
+ * input_event (QMKEYD_PROTOCOL_LEGACY). The answer to the hello is the
+ * last event sent in that format: from then on everything the server
+ * sends is framed into batches. Each batch is a struct qmkeyd_batch
+ * followed by qmkeyd_batch::count struct input_event, and carries all
+ * the events the kernel reported up to one EV_SYN.
+ *
+ * A client may send QMKEYD_CONTROL_SUBSCRIBE at any time to receive only
+ * some of the keys. Its value is a mask with the bit of qmkeyd_codes[i]
+ * at position i; until the first subscription a client receives every
+ * key. Servers that do not know the message keep sending every key, so
+ * clients still have to filter themselves. Keys outside qmkeyd_codes,
+ * such as the ones a key map translates to, have no bit to subscribe to
+ * and go to every client regardless of its subscription.
+ *
+ * qmkeyd queues only a bounded number of events for a client that does
+ * not keep up. When it has to drop events, it keeps the latest state of
+ * each key and sends QMKEYD_CONTROL_OVERFLOW ahead of the events that
+ * survived. The client must then forget the key states it has tracked
+ * and read them again.
+ *
+ * A client that has negotiated QMKEYD_PROTOCOL_QUERY queries key states
+ * over its event connection with QMKEYD_CONTROL_QUERY, whose value is a
+ * mask of qmkeyd_codes like a subscription. Control messages have no use
+ * for a timestamp, so the query carries a cookie of the client's choice
+ * in time.tv_sec. The answer is a single batch flagged QMKEYD_BATCH_REPLY
+ * with the cookie of the query, holding the current state of each of the
+ * queried codes the server knows. Replies are never dropped or merged.
+ *
+ * From QMKEYD_PROTOCOL_SNAPSHOT on, the server follows the answer to the
+ * hello, and every subscription, with a batch flagged
+ * QMKEYD_BATCH_SNAPSHOT. It holds the current state of every subscribed
+ * code, so that the client can answer state queries itself from then on.
+ */
+
+/* input_event.type of protocol control messages */
+#define QMKEYD_EV_CONTROL           0xffff
+
+/* input_event.code of protocol control messages */
+#define QMKEYD_CONTROL_HELLO        0x0001  /* value: protocol version */
+#define QMKEYD_CONTROL_SUBSCRIBE    0x0002  /* value: mask of qmkeyd_codes */
+#define QMKEYD_CONTROL_OVERFLOW     0x0003  /* value: events dropped so far */
+#define QMKEYD_CONTROL_QUERY        0x0004  /* value: mask of qmkeyd_codes, time.tv_sec: cookie */
+
+/* Protocol versions */
+#define QMKEYD_PROTOCOL_LEGACY      0       /* a single struct input_event per key event */
+#define QMKEYD_PROTOCOL_BATCH       1       /* struct qmkeyd_batch framing */
+#define QMKEYD_PROTOCOL_SUBSCRIBE   2       /* QMKEYD_CONTROL_SUBSCRIBE */
+#define QMKEYD_PROTOCOL_QUERY       3       /* QMKEYD_CONTROL_QUERY */
+#define QMKEYD_PROTOCOL_SNAPSHOT    4       /* QMKEYD_BATCH_SNAPSHOT */
+#define QMKEYD_PROTOCOL_VERSION     QMKEYD_PROTOCOL_SNAPSHOT
+
+/* Maximum number of events in one batch */
+#define QMKEYD_MAX_BATCH            64
+
+/* qmkeyd_batch.flags */
+#define QMKEYD_BATCH_REPLY          0x0001  /* the answer to QMKEYD_CONTROL_QUERY */
+#define QMKEYD_BATCH_SNAPSHOT       0x0002  /* the states of all subscribed codes */
+
+struct qmkeyd_batch
+{
+    __u16 count;    /* number of struct input_event following the header */
+    __u16 flags;    /* QMKEYD_BATCH_* */
+    __u32 cookie;   /* cookie of the query of a reply, zero otherwise */
+};
+
+/*
+ * The keys and switches qmkeyd passes on to its clients. The index of a
+ * code is its bit in a subscription mask, so entries may only be added
+ * to the end of the table, and there is room for 32 of them.
+ */
+static const struct {
+    __u16 type;
+    __u16 code;
+} qmkeyd_codes[] = {
+    { EV_SW,  SW_KEYPAD_SLIDE },
+    { EV_KEY, KEY_CAMERA },
+    { EV_KEY, KEY_CAMERA_FOCUS },
+    { EV_KEY, KEY_VOLUMEUP },
+    { EV_KEY, KEY_VOLUMEDOWN },
+    { EV_KEY, KEY_PHONE },
+    { EV_KEY, KEY_PLAYPAUSE },
+    { EV_KEY, KEY_STOP },
+    { EV_KEY, KEY_STOPCD },
+    { EV_KEY, KEY_FORWARD },
+    { EV_KEY, KEY_FASTFORWARD },
+    { EV_KEY, KEY_REWIND },
+    { EV_KEY, KEY_MUTE },
+    { EV_KEY, KEY_LEFT },
+    { EV_KEY, KEY_RIGHT },
+    { EV_KEY, KEY_UP },
+    { EV_KEY, KEY_DOWN },
+    { EV_KEY, KEY_END },
+    { EV_KEY, KEY_NEXTSONG },
+    { EV_KEY, KEY_PREVIOUSSONG },
+    { EV_KEY, KEY_PAUSECD },
+    { EV_KEY, KEY_PLAYCD },
+    { EV_KEY, KEY_RIGHTCTRL },
+    { EV_KEY, KEY_POWER },
+};
+
+#define QMKEYD_CODE_COUNT           (sizeof(qmkeyd_codes) / sizeof(qmkeyd_codes[0]))
+#define QMKEYD_SUBSCRIBE_ALL        0xffffffffU
+
+/* Returns the subscription bit of the code, or 0 if it is not supported */
+static inline __u32 qmkeyd_code_mask(__u16 type, __u16 code)
+{
+    unsigned int i;
+
+    for (i = 0; i < QMKEYD_CODE_COUNT; i++) {
+        if (qmkeyd_codes[i].type == type && qmkeyd_codes[i].code == code) {
+            return 1U << i;
+        }
+    }
+    return 0;
+}
+
+/* Whether a client with the subscription receives an event of the mask */
+static inline int qmkeyd_subscribed(__u32 subscription, __u32 mask)
+{
+    return !mask || (subscription & mask);
+}
+
+/*
+ * qmkeyd also publishes the state of every key and switch of the devices
+ * it has open in a shared memory table, which clients map read-only.
+ * The table is protected by a sequence lock: qmkeyd makes the sequence
+ * odd before it touches the table and even again when it is done, and a
+ * reader retries if it saw an odd sequence or the sequence changed under
+ * it. Reading a key state thus needs neither a lock nor a system call.
+ */
+
+/* shm_open() name of the table, i.e. /dev/shm/qmkeyd-state */
+#ifndef QMKEYD_STATE_NAME
+#define QMKEYD_STATE_NAME           "/qmkeyd-state"
+#endif
+#define QMKEYD_STATE_MAGIC          0x716b7374
+
+/* How many times a reader retries before falling back to a socket query */
+#define QMKEYD_STATE_RETRIES        100
+
+struct qmkeyd_state
+{
+    __u32 magic;
+    __u32 sequence;     /* odd while qmkeyd updates the table */
+    __u32 valid;        /* zero while qmkeyd has no input devices open */
+    __u32 reserved;
+    __u8 keys[KEY_MAX / 8 + 1];
+    __u8 switches[SW_MAX / 8 + 1];
+};
+
+static inline void qmkeyd_state_write_begin(volatile struct qmkeyd_state *state)
+{
+    state->sequence++;
+    __sync_synchronize();
+}
+
+static inline void qmkeyd_state_write_end(volatile struct qmkeyd_state *state)
+{
+    __sync_synchronize();
+    state->sequence++;
+}
+
+static inline void qmkeyd_state_set(volatile struct qmkeyd_state *state, __u16 type, __u16 code, int pressed)
+{
+    volatile __u8 *bits;
+
+    if (type == EV_KEY && code <= KEY_MAX) {
+        bits = state->keys;
+    } else if (type == EV_SW && code <= SW_MAX) {
+        bits = state->switches;
+    } else {
+        return;
+    }
+
+    if (pressed) {
+        bits[code / 8] |= (1 << (code % 8));
+    } else {
+        bits[code / 8] &= ~(1 << (code % 8));
+    }
+}
+
+/* Returns 1 if the key is down or the switch is on, 0 if not,
+   and -1 if the table could not be read */
+static inline int qmkeyd_state_get(const volatile struct qmkeyd_state *state, __u16 type, __u16 code)
+{
+    int retries;
+
+    for (retries = 0; retries < QMKEYD_STATE_RETRIES; retries++) {
+        __u32 sequence = state->sequence;
+        int value = -1;
+
+        __sync_synchronize();
+        if (!state->valid) {
+            value = -1;
+        } else if (type == EV_KEY && code <= KEY_MAX) {
+            value = !!(state->keys[code / 8] & (1 << (code % 8)));
+        } else if (type == EV_SW && code <= SW_MAX) {
+            value = !!(state->switches[code / 8] & (1 << (code % 8)));
+        }
+        __sync_synchronize();
+
+        if (!(sequence & 1) && sequence == state->sequence) {
+            return value;
+        }
+    }
+    return -1;
+}
+
+#endif // QMKEYDPROTOCOL_P_H
@@ -30,72 +30,256 @@
 #include "qmkeys.h"
 #include "qmkeys_p.h"
 
+#include <QTimer>
+#include <QTimerEvent>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* How long getKeyState() waits for qmkeyd to answer */
+#define QUERY_TIMEOUT_MS 1000
+
 namespace MeeGo
 {
-    QmKeysPrivate::QmKeysPrivate(QObject *parent) : QObject(parent) {
+    /* The key each evdev key code stands for */
+    static const struct {
+        __u16 code;
+        QmKeys::Key key;
+    } codeKeys[] = {
+        { KEY_CAMERA, QmKeys::Camera },
+        { KEY_VOLUMEUP, QmKeys::VolumeUp },
+        { KEY_VOLUMEDOWN, QmKeys::VolumeDown },
+        { KEY_UP, QmKeys::UpKey },
+        { KEY_DOWN, QmKeys::DownKey },
+        { KEY_LEFT, QmKeys::LeftKey },
+        { KEY_RIGHT, QmKeys::RightKey },
+        { KEY_END, QmKeys::End },
+        { KEY_MUTE, QmKeys::Mute },
+        { KEY_STOPCD, QmKeys::Stop },
+        { KEY_STOP, QmKeys::Stop },
+        { KEY_FASTFORWARD, QmKeys::Forward },
+        { KEY_FORWARD, QmKeys::Forward },
+        { KEY_NEXTSONG, QmKeys::NextSong },
+        { KEY_PLAYPAUSE, QmKeys::PlayPause },
+        { KEY_PLAYCD, QmKeys::Play },
+        { KEY_REWIND, QmKeys::Rewind },
+        { KEY_PREVIOUSSONG, QmKeys::PreviousSong },
+        { KEY_PHONE, QmKeys::Phone },
+        { KEY_PAUSECD, QmKeys::Pause },
+        { KEY_RIGHTCTRL, QmKeys::RightCtrl },
+        { KEY_POWER, QmKeys::PowerKey },
+    };
+
+    /* codeKeys indexed by code, for a single load per event */
+    struct CodeKeyTable
+    {
+        CodeKeyTable() {
+            memset(keys, QmKeys::UnknownKey, sizeof(keys));
+            for (unsigned int i = 0; i < sizeof(codeKeys) / sizeof(codeKeys[0]); i++) {
+                keys[codeKeys[i].code] = codeKeys[i].key;
+            }
+        }
+
+        qint8 keys[KEY_MAX + 1];
+    };
+
+    Q_GLOBAL_STATIC(CodeKeyTable, codeKeyTable)
+
+    QmKeysBackend::QmKeysBackend(QObject *parent) : QObject(parent) {
+        protocolVersion = QMKEYD_PROTOCOL_LEGACY;
+        subscription = QMKEYD_SUBSCRIBE_ALL;
+        stateTable = 0;
+        lastCookie = 0;
+        counter = 0;
+        helloPending = false;
+        snapshotPending = false;
         socket = new QLocalSocket(this);
         socket->connectToServer(SERVER_NAME);
         if (!socket->waitForConnected()) {
             qWarning() << "Could not connect to " << SERVER_NAME;
+        } else {
+            /* Ask for batched events. Until qmkeyd answers, and forever
+               if it is too old to answer, events arrive one by one. */
+            struct input_event hello;
+            memset(&hello, 0, sizeof(hello));
+            hello.type = QMKEYD_EV_CONTROL;
+            hello.code = QMKEYD_CONTROL_HELLO;
+            hello.value = QMKEYD_PROTOCOL_VERSION;
+            socket->write((char*)&hello, sizeof(hello));
+            helloPending = true;
+            // Legacy servers drop the hello without an answer
+            QTimer::singleShot(QUERY_TIMEOUT_MS, this, SLOT(helloTimedOut()));
         }
         connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
         cameraFocusDown = false;
+        resetKeyStates();
+        mapStateTable();
     }
-    QmKeysPrivate::~QmKeysPrivate() {
+    QmKeysBackend *QmKeysBackend::object = 0;
+    QMutex QmKeysBackend::object_mutex;
+
+    /* All the QmKeys of the process share one connection to qmkeyd */
+    QmKeysBackend *QmKeysBackend::get_object() {
+        QMutexLocker locker(&object_mutex);
+        if (!object) {
+            object = new QmKeysBackend(0);
+        }
+        ++object->counter;
+        // A new front-end wants every key until it sets a filter
+        object->updateSubscription();
+        return object;
+    }
+
+    void QmKeysBackend::unref_object() {
+        QMutexLocker locker(&object_mutex);
+        if (!object) {
+            return;
+        }
+        if (--object->counter == 0) {
+            delete object, object = 0;
+        } else {
+            object->updateSubscription();
+        }
+    }
+
+    QmKeysBackend::~QmKeysBackend() {
         socket->disconnect();
         delete socket;
+        if (stateTable) {
+            munmap((void*)stateTable, sizeof(struct qmkeyd_state));
+        }
     }
 
-    QmKeys::Key QmKeysPrivate::codeToKey(__u16 code) {
-        switch (code) {
-        case KEY_CAMERA:
-            return QmKeys::Camera;
-        case KEY_VOLUMEUP:
-            return QmKeys::VolumeUp;
-        case KEY_VOLUMEDOWN:
-            return QmKeys::VolumeDown;
-        case KEY_UP:
-            return QmKeys::UpKey;
-        case KEY_DOWN:
-            return QmKeys::DownKey;
-        case KEY_LEFT:
-            return QmKeys::LeftKey;
-        case KEY_RIGHT:
-            return QmKeys::RightKey;
-        case KEY_END:
-            return QmKeys::End;
-        case KEY_MUTE:
-            return QmKeys::Mute;
-        case KEY_STOPCD:
-        case KEY_STOP:
-            return QmKeys::Stop;
-        case KEY_FASTFORWARD:
-        case KEY_FORWARD:
-            return QmKeys::Forward;
-        case KEY_NEXTSONG:
-            return QmKeys::NextSong;
-        case KEY_PLAYPAUSE:
-            return QmKeys::PlayPause;
-        case KEY_PLAYCD:
-            return QmKeys::Play;
-        case KEY_REWIND:
-            return QmKeys::Rewind;
-        case KEY_PREVIOUSSONG:
-            return QmKeys::PreviousSong;
-        case KEY_PHONE:
-            return QmKeys::Phone;
-        case KEY_PAUSECD:
-            return QmKeys::Pause;
-        case KEY_RIGHTCTRL:
-            return QmKeys::RightCtrl;
-        case KEY_POWER:
-            return QmKeys::PowerKey;
+    /* qmkeyd publishes the key states in shared memory. Without the table,
+       for example with an older qmkeyd, the states are queried over the socket. */
+    void QmKeysBackend::mapStateTable() {
+        int fd = shm_open(QMKEYD_STATE_NAME, O_RDONLY, 0);
+        if (fd == -1) {
+            return;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct qmkeyd_state)) {
+            void *table = mmap(0, sizeof(struct qmkeyd_state), PROT_READ, MAP_SHARED, fd, 0);
+            if (table != MAP_FAILED) {
+                stateTable = (const volatile struct qmkeyd_state *)table;
+                if (stateTable->magic != QMKEYD_STATE_MAGIC) {
+                    munmap(table, sizeof(struct qmkeyd_state));
+                    stateTable = 0;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    QmKeys::Key QmKeysBackend::codeToKey(__u16 code) {
+        return code <= KEY_MAX ? (QmKeys::Key)codeKeyTable()->keys[code] : QmKeys::UnknownKey;
+    }
+
+    /* The subscription bits of the codes that make up the key */
+    __u32 QmKeysBackend::keyToMask(QmKeys::Key key) {
+        switch (key) {
+        case QmKeys::KeyboardSlider:
+            return qmkeyd_code_mask(EV_SW, SW_KEYPAD_SLIDE);
+        case QmKeys::Camera:
+            return qmkeyd_code_mask(EV_KEY, KEY_CAMERA) | qmkeyd_code_mask(EV_KEY, KEY_CAMERA_FOCUS);
+        case QmKeys::VolumeUp:
+            return qmkeyd_code_mask(EV_KEY, KEY_VOLUMEUP);
+        case QmKeys::VolumeDown:
+            return qmkeyd_code_mask(EV_KEY, KEY_VOLUMEDOWN);
+        case QmKeys::Phone:
+            return qmkeyd_code_mask(EV_KEY, KEY_PHONE);
+        case QmKeys::PlayPause:
+            return qmkeyd_code_mask(EV_KEY, KEY_PLAYPAUSE);
+        case QmKeys::Stop:
+            return qmkeyd_code_mask(EV_KEY, KEY_STOP) | qmkeyd_code_mask(EV_KEY, KEY_STOPCD);
+        case QmKeys::Forward:
+            return qmkeyd_code_mask(EV_KEY, KEY_FORWARD) | qmkeyd_code_mask(EV_KEY, KEY_FASTFORWARD);
+        case QmKeys::Rewind:
+            return qmkeyd_code_mask(EV_KEY, KEY_REWIND);
+        case QmKeys::Mute:
+            return qmkeyd_code_mask(EV_KEY, KEY_MUTE);
+        case QmKeys::LeftKey:
+            return qmkeyd_code_mask(EV_KEY, KEY_LEFT);
+        case QmKeys::RightKey:
+            return qmkeyd_code_mask(EV_KEY, KEY_RIGHT);
+        case QmKeys::UpKey:
+            return qmkeyd_code_mask(EV_KEY, KEY_UP);
+        case QmKeys::DownKey:
+            return qmkeyd_code_mask(EV_KEY, KEY_DOWN);
+        case QmKeys::End:
+            return qmkeyd_code_mask(EV_KEY, KEY_END);
+        case QmKeys::NextSong:
+            return qmkeyd_code_mask(EV_KEY, KEY_NEXTSONG);
+        case QmKeys::PreviousSong:
+            return qmkeyd_code_mask(EV_KEY, KEY_PREVIOUSSONG);
+        case QmKeys::Pause:
+            return qmkeyd_code_mask(EV_KEY, KEY_PAUSECD);
+        case QmKeys::Play:
+            return qmkeyd_code_mask(EV_KEY, KEY_PLAYCD);
+        case QmKeys::RightCtrl:
+            return qmkeyd_code_mask(EV_KEY, KEY_RIGHTCTRL);
+        case QmKeys::PowerKey:
+            return qmkeyd_code_mask(EV_KEY, KEY_POWER);
+        case QmKeys::UnknownKey:
         default:
-            return QmKeys::UnknownKey;
+            return 0;
+        }
+    }
+
+    /* qmkeyd sends the keys any of the front-ends wants. Older servers
+       ignore the subscription, which is why handleEvent() applies it as well. */
+    void QmKeysBackend::setFilter(QmKeysPrivate *frontEnd, __u32 mask) {
+        if (mask == QMKEYD_SUBSCRIBE_ALL) {
+            filters.remove(frontEnd);
+        } else {
+            filters.insert(frontEnd, mask);
         }
+        updateSubscription();
     }
 
-    struct input_event QmKeysPrivate::keyToEvent(QmKeys::Key key) {
+    /* The subscription is updated once the front-end has let go of the backend */
+    void QmKeysBackend::removeFilter(QmKeysPrivate *frontEnd) {
+        filters.remove(frontEnd);
+    }
+
+    /* Front-ends without a filter want every key */
+    void QmKeysBackend::updateSubscription() {
+        __u32 mask = 0;
+
+        if (filters.size() < counter) {
+            mask = QMKEYD_SUBSCRIBE_ALL;
+        } else {
+            foreach (__u32 filter, filters) {
+                mask |= filter;
+            }
+        }
+        if (mask == subscription) {
+            return;
+        }
+        subscription = mask;
+        // The filtered keys are no longer tracked
+        resetKeyStates();
+
+        if (socket->state() == QLocalSocket::ConnectedState) {
+            struct input_event subscribe;
+            memset(&subscribe, 0, sizeof(subscribe));
+            subscribe.type = QMKEYD_EV_CONTROL;
+            subscribe.code = QMKEYD_CONTROL_SUBSCRIBE;
+            subscribe.value = (__s32)subscription;
+            socket->write((char*)&subscribe, sizeof(subscribe));
+            // qmkeyd answers with the states of the new keys
+            if (protocolVersion >= QMKEYD_PROTOCOL_SNAPSHOT) {
+                snapshotPending = true;
+            }
+        }
+    }
+
+    struct input_event QmKeysBackend::keyToEvent(QmKeys::Key key) {
         struct input_event ev;
         memset(&ev, 0, sizeof(struct input_event));
 
@@ -129,12 +313,56 @@ namespace MeeGo
         }
         return ev;
     }
-    QmKeys::State QmKeysPrivate::getKeyState(QmKeys::Key key) {
+
+    int QmKeysBackend::getTableValue(__u16 type, __u16 code) {
+        if (!stateTable) {
+            return -1;
+        }
+        return qmkeyd_state_get(stateTable, type, code);
+    }
+
+    QmKeys::State QmKeysBackend::getTableState(QmKeys::Key key) {
         QmKeys::State state = QmKeys::KeyInvalid;
-        if (keyMap.find(key) != keyMap.end()) {
-            state = keyMap.value(key);
-            goto EXIT;
+
+        if (key == QmKeys::Camera) {
+            int focus = getTableValue(EV_KEY, KEY_CAMERA_FOCUS);
+            int camera = getTableValue(EV_KEY, KEY_CAMERA);
+            if (focus == 0 && camera == 0) {
+                state = QmKeys::KeyUp;
+            } else if (focus == 1 && camera == 0) {
+                state = QmKeys::KeyHalfDown;
+            } else if (camera == 1) {
+                state = QmKeys::KeyDown;
+            }
+        } else {
+            struct input_event query = keyToEvent(key);
+            if (query.type != EV_KEY && query.type != EV_SW) {
+                return state;
+            }
+            int value = getTableValue(query.type, query.code);
+            if (value == 0) {
+                state = QmKeys::KeyUp;
+            } else if (value == 1) {
+                state = QmKeys::KeyDown;
+            }
         }
+        return state;
+    }
+
+    /* The state as far as it is known without asking qmkeyd */
+    QmKeys::State QmKeysBackend::getLocalState(QmKeys::Key key) {
+        QmKeys::State state = getTableState(key);
+        if (state == QmKeys::KeyInvalid) {
+            state = trackedState(key);
+        }
+        return state;
+    }
+
+    /* Queries over a connection of their own, for servers that cannot
+       answer on the event connection */
+    QmKeys::State QmKeysBackend::getLegacyState(QmKeys::Key key) {
+        QmKeys::State state = QmKeys::KeyInvalid;
+
         if (key == QmKeys::Camera) {
             struct input_event query;
             query.type = EV_KEY;
@@ -160,11 +388,364 @@ namespace MeeGo
                 state = QmKeys::KeyDown;
             }
         }
-        EXIT:
         return state;
     }
 
-    int QmKeysPrivate::getKeyValue(const struct input_event &query) {
+    /* The state of the key from the code states of a query reply */
+    QmKeys::State QmKeysBackend::codesToState(QmKeys::Key key, const struct input_event *events, int count) {
+        __u32 mask = keyToMask(key);
+        int focus = -1, camera = -1, value = -1;
+
+        for (int i = 0; i < count; i++) {
+            if (!(qmkeyd_code_mask(events[i].type, events[i].code) & mask)) {
+                continue;
+            }
+            if (events[i].code == KEY_CAMERA_FOCUS) {
+                focus = events[i].value;
+            } else if (key == QmKeys::Camera) {
+                camera = events[i].value;
+            } else {
+                value = qMax(value, (int)events[i].value);
+            }
+        }
+
+        if (key == QmKeys::Camera) {
+            if (camera == 1) {
+                return QmKeys::KeyDown;
+            } else if (camera == 0) {
+                return focus == 1 ? QmKeys::KeyHalfDown : QmKeys::KeyUp;
+            }
+            return QmKeys::KeyInvalid;
+        }
+        if (value == 0) {
+            return QmKeys::KeyUp;
+        } else if (value == 1) {
+            return QmKeys::KeyDown;
+        }
+        return QmKeys::KeyInvalid;
+    }
+
+    /* Cookies are positive, so that they fit the int of the API */
+    int QmKeysBackend::nextCookie() {
+        lastCookie = (lastCookie % 0x7fffffff) + 1;
+        return lastCookie;
+    }
+
+    bool QmKeysBackend::canQuery() {
+        return socket->state() == QLocalSocket::ConnectedState &&
+               protocolVersion >= QMKEYD_PROTOCOL_QUERY;
+    }
+
+    int QmKeysBackend::sendQuery(const QList<QmKeys::Key> &keys, bool sync) {
+        KeyQuery query;
+        query.keys = keys;
+        query.sync = sync;
+
+        int cookie = nextCookie();
+        queries.insert(cookie, query);
+        writeQuery(cookie, keys);
+        return cookie;
+    }
+
+    void QmKeysBackend::writeQuery(int cookie, const QList<QmKeys::Key> &keys) {
+        __u32 mask = 0;
+        foreach (QmKeys::Key key, keys) {
+            mask |= keyToMask(key);
+        }
+
+        struct input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = QMKEYD_EV_CONTROL;
+        ev.code = QMKEYD_CONTROL_QUERY;
+        ev.value = (__s32)mask;
+        ev.time.tv_sec = cookie;
+        socket->write((char*)&ev, sizeof(ev));
+    }
+
+    void QmKeysBackend::handleReply(__u32 cookie, const struct input_event *events, int count) {
+        int request = (int)cookie;
+        if (!queries.contains(request)) {
+            // Given up on, or not ours
+            return;
+        }
+
+        KeyQuery &query = queries[request];
+        foreach (QmKeys::Key key, query.keys) {
+            if (!query.states.contains(key)) {
+                query.states[key] = codesToState(key, events, count);
+            }
+        }
+        query.answered = true;
+
+        if (!query.sync) {
+            emitAnswer(request, queries.take(request));
+        }
+    }
+
+    void QmKeysBackend::emitAnswer(int request, const KeyQuery &query) {
+        foreach (QmKeys::Key key, query.keys) {
+            emit keyStateReceived(request, key, query.states.value(key, QmKeys::KeyInvalid));
+        }
+    }
+
+    void QmKeysBackend::deliverAnswers() {
+        while (!answered.isEmpty()) {
+            int request = answered.takeFirst();
+            if (queries.contains(request)) {
+                emitAnswer(request, queries.take(request));
+            }
+        }
+    }
+
+    QmKeys::State QmKeysBackend::getKeyState(QmKeys::Key key) {
+        return getKeyStates(QList<QmKeys::Key>() << key).value(key, QmKeys::KeyInvalid);
+    }
+
+    /* Blocks until qmkeyd answers, but with a single round trip over the
+       event connection for all the keys the state table does not know.
+       Key events that arrive meanwhile are emitted as usual. */
+    QMap<QmKeys::Key, QmKeys::State> QmKeysBackend::getKeyStates(const QList<QmKeys::Key> &keys) {
+        QMap<QmKeys::Key, QmKeys::State> states;
+        QList<QmKeys::Key> remote = splitLocal(keys, states);
+
+        // The snapshot qmkeyd sends after the hello answers every key at once.
+        // It is only waited for once the answer to the hello has promised
+        // it, as a legacy server never answers.
+        if (!remote.isEmpty() && snapshotPending) {
+            waitForAnswer(0);
+            snapshotPending = false;
+            remote = splitLocal(remote, states);
+        }
+        if (remote.isEmpty()) {
+            return states;
+        }
+
+        if (!canQuery()) {
+            foreach (QmKeys::Key key, remote) {
+                states[key] = getLegacyState(key);
+            }
+            return states;
+        }
+
+        int cookie = sendQuery(remote, true);
+        waitForAnswer(cookie);
+
+        KeyQuery query = queries.take(cookie);
+        foreach (QmKeys::Key key, remote) {
+            states[key] = query.states.value(key, QmKeys::KeyInvalid);
+        }
+        return states;
+    }
+
+    /* Fill states with the keys known locally, and return the others */
+    QList<QmKeys::Key> QmKeysBackend::splitLocal(const QList<QmKeys::Key> &keys, QMap<QmKeys::Key, QmKeys::State> &states) {
+        QList<QmKeys::Key> remote;
+
+        foreach (QmKeys::Key key, keys) {
+            QmKeys::State state = getLocalState(key);
+            if (state != QmKeys::KeyInvalid) {
+                states[key] = state;
+            } else {
+                remote.append(key);
+            }
+        }
+        return remote;
+    }
+
+    /* Process what qmkeyd sends until the query is answered, or with
+       a zero cookie until the snapshot has arrived */
+    void QmKeysBackend::waitForAnswer(int cookie) {
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (;;) {
+            // Take what has already arrived before waiting for more
+            readyRead();
+            if (cookie ? queries.value(cookie).answered : !snapshotPending) {
+                break;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int left = QUERY_TIMEOUT_MS - ((now.tv_sec - start.tv_sec) * 1000 +
+                                           (now.tv_nsec - start.tv_nsec) / 1000000);
+            if (left <= 0 || !socket->waitForReadyRead(left)) {
+                break;
+            }
+        }
+    }
+
+    /* Never blocks. Until qmkeyd has answered the hello, neither its
+       protocol nor the states of the snapshot are known, so the keys the
+       state table does not know wait for them. */
+    int QmKeysBackend::requestKeyStates(const QList<QmKeys::Key> &keys) {
+        KeyQuery query;
+        query.keys = keys;
+        QList<QmKeys::Key> remote = splitLocal(keys, query.states);
+
+        int cookie = nextCookie();
+        queries.insert(cookie, query);
+
+        if (!remote.isEmpty() && (helloPending || snapshotPending)) {
+            deferred.append(cookie);
+        } else {
+            sendRemote(cookie, remote);
+        }
+        return cookie;
+    }
+
+    /* Answers from the state table are delivered from the event loop too,
+       so that the caller can rely on the signal coming after the call returns */
+    void QmKeysBackend::sendRemote(int cookie, const QList<QmKeys::Key> &remote) {
+        if (remote.isEmpty()) {
+            queries[cookie].answered = true;
+            answered.append(cookie);
+            QMetaObject::invokeMethod(this, "deliverAnswers", Qt::QueuedConnection);
+        } else if (canQuery()) {
+            writeQuery(cookie, remote);
+        } else {
+            sendLegacyQuery(cookie, remote);
+        }
+    }
+
+    /* The snapshot may have answered the deferred requests in the meantime */
+    void QmKeysBackend::sendDeferred() {
+        QList<int> cookies = deferred;
+        deferred.clear();
+
+        foreach (int cookie, cookies) {
+            if (!queries.contains(cookie)) {
+                continue;
+            }
+            KeyQuery &query = queries[cookie];
+            QList<QmKeys::Key> unknown;
+            foreach (QmKeys::Key key, query.keys) {
+                if (!query.states.contains(key)) {
+                    unknown.append(key);
+                }
+            }
+            sendRemote(cookie, splitLocal(unknown, query.states));
+        }
+    }
+
+    void QmKeysBackend::helloTimedOut() {
+        if (!helloPending) {
+            return;
+        }
+        helloPending = false;
+        snapshotPending = false;
+        sendDeferred();
+    }
+
+    /* A legacy server only answers queries one code at a time, over a
+       connection that carries no events. The connection is made and read
+       from the event loop, like the event connection. */
+    void QmKeysBackend::sendLegacyQuery(int cookie, const QList<QmKeys::Key> &keys) {
+        LegacyQuery query;
+        query.cookie = cookie;
+
+        foreach (QmKeys::Key key, keys) {
+            struct input_event ev = keyToEvent(key);
+            if (key == QmKeys::Camera) {
+                ev.type = EV_KEY;
+                ev.code = KEY_CAMERA_FOCUS;
+                query.codes.append(ev);
+                ev.code = KEY_CAMERA;
+            }
+            if (ev.type == EV_KEY || ev.type == EV_SW) {
+                query.codes.append(ev);
+            }
+        }
+
+        if (query.codes.isEmpty()) {
+            sendRemote(cookie, QList<QmKeys::Key>());
+            return;
+        }
+
+        QLocalSocket *legacy = new QLocalSocket(this);
+        legacyQueries.insert(legacy, query);
+
+        QTimer *timer = new QTimer(legacy);
+        timer->setSingleShot(true);
+        connect(timer, SIGNAL(timeout()), this, SLOT(legacyFinished()));
+        connect(legacy, SIGNAL(connected()), this, SLOT(legacyConnected()));
+        connect(legacy, SIGNAL(readyRead()), this, SLOT(legacyReadyRead()));
+        connect(legacy, SIGNAL(disconnected()), this, SLOT(legacyFinished()));
+        legacy->connectToServer(SERVER_NAME);
+
+        // Without a server the answer still comes from the event loop
+        timer->start(legacy->state() == QLocalSocket::UnconnectedState ? 0 : QUERY_TIMEOUT_MS);
+    }
+
+    void QmKeysBackend::legacyConnected() {
+        QLocalSocket *legacy = qobject_cast<QLocalSocket*>(sender());
+        if (!legacyQueries.contains(legacy)) {
+            return;
+        }
+        foreach (const struct input_event &query, legacyQueries.value(legacy).codes) {
+            legacy->write((const char*)&query, sizeof(query));
+        }
+    }
+
+    /* The server bounces each query back with its state. Key events may
+       come in between, and are told apart as they were not asked for. */
+    void QmKeysBackend::legacyReadyRead() {
+        QLocalSocket *legacy = qobject_cast<QLocalSocket*>(sender());
+        if (!legacyQueries.contains(legacy)) {
+            return;
+        }
+        LegacyQuery &query = legacyQueries[legacy];
+
+        struct input_event ev;
+        while (legacy->bytesAvailable() >= (qint64)sizeof(ev) &&
+               legacy->read((char*)&ev, sizeof(ev)) == sizeof(ev)) {
+            bool asked = false, replied = false;
+            foreach (const struct input_event &code, query.codes) {
+                asked |= (code.type == ev.type && code.code == ev.code);
+            }
+            foreach (const struct input_event &reply, query.replies) {
+                replied |= (reply.type == ev.type && reply.code == ev.code);
+            }
+            if (asked && !replied) {
+                query.replies.append(ev);
+            }
+        }
+
+        if (query.replies.size() == query.codes.size()) {
+            finishLegacyQuery(legacy);
+        }
+    }
+
+    /* From the timer as well as from the socket */
+    void QmKeysBackend::legacyFinished() {
+        QObject *origin = sender();
+        QLocalSocket *legacy = qobject_cast<QLocalSocket*>(origin);
+        if (!legacy && origin) {
+            legacy = qobject_cast<QLocalSocket*>(origin->parent());
+        }
+        finishLegacyQuery(legacy);
+    }
+
+    /* The keys that got no answer are KeyInvalid */
+    void QmKeysBackend::finishLegacyQuery(QLocalSocket *legacy) {
+        if (!legacyQueries.contains(legacy)) {
+            return;
+        }
+        LegacyQuery legacyQuery = legacyQueries.take(legacy);
+        legacy->disconnect(this);
+        legacy->deleteLater();
+
+        if (!queries.contains(legacyQuery.cookie)) {
+            return;
+        }
+        KeyQuery query = queries.take(legacyQuery.cookie);
+        foreach (QmKeys::Key key, query.keys) {
+            if (!query.states.contains(key)) {
+                query.states[key] = codesToState(key, legacyQuery.replies.constData(), legacyQuery.replies.size());
+            }
+        }
+        emitAnswer(legacyQuery.cookie, query);
+    }
+
+    int QmKeysBackend::getKeyValue(const struct input_event &query) {
 
         // Try to connect to qmkeyd.
         QLocalSocket socket;
@@ -197,6 +778,99 @@ namespace MeeGo
         return response.value;
     }
 
+    void QmKeysBackend::readyRead() {
+
+        for (;;) {
+            if (protocolVersion == QMKEYD_PROTOCOL_LEGACY) {
+                struct input_event ev;
+                if (socket->bytesAvailable() < (qint64)sizeof(ev)) {
+                    break;
+                }
+                if (socket->read((char*)&ev, sizeof(ev)) != sizeof(ev)) {
+                    break;
+                }
+                handleEvent(ev);
+            } else {
+                struct qmkeyd_batch batch;
+                struct input_event events[QMKEYD_MAX_BATCH];
+
+                if (socket->peek((char*)&batch, sizeof(batch)) != sizeof(batch)) {
+                    break;
+                }
+                if (batch.count > QMKEYD_MAX_BATCH) {
+                    qWarning() << "Invalid batch of" << batch.count << "events from" << SERVER_NAME;
+                    socket->disconnectFromServer();
+                    break;
+                }
+
+                // Wait until the whole batch is there
+                qint64 size = batch.count * sizeof(struct input_event);
+                if (socket->bytesAvailable() < (qint64)sizeof(batch) + size) {
+                    break;
+                }
+                socket->read((char*)&batch, sizeof(batch));
+                socket->read((char*)events, size);
+
+                if (batch.flags & QMKEYD_BATCH_REPLY) {
+                    handleReply(batch.cookie, events, batch.count);
+                    continue;
+                }
+                if (batch.flags & QMKEYD_BATCH_SNAPSHOT) {
+                    handleSnapshot(events, batch.count);
+                    continue;
+                }
+                for (int i = 0; i < batch.count; i++) {
+                    handleEvent(events[i]);
+                }
+            }
+        }
+    }
+
+    /* Track the states of the snapshot as if they had arrived as events */
+    void QmKeysBackend::handleSnapshot(const struct input_event *events, int count) {
+        for (int i = QmKeys::KeyboardSlider; i <= QmKeys::PowerKey; i++) {
+            QmKeys::Key key = (QmKeys::Key)i;
+            if (!(keyToMask(key) & subscription)) {
+                continue;
+            }
+            QmKeys::State state = codesToState(key, events, count);
+            if (state != QmKeys::KeyInvalid) {
+                setTrackedState(key, state);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (events[i].type == EV_KEY && events[i].code == KEY_CAMERA_FOCUS) {
+                cameraFocusDown = (events[i].value == 1);
+            }
+        }
+        snapshotPending = false;
+        sendDeferred();
+    }
+
+    void QmKeysBackend::handleControlEvent(const struct input_event &ev) {
+        switch (ev.code) {
+        case QMKEYD_CONTROL_HELLO:
+            // Everything after the answer to our hello is framed
+            protocolVersion = ev.value;
+            helloPending = false;
+            if (protocolVersion >= QMKEYD_PROTOCOL_SNAPSHOT) {
+                // The snapshot follows, and answers the deferred requests
+                snapshotPending = true;
+            } else {
+                sendDeferred();
+            }
+            break;
+        case QMKEYD_CONTROL_OVERFLOW:
+            // We did not keep up and lost events, the tracked states may be stale
+            qWarning() << "Lost key events from" << SERVER_NAME << ", resynchronizing";
+            resetKeyStates();
+            cameraFocusDown = (getTableValue(EV_KEY, KEY_CAMERA_FOCUS) == 1);
+            break;
+        default:
+            break;
+        }
+    }
+
     /* The logic in camera keys is as follows:
      * We have two events: KEY_CAMERA and KEY_CAMERA_FOCUS.
      * KeyUp: KEY_CAMERA == 0 && KEY_CAMERA_FOCUS == 0
@@ -208,120 +882,314 @@ namespace MeeGo
      * If KEY_CAMERA == 1 and we receive KEY_CAMERA_FOCUS == 0, goto KeyUp
      * If KEY_CAMERA == 1 || KEY_CAMERA_FOCUS == 1 and we receive KEY_CAMERA_FOCUS == 1, do nothing.
      */
-    void QmKeysPrivate::readyRead() {
-
-        int ret=0;
-        do {
-            struct input_event ev;
-            ret = socket->read((char*)&ev, sizeof(ev));
-            if (ret == sizeof(ev)) {
-                if (ev.type == EV_KEY) {
-                    switch (ev.code) {
-                    case KEY_PAUSECD:
-                    case KEY_UP:
-                    case KEY_LEFT:
-                    case KEY_RIGHT:
-                    case KEY_END:
-                    case KEY_DOWN:
-                    case KEY_MUTE:
-                    case KEY_STOP:
-                    case KEY_FORWARD:
-                    case KEY_PLAYPAUSE:
-                    case KEY_REWIND:
-                    case KEY_PREVIOUSSONG:
-                    case KEY_PHONE:
-                    case KEY_PLAYCD:
-                    case KEY_NEXTSONG:
-                    case KEY_STOPCD:
-                    case KEY_FASTFORWARD:
-                    case KEY_RIGHTCTRL:
-                    case KEY_POWER:
-                        {
-                            QmKeys::Key key = codeToKey(ev.code);
-                            QmKeys::State state;
-                            if (ev.value == 0) {
-                                state = QmKeys::KeyUp;
-                            } else {
-                                state = QmKeys::KeyDown;
-                            }
-                            keyMap[key] = state;
-                            emit keyEvent(key, state);
-                        }
-                        break;
-                    case KEY_CAMERA:
-                        if (ev.value == 0) {
-                            if (cameraFocusDown) {
-                                keyMap[QmKeys::Camera] = QmKeys::KeyHalfDown;
-                                emit cameraLauncherMoved(QmKeys::Down);
-                            } else {
-                                keyMap[QmKeys::Camera] = QmKeys::KeyUp;
-                                emit cameraLauncherMoved(QmKeys::Up);
-                            }
-                        } else {
-                            keyMap[QmKeys::Camera] = QmKeys::KeyDown;
-                            emit cameraLauncherMoved(QmKeys::Through);
-                            if (!cameraFocusDown) {
-                                qWarning() << "Received a Camera down event without being half down.";
-                            }
-                        }
-                        emit keyEvent(QmKeys::Camera, keyMap.value(QmKeys::Camera));
-                        break;
-                    case KEY_CAMERA_FOCUS:
-                        if (ev.value == 0) {
-                            cameraFocusDown = false;
-                            if (!keyMap.contains(QmKeys::Camera) || keyMap.value(QmKeys::Camera) != QmKeys::KeyHalfDown) {
-                                qWarning() << "Received a KEY_CAMERA_FOCUS up event without being in HalfDown state.";
-                            }
-                            keyMap[QmKeys::Camera] = QmKeys::KeyUp;
-                            emit cameraLauncherMoved(QmKeys::Up);
-                        } else {
-                            cameraFocusDown = true;
-                            if (!keyMap.contains(QmKeys::Camera) || keyMap.value(QmKeys::Camera) == QmKeys::KeyUp) {
-                                keyMap[QmKeys::Camera] = QmKeys::KeyHalfDown;
-                                emit cameraLauncherMoved(QmKeys::Down);
-                            } else {
-                                qWarning() << "Received a KEY_CAMERA_FOCUS down event in state " << keyMap.value(QmKeys::Camera);
-                            }
-                        }
-                        emit keyEvent(QmKeys::Camera, keyMap.value(QmKeys::Camera));
-                        break;
-                    case KEY_VOLUMEUP:
-                        if (ev.value == 0) {
-                            keyMap[QmKeys::VolumeUp] = QmKeys::KeyUp;
-                            emit volumeUpMoved(false);
-                        } else  if (ev.value == 1 ) {
-                            keyMap[QmKeys::VolumeUp] = QmKeys::KeyDown;
-                            emit volumeUpMoved(true);
-                        }
-                        emit keyEvent(QmKeys::VolumeUp, keyMap.value(QmKeys::VolumeUp));
-                        break;
-                    case KEY_VOLUMEDOWN:
-                        if (ev.value == 0) {
-                            keyMap[QmKeys::VolumeDown] = QmKeys::KeyUp;
-                            emit volumeDownMoved(false);
-                        } else if (ev.value == 1) {
-                            keyMap[QmKeys::VolumeDown] = QmKeys::KeyDown;
-                            emit volumeDownMoved(true);
-                        }
-                        emit keyEvent(QmKeys::VolumeDown, keyMap.value(QmKeys::VolumeDown));
-                        break;
+    void QmKeysBackend::handleEvent(const struct input_event &ev) {
+        if (ev.type == QMKEYD_EV_CONTROL) {
+            handleControlEvent(ev);
+        } else if (!qmkeyd_subscribed(subscription, qmkeyd_code_mask(ev.type, ev.code))) {
+            return;
+        } else if (ev.type == EV_KEY) {
+            switch (ev.code) {
+            case KEY_PAUSECD:
+            case KEY_UP:
+            case KEY_LEFT:
+            case KEY_RIGHT:
+            case KEY_END:
+            case KEY_DOWN:
+            case KEY_MUTE:
+            case KEY_STOP:
+            case KEY_FORWARD:
+            case KEY_PLAYPAUSE:
+            case KEY_REWIND:
+            case KEY_PREVIOUSSONG:
+            case KEY_PHONE:
+            case KEY_PLAYCD:
+            case KEY_NEXTSONG:
+            case KEY_STOPCD:
+            case KEY_FASTFORWARD:
+            case KEY_RIGHTCTRL:
+            case KEY_POWER:
+                {
+                    QmKeys::Key key = codeToKey(ev.code);
+                    QmKeys::State state;
+                    if (ev.value == 0) {
+                        state = QmKeys::KeyUp;
+                    } else {
+                        state = QmKeys::KeyDown;
+                    }
+                    setTrackedState(key, state);
+                    emit keyEvent(key, state);
+                }
+                break;
+            case KEY_CAMERA:
+                if (ev.value == 0) {
+                    if (cameraFocusDown) {
+                        setTrackedState(QmKeys::Camera, QmKeys::KeyHalfDown);
+                        emit cameraLauncherMoved(QmKeys::Down);
+                    } else {
+                        setTrackedState(QmKeys::Camera, QmKeys::KeyUp);
+                        emit cameraLauncherMoved(QmKeys::Up);
+                    }
+                } else {
+                    setTrackedState(QmKeys::Camera, QmKeys::KeyDown);
+                    emit cameraLauncherMoved(QmKeys::Through);
+                    if (!cameraFocusDown) {
+                        qWarning() << "Received a Camera down event without being half down.";
+                    }
+                }
+                emit keyEvent(QmKeys::Camera, trackedState(QmKeys::Camera));
+                break;
+            case KEY_CAMERA_FOCUS:
+                if (ev.value == 0) {
+                    cameraFocusDown = false;
+                    if (trackedState(QmKeys::Camera) != QmKeys::KeyHalfDown) {
+                        qWarning() << "Received a KEY_CAMERA_FOCUS up event without being in HalfDown state.";
                     }
-                } else if (ev.type == EV_SW) {
-                    switch (ev.code) {
-                        case SW_KEYPAD_SLIDE:
-                            if (ev.value == 0) {
-                                keyMap[QmKeys::KeyboardSlider] = QmKeys::KeyUp;
-                                emit keyboardSliderMoved(QmKeys::KeyboardSliderOut);
-                            } else {
-                                keyMap[QmKeys::KeyboardSlider] = QmKeys::KeyDown;
-                                emit keyboardSliderMoved(QmKeys::KeyboardSliderIn);
-                            }
-                            emit keyEvent(QmKeys::KeyboardSlider, keyMap.value(QmKeys::KeyboardSlider));
-                        break;
+                    setTrackedState(QmKeys::Camera, QmKeys::KeyUp);
+                    emit cameraLauncherMoved(QmKeys::Up);
+                } else {
+                    cameraFocusDown = true;
+                    if (trackedState(QmKeys::Camera) == QmKeys::KeyInvalid || trackedState(QmKeys::Camera) == QmKeys::KeyUp) {
+                        setTrackedState(QmKeys::Camera, QmKeys::KeyHalfDown);
+                        emit cameraLauncherMoved(QmKeys::Down);
+                    } else {
+                        qWarning() << "Received a KEY_CAMERA_FOCUS down event in state " << trackedState(QmKeys::Camera);
                     }
                 }
+                emit keyEvent(QmKeys::Camera, trackedState(QmKeys::Camera));
+                break;
+            case KEY_VOLUMEUP:
+                if (ev.value == 0) {
+                    setTrackedState(QmKeys::VolumeUp, QmKeys::KeyUp);
+                    emit volumeUpMoved(false);
+                } else  if (ev.value == 1 ) {
+                    setTrackedState(QmKeys::VolumeUp, QmKeys::KeyDown);
+                    emit volumeUpMoved(true);
+                }
+                emit keyEvent(QmKeys::VolumeUp, trackedState(QmKeys::VolumeUp));
+                break;
+            case KEY_VOLUMEDOWN:
+                if (ev.value == 0) {
+                    setTrackedState(QmKeys::VolumeDown, QmKeys::KeyUp);
+                    emit volumeDownMoved(false);
+                } else if (ev.value == 1) {
+                    setTrackedState(QmKeys::VolumeDown, QmKeys::KeyDown);
+                    emit volumeDownMoved(true);
+                }
+                emit keyEvent(QmKeys::VolumeDown, trackedState(QmKeys::VolumeDown));
+                break;
+            }
+        } else if (ev.type == EV_SW) {
+            switch (ev.code) {
+                case SW_KEYPAD_SLIDE:
+                    if (ev.value == 0) {
+                        setTrackedState(QmKeys::KeyboardSlider, QmKeys::KeyUp);
+                        emit keyboardSliderMoved(QmKeys::KeyboardSliderOut);
+                    } else {
+                        setTrackedState(QmKeys::KeyboardSlider, QmKeys::KeyDown);
+                        emit keyboardSliderMoved(QmKeys::KeyboardSliderIn);
+                    }
+                    emit keyEvent(QmKeys::KeyboardSlider, trackedState(QmKeys::KeyboardSlider));
+                break;
             }
-        } while (ret > 0);
+        }
+    }
+
+    static qint64 monotonicMs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (qint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    QmKeysPrivate::QmKeysPrivate(QObject *parent) : QObject(parent) {
+        filter = QMKEYD_SUBSCRIBE_ALL;
+        for (int i = 0; i < QMKEYS_KEY_SLOTS; i++) {
+            repeatIntervals[i] = 0;
+            lastStates[i] = QmKeys::KeyInvalid;
+            lastRepeats[i] = 0;
+            pendingRepeats[i] = 0;
+            pendingMoves[i] = false;
+        }
+        backend = QmKeysBackend::get_object();
+        connect(backend, SIGNAL(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                this, SLOT(backendKeyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)));
+        connect(backend, SIGNAL(volumeDownMoved(bool)), this, SLOT(backendVolumeDownMoved(bool)));
+        connect(backend, SIGNAL(volumeUpMoved(bool)), this, SLOT(backendVolumeUpMoved(bool)));
+        connect(backend, SIGNAL(cameraLauncherMoved(QmKeys::CameraKeyPosition)),
+                this, SLOT(backendCameraLauncherMoved(QmKeys::CameraKeyPosition)));
+        connect(backend, SIGNAL(lensCoverMoved(QmKeys::LensCoverPosition)),
+                this, SIGNAL(lensCoverMoved(QmKeys::LensCoverPosition)));
+        connect(backend, SIGNAL(keyboardSliderMoved(QmKeys::KeyboardSliderPosition)),
+                this, SLOT(backendKeyboardSliderMoved(QmKeys::KeyboardSliderPosition)));
+        connect(backend, SIGNAL(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                this, SLOT(backendKeyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)));
+    }
+
+    QmKeysPrivate::~QmKeysPrivate() {
+        backend->disconnect(this);
+        backend->removeFilter(this);
+        QmKeysBackend::unref_object();
+    }
+
+    void QmKeysPrivate::setKeyFilter(const QList<QmKeys::Key> &keys) {
+        filter = 0;
+        foreach (QmKeys::Key key, keys) {
+            filter |= QmKeysBackend::keyToMask(key);
+        }
+        if (keys.isEmpty()) {
+            filter = QMKEYD_SUBSCRIBE_ALL;
+        }
+        backend->setFilter(this, filter);
+    }
+
+    int QmKeysPrivate::requestKeyStates(const QList<QmKeys::Key> &keys) {
+        int request = backend->requestKeyStates(keys);
+        if (!keys.isEmpty()) {
+            requests.insert(request, keys.size());
+        }
+        return request;
+    }
+
+    void QmKeysPrivate::setKeyRepeatRate(int rate) {
+        for (int i = 1; i < QMKEYS_KEY_SLOTS; i++) {
+            setKeyRepeatRate((QmKeys::Key)(i - 1), rate);
+        }
+    }
+
+    /* The repeats merged so far are dropped along with the old rate */
+    void QmKeysPrivate::setKeyRepeatRate(QmKeys::Key key, int rate) {
+        int slot = QmKeysBackend::keySlot(key);
+        if (!slot) {
+            return;
+        }
+        repeatIntervals[slot] = rate > 0 ? qMax(1000 / rate, 1) : 0;
+        pendingRepeats[slot] = 0;
+        pendingMoves[slot] = false;
+        repeatTimers[slot].stop();
+    }
+
+    /* A key that goes down again without going up first is a repeat. With
+       coalescing, a repeat is emitted only if the previous emitted one is
+       at least the interval of the key old; the ones in between are
+       counted, and emitted by a timer if nothing else comes first. */
+    void QmKeysPrivate::backendKeyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state) {
+        if (!wants(key)) {
+            return;
+        }
+
+        int slot = QmKeysBackend::keySlot(key);
+        bool repeat = (state == QmKeys::KeyDown && lastStates[slot] == QmKeys::KeyDown);
+        lastStates[slot] = state;
+
+        if (!repeatIntervals[slot]) {
+            emit keyEvent(key, state);
+            return;
+        }
+
+        if (!repeat) {
+            // The merged repeats happened before this change
+            flushRepeats(key);
+            lastRepeats[slot] = monotonicMs();
+            emit keyEvent(key, state);
+            return;
+        }
+
+        pendingRepeats[slot]++;
+        qint64 age = monotonicMs() - lastRepeats[slot];
+        if (age >= repeatIntervals[slot]) {
+            flushRepeats(key);
+        } else if (!repeatTimers[slot].isActive()) {
+            repeatTimers[slot].start(repeatIntervals[slot] - age, this);
+        }
+    }
+
+    void QmKeysPrivate::flushRepeats(QmKeys::Key key) {
+        int slot = QmKeysBackend::keySlot(key);
+        int count = pendingRepeats[slot];
+
+        repeatTimers[slot].stop();
+        if (count == 0) {
+            return;
+        }
+        pendingRepeats[slot] = 0;
+        lastRepeats[slot] = monotonicMs();
+        if (pendingMoves[slot]) {
+            pendingMoves[slot] = false;
+            emitMoved(key, true);
+        }
+        emit keyEvent(key, QmKeys::KeyDown);
+        emit keyRepeated(key, count);
+    }
+
+    /* The merged repeats of a held key are emitted at the latest one
+       interval after the last emitted one */
+    void QmKeysPrivate::timerEvent(QTimerEvent *event) {
+        for (int slot = 1; slot < QMKEYS_KEY_SLOTS; slot++) {
+            if (repeatTimers[slot].timerId() == event->timerId()) {
+                flushRepeats((QmKeys::Key)(slot - 1));
+                return;
+            }
+        }
+        QObject::timerEvent(event);
+    }
+
+    void QmKeysPrivate::backendVolumeUpMoved(bool down) {
+        if (wants(QmKeys::VolumeUp)) {
+            volumeMoved(QmKeys::VolumeUp, down);
+        }
+    }
+
+    void QmKeysPrivate::backendVolumeDownMoved(bool down) {
+        if (wants(QmKeys::VolumeDown)) {
+            volumeMoved(QmKeys::VolumeDown, down);
+        }
+    }
+
+    /* The backend sends the volume signals just before the keyEvent() of
+       the same event, so a press while the key is down is a repeat, which
+       is merged like the keyEvent() that follows it */
+    void QmKeysPrivate::volumeMoved(QmKeys::Key key, bool down) {
+        int slot = QmKeysBackend::keySlot(key);
+
+        if (repeatIntervals[slot]) {
+            if (down && lastStates[slot] == QmKeys::KeyDown) {
+                pendingMoves[slot] = true;
+                return;
+            }
+            // The merged repeats happened before this change
+            flushRepeats(key);
+        }
+        emitMoved(key, down);
+    }
+
+    void QmKeysPrivate::emitMoved(QmKeys::Key key, bool down) {
+        if (key == QmKeys::VolumeUp) {
+            emit volumeUpMoved(down);
+        } else {
+            emit volumeDownMoved(down);
+        }
+    }
+
+    void QmKeysPrivate::backendCameraLauncherMoved(QmKeys::CameraKeyPosition where) {
+        if (wants(QmKeys::Camera)) {
+            emit cameraLauncherMoved(where);
+        }
+    }
+
+    void QmKeysPrivate::backendKeyboardSliderMoved(QmKeys::KeyboardSliderPosition where) {
+        if (wants(QmKeys::KeyboardSlider)) {
+            emit keyboardSliderMoved(where);
+        }
+    }
+
+    /* The answers go only to the front-end that asked */
+    void QmKeysPrivate::backendKeyStateReceived(int request, MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state) {
+        if (!requests.contains(request)) {
+            return;
+        }
+        if (--requests[request] == 0) {
+            requests.remove(request);
+        }
+        emit keyStateReceived(request, key, state);
     }
 
     QmKeys::QmKeys(QObject *parent) : QObject(parent) {
@@ -332,6 +1200,8 @@ namespace MeeGo
         connect(priv, SIGNAL(cameraLauncherMoved(QmKeys::CameraKeyPosition)), this, SIGNAL(cameraLauncherMoved(QmKeys::CameraKeyPosition)));
         connect(priv, SIGNAL(lensCoverMoved(QmKeys::LensCoverPosition)), this, SIGNAL(lensCoverMoved(QmKeys::LensCoverPosition)));
         connect(priv, SIGNAL(keyboardSliderMoved(QmKeys::KeyboardSliderPosition)), this, SIGNAL(keyboardSliderMoved(QmKeys::KeyboardSliderPosition)));
+        connect(priv, SIGNAL(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)), this, SIGNAL(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)));
+        connect(priv, SIGNAL(keyRepeated(MeeGo::QmKeys::Key, int)), this, SIGNAL(keyRepeated(MeeGo::QmKeys::Key, int)));
     }
 
     QmKeys::~QmKeys() {
@@ -342,6 +1212,30 @@ namespace MeeGo
         return priv->getKeyState(key);
     }
 
+    QMap<QmKeys::Key, QmKeys::State> QmKeys::getKeyStates(const QList<Key> &keys) {
+        return priv->getKeyStates(keys);
+    }
+
+    int QmKeys::requestKeyState(Key key) {
+        return priv->requestKeyStates(QList<Key>() << key);
+    }
+
+    int QmKeys::requestKeyStates(const QList<Key> &keys) {
+        return priv->requestKeyStates(keys);
+    }
+
+    void QmKeys::setKeyFilter(const QList<Key> &keys) {
+        priv->setKeyFilter(keys);
+    }
+
+    void QmKeys::setKeyRepeatRate(int rate) {
+        priv->setKeyRepeatRate(rate);
+    }
+
+    void QmKeys::setKeyRepeatRate(Key key, int rate) {
+        priv->setKeyRepeatRate(key, rate);
+    }
+
     QmKeys::KeyboardSliderPosition QmKeys::getSliderPosition() {
         if (getKeyState(KeyboardSlider) == KeyDown) {
             return KeyboardSliderIn;
@@ -35,6 +35,8 @@
 
 #include "system_global.h"
 #include <QtCore/qobject.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmap.h>
 QT_BEGIN_HEADER
 
 namespace MeeGo
@@ -188,6 +190,73 @@ public:
    */
   State getKeyState(Key key);
 
+  /*!
+   * @brief Gets the current states of the given keys.
+   *
+   * Like getKeyState(), but the keys whose state is not known locally
+   * are queried from qmkeyd with a single request.
+   * @param keys The keys whose state is being queried
+   * @return The state of each of the keys
+   */
+  QMap<Key, State> getKeyStates(const QList<Key> &keys);
+
+  /*!
+   * @brief Requests the current state of the given key without blocking.
+   *
+   * The state is delivered with keyStateReceived() once it is known.
+   * @param key The key whose state is being queried
+   * @return The identifier of the request, as passed to keyStateReceived()
+   */
+  int requestKeyState(Key key);
+
+  /*!
+   * @brief Requests the current states of the given keys without blocking.
+   *
+   * keyStateReceived() is emitted for each of the keys, with a single
+   * round trip to qmkeyd for all of them.
+   * @param keys The keys whose state is being queried
+   * @return The identifier of the request, as passed to keyStateReceived()
+   */
+  int requestKeyStates(const QList<Key> &keys);
+
+  /*!
+   * @brief Limits the key events of this object to the given keys.
+   *
+   * When every QmKeys of the process has a filter, qmkeyd does not send
+   * the other keys to the process at all, so a process that is only
+   * interested in a few keys is not woken up by the others. The signals
+   * of the filtered keys are not emitted, but their state can still be
+   * queried with getKeyState().
+   * @param keys The keys of interest, or an empty list for all keys
+   */
+  void setKeyFilter(const QList<Key> &keys);
+
+  /*!
+   * @brief Limits how often a held key is reported.
+   *
+   * A key that is held down repeats at the rate of the hardware. With a
+   * limit, keyEvent() is emitted for at most rate repeats of a key per
+   * second, each followed by keyRepeated() with the number of repeats it
+   * stands for. The repeats are emitted at the latest 1/rate seconds
+   * after the previous keyEvent() of the key, even if the key is not
+   * released, and volumeUpMoved() and volumeDownMoved() are limited
+   * along with keyEvent(). Presses and releases are always emitted
+   * right away.
+   * @param rate The maximum number of repeats per key and second, or 0
+   * to emit every repeat, which is the default
+   */
+  void setKeyRepeatRate(int rate);
+
+  /*!
+   * @brief Limits how often one held key is reported.
+   *
+   * As setKeyRepeatRate(int), for the key only.
+   * @param key The key to limit
+   * @param rate The maximum number of repeats per second, or 0 to emit
+   * every repeat
+   */
+  void setKeyRepeatRate(Key key, int rate);
+
 Q_SIGNALS:
 
   /*!
@@ -232,6 +301,23 @@ Q_SIGNALS:
    */
   void keyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
 
+  /*!
+   * @brief Sent with the state of a key requested with requestKeyState()
+   * or requestKeyStates().
+   * @param request The identifier the request returned
+   * @param key the key in question
+   * @param state The state of the key, KeyInvalid if it could not be read
+   */
+  void keyStateReceived(int request, MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+
+  /*!
+   * @brief Sent after keyEvent() for a repeat when setKeyRepeatRate()
+   * limits the repeats.
+   * @param key the key in question
+   * @param count The number of repeats since the previous keyEvent()
+   */
+  void keyRepeated(MeeGo::QmKeys::Key key, int count);
+
 private:
         Q_DISABLE_COPY(QmKeys)
         QmKeysPrivate *priv;
@@ -1,6 +1,6 @@
 /*!
  * @file qmkeys_p.h
- * @brief Contains QmKeysPrivate
+ * @brief Contains QmKeysBackend
 
    <p>
    Copyright (C) 2009-2011 Nokia Corporation
@@ -28,34 +28,68 @@
 #define QMKEYS_P_H
 
 #include "qmkeys.h"
+#include "qmkeydprotocol_p.h"
 #include <linux/input.h>
+#include <QHash>
+#include <QList>
 #include <QLocalSocket>
+#include <QBasicTimer>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
 
+/* The tests build the backend against a server of their own */
+#ifndef SERVER_NAME
 #define SERVER_NAME "/tmp/qmkeyd"
-#ifndef KEY_CAMERA_FOCUS
-#define KEY_CAMERA_FOCUS 0x210
-#endif
-#ifndef SW_KEYPAD_SLIDE
-#define SW_KEYPAD_SLIDE 0x0a
 #endif
 
+/* One slot for each QmKeys::Key, UnknownKey included */
+#define QMKEYS_KEY_SLOTS (MeeGo::QmKeys::PowerKey + 2)
+
 namespace MeeGo {
 
-class QmKeysPrivate : public QObject
+class QmKeysPrivate;
+
+/*
+ * The connection to qmkeyd and the key states, shared by all the QmKeys
+ * of the process so that qmkeyd sends each event to the process once.
+ * The signals carry every subscribed key, the front-ends filter them.
+ */
+class QmKeysBackend : public QObject
 {
     Q_OBJECT
 
 public:
-    QmKeysPrivate(QObject *parent = NULL);
-    ~QmKeysPrivate();
+    static QmKeysBackend *get_object();
+    static void unref_object();
 
     struct input_event keyToEvent(QmKeys::Key key);
     QmKeys::State getKeyState(QmKeys::Key key);
+    QMap<QmKeys::Key, QmKeys::State> getKeyStates(const QList<QmKeys::Key> &keys);
+    int requestKeyStates(const QList<QmKeys::Key> &keys);
+    QmKeys::State getLocalState(QmKeys::Key key);
+    QmKeys::State getLegacyState(QmKeys::Key key);
     int getKeyValue(const struct input_event &query);
+    int getTableValue(__u16 type, __u16 code);
+    QmKeys::State getTableState(QmKeys::Key key);
     QmKeys::Key codeToKey(__u16 code);
+    static __u32 keyToMask(QmKeys::Key key);
+    static int keySlot(QmKeys::Key key) {
+        unsigned int slot = (unsigned int)(key + 1);
+        return slot < QMKEYS_KEY_SLOTS ? slot : 0;
+    }
+    void setFilter(QmKeysPrivate *frontEnd, __u32 mask);
+    void removeFilter(QmKeysPrivate *frontEnd);
+    void handleEvent(const struct input_event &ev);
+    void handleControlEvent(const struct input_event &ev);
 
 public Q_SLOTS:
     void readyRead();
+    void deliverAnswers();
+    void helloTimedOut();
+    void legacyConnected();
+    void legacyReadyRead();
+    void legacyFinished();
 
 
 Q_SIGNALS:
@@ -71,11 +105,143 @@ Q_SIGNALS:
 
   void keyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
 
+  void keyStateReceived(int request, MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+
 private:
+    QmKeysBackend(QObject *parent = NULL);
+    ~QmKeysBackend();
+
+    static QmKeysBackend *object;
+    static QMutex object_mutex;
+    int counter;
+
+    /* The filters of the front-ends that have one */
+    QHash<QmKeysPrivate*, __u32> filters;
+    void updateSubscription();
+
+    /* A key state request waiting for its answer */
+    struct KeyQuery
+    {
+        KeyQuery() : answered(false), sync(false) {}
+
+        QList<QmKeys::Key> keys;
+        QMap<QmKeys::Key, QmKeys::State> states;
+        bool answered;
+        bool sync;      /* getKeyStates() waits for it, there is no signal */
+    };
+
+    /* A request answered by a legacy server over a connection of its own */
+    struct LegacyQuery
+    {
+        int cookie;
+        QVector<struct input_event> codes;      /* the codes asked for */
+        QVector<struct input_event> replies;    /* the codes answered so far */
+    };
+
+    QList<QmKeys::Key> splitLocal(const QList<QmKeys::Key> &keys, QMap<QmKeys::Key, QmKeys::State> &states);
+    void waitForAnswer(int cookie);
+    void handleSnapshot(const struct input_event *events, int count);
+    int nextCookie();
+
+    QmKeys::State trackedState(QmKeys::Key key) const {
+        return keyStates[keySlot(key)];
+    }
+    void setTrackedState(QmKeys::Key key, QmKeys::State state) {
+        if (keySlot(key)) {
+            keyStates[keySlot(key)] = state;
+        }
+    }
+    void resetKeyStates() {
+        for (int i = 0; i < QMKEYS_KEY_SLOTS; i++) {
+            keyStates[i] = QmKeys::KeyInvalid;
+        }
+    }
+    bool canQuery();
+    int sendQuery(const QList<QmKeys::Key> &keys, bool sync);
+    void writeQuery(int cookie, const QList<QmKeys::Key> &keys);
+    void sendRemote(int cookie, const QList<QmKeys::Key> &remote);
+    void sendDeferred();
+    void sendLegacyQuery(int cookie, const QList<QmKeys::Key> &keys);
+    void finishLegacyQuery(QLocalSocket *legacy);
+    void handleReply(__u32 cookie, const struct input_event *events, int count);
+    QmKeys::State codesToState(QmKeys::Key key, const struct input_event *events, int count);
+    void emitAnswer(int request, const KeyQuery &query);
+
+    void mapStateTable();
 
     QLocalSocket *socket;
-    QMap<QmKeys::Key, QmKeys::State> keyMap;
+    int protocolVersion;
+    __u32 subscription;
+    const volatile struct qmkeyd_state *stateTable;
+    /* The states tracked from the events, KeyInvalid until the first
+       event of the key. Slot 0 belongs to UnknownKey and stays invalid,
+       so a key maps to a slot without a branch. */
+    QmKeys::State keyStates[QMKEYS_KEY_SLOTS];
     bool cameraFocusDown;
+
+    bool helloPending;      /* the protocol of qmkeyd is not known yet */
+    bool snapshotPending;   /* qmkeyd is about to send the states of all keys */
+    int lastCookie;
+    QHash<int, KeyQuery> queries;
+    QList<int> answered;    /* answered without qmkeyd, to be emitted */
+    QList<int> deferred;    /* requests waiting for the hello or the snapshot */
+    QHash<QLocalSocket*, LegacyQuery> legacyQueries;
+};
+
+/* The part of a QmKeys of its own: the key filter and the requests made */
+class QmKeysPrivate : public QObject
+{
+    Q_OBJECT
+
+public:
+    QmKeysPrivate(QObject *parent = NULL);
+    ~QmKeysPrivate();
+
+    QmKeys::State getKeyState(QmKeys::Key key) { return backend->getKeyState(key); }
+    QMap<QmKeys::Key, QmKeys::State> getKeyStates(const QList<QmKeys::Key> &keys) { return backend->getKeyStates(keys); }
+    int requestKeyStates(const QList<QmKeys::Key> &keys);
+    void setKeyFilter(const QList<QmKeys::Key> &keys);
+    void setKeyRepeatRate(int rate);
+    void setKeyRepeatRate(QmKeys::Key key, int rate);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private Q_SLOTS:
+    void backendKeyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+    void backendVolumeUpMoved(bool down);
+    void backendVolumeDownMoved(bool down);
+    void backendCameraLauncherMoved(QmKeys::CameraKeyPosition where);
+    void backendKeyboardSliderMoved(QmKeys::KeyboardSliderPosition where);
+    void backendKeyStateReceived(int request, MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+
+Q_SIGNALS:
+    void keyboardSliderMoved(QmKeys::KeyboardSliderPosition where);
+    void lensCoverMoved(QmKeys::LensCoverPosition where);
+    void cameraLauncherMoved(QmKeys::CameraKeyPosition);
+    void volumeUpMoved(bool);
+    void volumeDownMoved(bool);
+    void keyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+    void keyStateReceived(int request, MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state);
+    void keyRepeated(MeeGo::QmKeys::Key key, int count);
+
+private:
+    bool wants(QmKeys::Key key) const { return filter & QmKeysBackend::keyToMask(key); }
+    void flushRepeats(QmKeys::Key key);
+    void volumeMoved(QmKeys::Key key, bool down);
+    void emitMoved(QmKeys::Key key, bool down);
+
+    QmKeysBackend *backend;
+    __u32 filter;
+    QHash<int, int> requests;   /* answers still to come, by request */
+
+    /* Repeat coalescing, off for a key while its interval is zero */
+    int repeatIntervals[QMKEYS_KEY_SLOTS];          /* in milliseconds */
+    QmKeys::State lastStates[QMKEYS_KEY_SLOTS];
+    qint64 lastRepeats[QMKEYS_KEY_SLOTS];           /* when the last repeat was emitted */
+    int pendingRepeats[QMKEYS_KEY_SLOTS];           /* repeats merged since then */
+    bool pendingMoves[QMKEYS_KEY_SLOTS];            /* a volume signal among them */
+    QBasicTimer repeatTimers[QMKEYS_KEY_SLOTS];     /* emit them while the key is held */
 };
 
 }
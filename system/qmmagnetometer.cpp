@@ -35,6 +35,7 @@ namespace MeeGo {
     {
         QmMagnetometerPrivate *priv = new QmMagnetometerPrivate(this);
         connect(priv, SIGNAL(dataAvailable(MeeGo::QmMagnetometerReading)), this, SIGNAL(dataAvailable(MeeGo::QmMagnetometerReading)));
+        connect(priv, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmMagnetometerReading>)), this, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmMagnetometerReading>)));
         priv_ptr = priv;
     }
 
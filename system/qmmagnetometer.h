@@ -32,6 +32,7 @@
 
 #include <QtCore/qobject.h>
 #include <qmsensor.h>
+#include <QVector>
 
 QT_BEGIN_HEADER
 
@@ -96,6 +97,12 @@ namespace MeeGo {
          */
         void dataAvailable(const MeeGo::QmMagnetometerReading& data);
 
+        /**
+         * Signals the availability of a batch of measurements, when the sensor
+         * is batching. See QmSensor::setBatching().
+         * @param data Available measurement data, the oldest first
+         */
+        void dataBatchAvailable(const QVector<MeeGo::QmMagnetometerReading>& data);
     };
 
 } // MeeGo namespace
@@ -30,6 +30,7 @@
 
 #include "qmmagnetometer.h"
 #include "qmsensor_p.h"
+#include "qmsensorhub_p.h"
 #include "magnetometersensor_i.h"
 #include "sensormanagerinterface.h"
 
@@ -45,7 +46,7 @@ namespace MeeGo
     public:
         MagnetometerSensorChannelInterface* sensorIfc;
 
-        QmMagnetometerPrivate(QmMagnetometer* parent) : QmSensorPrivate(parent), sensorIfc(NULL) {
+        QmMagnetometerPrivate(QmMagnetometer* parent) : QmSensorPrivate(parent), sensorIfc(NULL), cursor_(0) {
             pub_ptr = parent;
         }
 
@@ -74,6 +75,17 @@ namespace MeeGo
             if (!initDone_) { if (!init()) return NULL; }
             return MagnetometerSensorChannelInterface::listenInterface("magnetometersensor");
         }
+
+        bool sharesSession() const
+        {
+            return true;
+        }
+
+        QmSensorHub* acquireHub(QmSensor::SessionType type)
+        {
+            return QmSensorHub::get_hub<QmMagneticFieldHub>("magnetometersensor", this, type);
+        }
+
         bool setupSignals(bool setOn)
         {
             MEEGO_PUBLIC(QmMagnetometer)
@@ -82,15 +94,15 @@ namespace MeeGo
             }
 
             if (setOn) {
-                if (!connect(sensorIfc, SIGNAL(dataAvailable(const MagneticField&)),
-                             this, SLOT(slotDataAvailable(const MagneticField&)))) {
+                // Read only the samples published from now on
+                cursor_ = static_cast<QmMagneticFieldHub*>(hub_)->ring.cursor();
+                if (!connect(hub_, SIGNAL(published()), this, SLOT(slotPublished()))) {
                     setError("Unable to connect signals");
                     return false;
                 }
 
             } else {
-                if (!disconnect(sensorIfc, SIGNAL(dataAvailable(const MagneticField&)),
-                             this, SLOT(slotDataAvailable(const MagneticField&)))) {
+                if (!disconnect(hub_, SIGNAL(published()), this, SLOT(slotPublished()))) {
                     setError("Unable to disconnect signals");
                     return false;
                 }
@@ -98,11 +110,37 @@ namespace MeeGo
             return true;
         }
 
+        void reserveBatch(int capacity)
+        {
+            batch_.reserve(capacity);
+        }
+
+        bool filtersSamples() const
+        {
+            return true;
+        }
+
     Q_SIGNALS:
         void dataAvailable(const MeeGo::QmMagnetometerReading &data);
+        void dataBatchAvailable(const QVector<MeeGo::QmMagnetometerReading> &data);
 
         public Q_SLOTS:
 
+        void flushBatch()
+        {
+            if (!batch_.isEmpty()) {
+                emit dataBatchAvailable(batch_.take());
+            }
+        }
+
+        void slotPublished()
+        {
+            CalibratedMagneticFieldData sample;
+            while (static_cast<QmMagneticFieldHub*>(hub_)->ring.read(cursor_, sample)) {
+                slotDataAvailable(MagneticField(sample));
+            }
+        }
+
         void slotDataAvailable(const MagneticField& data)
         {
             QmMagnetometerReading output;
@@ -115,8 +153,22 @@ namespace MeeGo
             output.timestamp = data.data().timestamp_;
             output.level = data.data().level_;
 
+            if (!filters_.isEmpty()) {
+                filters_.apply(output.x, output.y, output.z);
+            }
+
+            if (batching()) {
+                if (batch_.append(output)) {
+                    flushBatch();
+                }
+                return;
+            }
             emit dataAvailable(output);
         }
+
+    private:
+        QmSensorBatch<QmMagnetometerReading> batch_;
+        unsigned int cursor_;
     };
 
 
@@ -34,6 +34,7 @@ namespace MeeGo {
     {
         QmRotationPrivate *priv = new QmRotationPrivate(this);
         connect(priv, SIGNAL(dataAvailable(const MeeGo::QmRotationReading&)), this, SIGNAL(dataAvailable(const MeeGo::QmRotationReading&)));
+        connect(priv, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmRotationReading>)), this, SIGNAL(dataBatchAvailable(QVector<MeeGo::QmRotationReading>)));
         priv_ptr = priv;
     }
 
@@ -31,6 +31,7 @@
 
 #include <QtCore/qobject.h>
 #include <qmsensor.h>
+#include <QVector>
 
 QT_BEGIN_HEADER
 
@@ -137,6 +138,12 @@ namespace MeeGo {
          */
         void dataAvailable(const MeeGo::QmRotationReading& data);
 
+        /**
+         * Signals the availability of a batch of measurements, when the sensor
+         * is batching. See QmSensor::setBatching().
+         * @param data Available measurement data, the oldest first
+         */
+        void dataBatchAvailable(const QVector<MeeGo::QmRotationReading>& data);
     };
 
 } // MeeGo namespace
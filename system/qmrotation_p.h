@@ -30,6 +30,8 @@
 
 #include "qmrotation.h"
 #include "qmsensor_p.h"
+#include "qmsensorhub_p.h"
+#include "qmsensortransform_p.h"
 #include "rotationsensor_i.h"
 #include "sensormanagerinterface.h"
 #include <math.h>
@@ -46,7 +48,7 @@ namespace MeeGo
     public:
         RotationSensorChannelInterface* sensorIfc;
 
-        QmRotationPrivate(QmRotation *parent) : QmSensorPrivate(parent), sensorIfc(NULL) {
+        QmRotationPrivate(QmRotation *parent) : QmSensorPrivate(parent), sensorIfc(NULL), cursor_(0) {
             pub_ptr = parent;
         }
 
@@ -76,6 +78,16 @@ namespace MeeGo
             return RotationSensorChannelInterface::listenInterface("rotationsensor");
         }
 
+        bool sharesSession() const
+        {
+            return true;
+        }
+
+        QmSensorHub* acquireHub(QmSensor::SessionType type)
+        {
+            return QmSensorHub::get_hub<QmXYZHub>("rotationsensor", this, type);
+        }
+
         bool setupSignals(bool setOn)
         {
             MEEGO_PUBLIC(QmRotation);
@@ -84,15 +96,15 @@ namespace MeeGo
             }
 
             if (setOn) {
-                if (!connect(sensorIfc, SIGNAL(dataAvailable(const XYZ&)),
-                             this, SLOT(slotDataAvailable(const XYZ&)))) {
+                // Read only the samples published from now on
+                cursor_ = static_cast<QmXYZHub*>(hub_)->ring.cursor();
+                if (!connect(hub_, SIGNAL(published()), this, SLOT(slotPublished()))) {
                     setError("Unable to connect signals");
                     return false;
                 }
 
             } else {
-                if (!disconnect(sensorIfc, SIGNAL(dataAvailable(const XYZ&)),
-                             this, SLOT(slotDataAvailable(const XYZ&)))) {
+                if (!disconnect(hub_, SIGNAL(published()), this, SLOT(slotPublished()))) {
                     setError("Unable to disconnect signals");
                     return false;
                 }
@@ -100,42 +112,65 @@ namespace MeeGo
             return true;
         }
 
+        void reserveBatch(int capacity)
+        {
+            batch_.reserve(capacity);
+        }
+
     Q_SIGNALS:
         void dataAvailable(const MeeGo::QmRotationReading& data);
+        void dataBatchAvailable(const QVector<MeeGo::QmRotationReading>& data);
 
     public Q_SLOTS:
 
-        void slotDataAvailable(const XYZ& data)
+        void flushBatch()
         {
-            QmRotationReading output;
-            output.timestamp = data.XYZData().timestamp_;
-
-            // Mangle X to definition...
-            if (abs(data.y()) <= 90)
-            {
-                output.x = -data.y();
-            }
-            else
-            {
-                output.x = (data.y()<0 ? 1 : -1) * 180 + data.y();
+            if (!batch_.isEmpty()) {
+                emit dataBatchAvailable(batch_.take());
             }
+        }
 
-            // Mangle Y to definition
-            if (abs(data.y()) <= 90)
-            {
-                output.y = data.x();
-            }
-            else
-            {
-                output.y = (data.x()>0 ? 1 : -1) * (180-abs(data.x()));
+        void slotPublished()
+        {
+            TimedXyzData sample;
+            while (static_cast<QmXYZHub*>(hub_)->ring.read(cursor_, sample)) {
+                if (block_.append(sample.timestamp_, sample.x_, sample.y_, sample.z_)) {
+                    deliverBlock();
+                }
             }
+            deliverBlock();
+        }
 
-            // ..and finally match z=0 to north.
-            output.z = (((data.z() + 180) + 90) % 360) - 180;
-
+    private:
+        void deliverBlock()
+        {
+            QmSensorTransform::foldRotation(block_.x, block_.y, block_.z,
+                                            block_.x, block_.y, block_.z, block_.count);
+            for (int i = 0; i < block_.count; i++) {
+                QmRotationReading output;
+                output.timestamp = block_.timestamp[i];
+                output.x = block_.x[i];
+                output.y = block_.y[i];
+                output.z = block_.z[i];
+                deliver(output);
+            }
+            block_.count = 0;
+        }
 
+        void deliver(const QmRotationReading& output)
+        {
+            if (batching()) {
+                if (batch_.append(output)) {
+                    flushBatch();
+                }
+                return;
+            }
             emit dataAvailable(output);
         }
+
+        QmSensorBatch<QmRotationReading> batch_;
+        unsigned int cursor_;
+        QmXYZBlock block_;
     };
 
 
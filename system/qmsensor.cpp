@@ -26,6 +26,7 @@
  */
 #include "qmsensor.h"
 #include "qmsensor_p.h"
+#include "qmsensorhub_p.h"
 #include "system_global.h"
 #include "sensormanagerinterface.h"
 #include <QDebug>
@@ -39,9 +40,11 @@ namespace MeeGo {
 
     // ----------------- BEGIN PRIVATE CLASS DEFINITION ----------------- //
 
-    QmSensorPrivate::QmSensorPrivate(QmSensor *sensor) : QObject(sensor), sessionType_(QmSensor::SessionTypeNone), initDone_(false), running_(false)
+    QmSensorPrivate::QmSensorPrivate(QmSensor *sensor) : QObject(sensor), sessionType_(QmSensor::SessionTypeNone), initDone_(false), running_(false),
+        batchCount_(0), batchInterval_(0), hub_(NULL)
     {
         connect(this, SIGNAL(errorSignal(QString)), sensor, SIGNAL(errorSignal(QString)));
+        connect(&batchTimer_, SIGNAL(timeout()), this, SLOT(flushBatch()));
     }
 
     QmSensorPrivate::~QmSensorPrivate() {}
@@ -75,6 +78,17 @@ namespace MeeGo {
             return QmSensor::SessionTypeNone;
         }
 
+        if (sharesSession()) {
+            hub_ = acquireHub(type);
+            if (hub_ == NULL) {
+                setError(remoteSensorManager.errorString());
+                return QmSensor::SessionTypeNone;
+            }
+            *sensorIfcPtr = hub_->sensorIfc();
+            sessionType_ = qMin(type, hub_->sessionType());
+            return sessionType_;
+        }
+
         do {
             switch (type) {
                 case QmSensor::SessionTypeControl:
@@ -116,7 +130,12 @@ namespace MeeGo {
         GET_SENSOR_PTR_PTR(sensorIfc);
         if (*sensorIfc) {
             stop();
-            delete *sensorIfc;
+            if (hub_) {
+                hub_->unref_hub(this);
+                hub_ = NULL;
+            } else {
+                delete *sensorIfc;
+            }
             *sensorIfc = NULL;
         }
         sessionType_ = QmSensor::SessionTypeNone;
@@ -125,7 +144,9 @@ namespace MeeGo {
     bool QmSensorPrivate::start()
     {
         GET_SENSOR_PTR(sensorIfc);
-        if (sensorIfc) {
+        if (hub_) {
+            hub_->start(this);
+        } else if (sensorIfc) {
             // XXX: Check for valid D-Bus reply, set error.
             sensorIfc->start();
         } else {
@@ -138,7 +159,9 @@ namespace MeeGo {
     bool QmSensorPrivate::stop()
     {
         GET_SENSOR_PTR(sensorIfc);
-        if (sensorIfc) {
+        if (hub_) {
+            hub_->stop(this);
+        } else if (sensorIfc) {
             // XXX: Check for valid D-Bus reply, set error.
             sensorIfc->stop();
         } else {
@@ -160,7 +183,9 @@ namespace MeeGo {
     void QmSensorPrivate::setInterval(int value)
     {
         GET_SENSOR_PTR(sensorIfc);
-        if (sensorIfc) {
+        if (hub_) {
+            hub_->setInterval(this, value);
+        } else if (sensorIfc) {
             sensorIfc->setInterval(value);
         }
     }
@@ -177,11 +202,45 @@ namespace MeeGo {
     void QmSensorPrivate::setStandbyOverride(bool value)
     {
         GET_SENSOR_PTR(sensorIfc);
-        if (sensorIfc) {
+        if (hub_) {
+            hub_->setStandbyOverride(this, value);
+        } else if (sensorIfc) {
             sensorIfc->setStandbyOverride(value);
         }
     }
 
+    void QmSensorPrivate::setBatching(int count, int interval)
+    {
+        // Deliver what was collected with the old settings first
+        flushBatch();
+
+        batchCount_ = qMax(count, 0);
+        batchInterval_ = qMax(interval, 0);
+
+        if (batching()) {
+            reserveBatch(batchCount_ > 0 ? batchCount_ : QMSENSOR_MAX_BATCH);
+        }
+        // The timer runs only while the sensor does, see start() and stop()
+        if (batchInterval_ > 0 && running_) {
+            batchTimer_.start(batchInterval_);
+        } else {
+            batchTimer_.stop();
+        }
+    }
+
+    bool QmSensorPrivate::addFilter(QmSensor::FilterType type, qreal parameter)
+    {
+        if (!filtersSamples()) {
+            setError("The sensor has no filters");
+            return false;
+        }
+        if (!filters_.add(type, parameter)) {
+            setError("Unable to add filter, the chain is full or the parameter is invalid");
+            return false;
+        }
+        return true;
+    }
+
     void QmSensorPrivate::setError(QString error)
     {
         errorString_ = error;
@@ -210,7 +269,11 @@ namespace MeeGo {
         if (priv->running_) return true;
         if (priv->start()) {
             priv->running_ = true;
+            priv->filters_.reset();
             priv->setupSignals(true);
+            if (priv->batchInterval_ > 0) {
+                priv->batchTimer_.start(priv->batchInterval_);
+            }
             return true;
         }
         return false;
@@ -223,6 +286,8 @@ namespace MeeGo {
 
         if (priv->stop()) {
             priv->running_ = false;
+            priv->batchTimer_.stop();
+            priv->flushBatch();
 
             // Unbind signals, in case another listener keeps session open
             priv->setupSignals(false);
@@ -286,4 +351,40 @@ namespace MeeGo {
         MEEGO_PRIVATE(QmSensor);
         priv->setStandbyOverride(value);
     }
+
+    void QmSensor::setBatching(int count, int interval)
+    {
+        MEEGO_PRIVATE(QmSensor);
+        priv->setBatching(count, interval);
+    }
+
+    int QmSensor::batchCount()
+    {
+        MEEGO_PRIVATE(QmSensor);
+        return priv->batchCount();
+    }
+
+    int QmSensor::batchInterval()
+    {
+        MEEGO_PRIVATE(QmSensor);
+        return priv->batchInterval();
+    }
+
+    bool QmSensor::addFilter(FilterType type, qreal parameter)
+    {
+        MEEGO_PRIVATE(QmSensor);
+        return priv->addFilter(type, parameter);
+    }
+
+    void QmSensor::clearFilters()
+    {
+        MEEGO_PRIVATE(QmSensor);
+        priv->clearFilters();
+    }
+
+    int QmSensor::filterCount()
+    {
+        MEEGO_PRIVATE(QmSensor);
+        return priv->filterCount();
+    }
 }
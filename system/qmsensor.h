@@ -118,6 +118,13 @@ namespace MeeGo {
             SessionTypeControl  /**< Control session */
         };
 
+        /** Filters for the samples, see #addFilter */
+        enum FilterType {
+            FilterLowPass,      /**< Smooths the samples */
+            FilterHighPass,     /**< Removes the slowly changing part, such as gravity */
+            FilterMedian        /**< Removes single outliers */
+        };
+
         virtual ~QmSensor();
 
         /**
@@ -217,6 +224,72 @@ namespace MeeGo {
          */
         void setStandbyOverride(bool value);
 
+        /**
+         * Sets the sensor to deliver its samples in batches. While batching,
+         * the samples are collected and delivered together by the batch
+         * signal of the sensor, for example
+         * QmAccelerometer::dataBatchAvailable(), instead of one signal per
+         * sample. A batch is delivered when it has \c count samples, or
+         * every \c interval milliseconds, whichever comes first, and when
+         * the sensor is stopped. Sensors without a batch signal ignore this.
+         * The batches reuse their buffers as long as the receivers let go
+         * of each batch before the next one is delivered; a batch kept
+         * longer makes the sensor allocate a new buffer.
+         *
+         * @param count Samples in a batch, 0 for no limit. Room for the
+         *              whole batch is allocated up front. Without a limit
+         *              a batch is delivered at the latest when it has
+         *              1024 samples.
+         * @param interval Delivery interval in milliseconds, 0 for none.
+         *                 With both zero each sample is delivered alone,
+         *                 which is the default.
+         */
+        void setBatching(int count, int interval);
+
+        /**
+         * Returns the number of samples in a batch. See #setBatching.
+         * @return Samples in a batch, 0 for no limit
+         */
+        int batchCount();
+
+        /**
+         * Returns the batch delivery interval. See #setBatching.
+         * @return Delivery interval in milliseconds, 0 for none
+         */
+        int batchInterval();
+
+        /**
+         * Adds a filter to the end of the filter chain of the sensor. The
+         * samples pass through the filters of the chain in the order they
+         * were added before they are delivered, one axis at a time. The
+         * filters start over when the sensor is started. Only the
+         * accelerometer and magnetometer filter their samples.
+         *
+         * For #FilterLowPass and #FilterHighPass the parameter is the share
+         * of each new sample in the filtered value, between 0 and 1: the
+         * smaller, the smoother the low-pass output and the less of the
+         * slow changes there is left in the high-pass output. For
+         * #FilterMedian it is the odd number of samples, at most 15, that
+         * the median is taken of.
+         *
+         * @param type Type of the filter
+         * @param parameter Parameter of the filter
+         * @return \c true on success, \c false if the sensor has no filters,
+         *         the chain already has 4 filters or the parameter is invalid
+         */
+        bool addFilter(FilterType type, qreal parameter);
+
+        /**
+         * Removes all the filters, see #addFilter.
+         */
+        void clearFilters();
+
+        /**
+         * Returns the number of filters in the filter chain, see #addFilter.
+         * @return Number of filters
+         */
+        int filterCount();
+
     Q_SIGNALS:
         /**
          * Emitted when an error occurs. See #lastError().
@@ -30,6 +30,14 @@
 
 #include "abstractsensor_i.h"
 #include "qmsensor.h"
+#include "qmsensorfilter_p.h"
+
+#include <QTimer>
+#include <QVector>
+
+/* Largest batch, for batches limited only by the delivery interval,
+   see QmSensor::setBatching() */
+#define QMSENSOR_MAX_BATCH 1024
 
 #define DEFINE_GENERIC_FUNCTIONS(Class) \
         private: \
@@ -46,10 +54,72 @@
 
 namespace MeeGo 
 {
+    class QmSensorHub;
+
+    /**
+     * The samples of a batch, collected into preallocated buffers. Two
+     * buffers take turns, so that a batch that has been delivered can be
+     * reused once its receivers are done with it, without allocating. A
+     * buffer still held by a receiver is replaced by a new one instead.
+     */
+    template <typename T>
+    class QmSensorBatch
+    {
+    public:
+        QmSensorBatch() : current_(0), capacity_(0) {}
+
+        void reserve(int capacity)
+        {
+            capacity_ = capacity;
+            buffers_[0].reserve(capacity);
+            buffers_[1].reserve(capacity);
+        }
+
+        /**
+         * Adds a sample to the batch.
+         * @return \c true when the batch is full
+         */
+        bool append(const T &sample)
+        {
+            buffers_[current_].append(sample);
+            return buffers_[current_].size() >= capacity_;
+        }
+
+        bool isEmpty() const
+        {
+            return buffers_[current_].isEmpty();
+        }
+
+        /**
+         * Takes the samples of the batch and starts a new one.
+         */
+        QVector<T> take()
+        {
+            QVector<T> batch = buffers_[current_];
+            current_ ^= 1;
+            QVector<T> &next = buffers_[current_];
+            if (next.isDetached()) {
+                next.resize(0);
+            } else {
+                // A receiver still holds the last batch of the buffer,
+                // and clearing it would copy that, so start a new one
+                next = QVector<T>();
+                next.reserve(capacity_);
+            }
+            return batch;
+        }
+
+    private:
+        QVector<T> buffers_[2];
+        int current_;
+        int capacity_;
+    };
+
     class QmSensorPrivate : public QObject
     {
         Q_OBJECT;
         MEEGO_DECLARE_PUBLIC(QmSensor)
+        friend class QmSensorHub;
 
     public:
 
@@ -69,9 +139,25 @@ namespace MeeGo
         bool standbyOverride();
         void setStandbyOverride(bool value);
 
+        void setBatching(int count, int interval);
+        int batchCount() const { return batchCount_; }
+        int batchInterval() const { return batchInterval_; }
+        bool batching() const { return batchCount_ > 0 || batchInterval_ > 0; }
+
+        bool addFilter(QmSensor::FilterType type, qreal parameter);
+        void clearFilters() { filters_.clear(); }
+        int filterCount() const { return filters_.count(); }
+
     Q_SIGNALS:
         void errorSignal(QString error);
 
+    public Q_SLOTS:
+        /**
+         * Delivers the samples collected while batching. Sensors with a
+         * batch signal implement this.
+         */
+        virtual void flushBatch() {}
+
     protected:
 
         /**
@@ -117,6 +203,32 @@ namespace MeeGo
          */
         virtual const AbstractSensorChannelInterface* listenSession() = 0;
 
+        /**
+         * Returns \c true for sensors that share one session among all the
+         * sensors of the process through a QmSensorHub.
+         */
+        virtual bool sharesSession() const { return false; }
+
+        /**
+         * Returns a reference to the hub of the sensor, opening its session
+         * with type if the hub has none. Sensors that share their session
+         * implement this with QmSensorHub::get_hub().
+         */
+        virtual QmSensorHub* acquireHub(QmSensor::SessionType type) { Q_UNUSED(type); return NULL; }
+
+        /**
+         * Called when the batch size changes, with the number of samples
+         * the batches of the sensor need room for. Sensors with a batch
+         * signal implement this.
+         */
+        virtual void reserveBatch(int capacity) { Q_UNUSED(capacity); }
+
+        /**
+         * Returns \c true for sensors that run their samples through
+         * #filters_ before delivering them.
+         */
+        virtual bool filtersSamples() const { return false; }
+
         /**
          * Setup signals connections for sensor. Bind sensor interface to
          * QmSensor subclass.
@@ -134,6 +246,14 @@ namespace MeeGo
         void setError(QString error);
         QString errorString_;
         bool running_;
+
+        int batchCount_;
+        int batchInterval_;
+        QTimer batchTimer_;
+
+        QmSensorFilterChain filters_;
+
+        QmSensorHub* hub_;
     };
     
 } // MeeGo namespace
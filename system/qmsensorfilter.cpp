@@ -0,0 +1,149 @@
+/*!
+ * @file qmsensorfilter.cpp
+ * @brief QmSensorFilterChain
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmsensorfilter_p.h"
+
+namespace MeeGo {
+
+void QmSensorFilter::setup(QmSensor::FilterType type, float parameter)
+{
+    type_ = type;
+    alpha_ = parameter;
+    window_ = (int)parameter;
+    reset();
+}
+
+void QmSensorFilter::reset()
+{
+    primed_ = false;
+    count_ = 0;
+    next_ = 0;
+}
+
+void QmSensorFilter::apply(float *xyz)
+{
+    switch (type_) {
+    case QmSensor::FilterLowPass:
+        if (!primed_) {
+            for (int axis = 0; axis < 3; axis++) {
+                state_[axis] = xyz[axis];
+            }
+            primed_ = true;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            state_[axis] += alpha_ * (xyz[axis] - state_[axis]);
+            xyz[axis] = state_[axis];
+        }
+        break;
+
+    case QmSensor::FilterHighPass:
+        // The state follows the slow part, e.g. gravity, which is removed
+        if (!primed_) {
+            for (int axis = 0; axis < 3; axis++) {
+                state_[axis] = xyz[axis];
+            }
+            primed_ = true;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            state_[axis] += alpha_ * (xyz[axis] - state_[axis]);
+            xyz[axis] -= state_[axis];
+        }
+        break;
+
+    case QmSensor::FilterMedian:
+        median(xyz);
+        break;
+    }
+}
+
+void QmSensorFilter::median(float *xyz)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        history_[axis][next_] = xyz[axis];
+    }
+    next_ = (next_ + 1) % window_;
+    if (count_ < window_) {
+        count_++;
+    }
+
+    // Until the window fills up, the median of the samples so far
+    for (int axis = 0; axis < 3; axis++) {
+        float sorted[QMSENSOR_MAX_MEDIAN];
+        for (int i = 0; i < count_; i++) {
+            float value = history_[axis][i];
+            int j = i;
+            for (; j > 0 && sorted[j - 1] > value; j--) {
+                sorted[j] = sorted[j - 1];
+            }
+            sorted[j] = value;
+        }
+        xyz[axis] = (count_ & 1) ? sorted[count_ / 2]
+                                 : (sorted[count_ / 2 - 1] + sorted[count_ / 2]) / 2;
+    }
+}
+
+bool QmSensorFilterChain::add(QmSensor::FilterType type, qreal parameter)
+{
+    if (count_ == QMSENSOR_MAX_FILTERS) {
+        return false;
+    }
+
+    switch (type) {
+    case QmSensor::FilterLowPass:
+    case QmSensor::FilterHighPass:
+        if (parameter <= 0 || parameter > 1) {
+            return false;
+        }
+        break;
+    case QmSensor::FilterMedian:
+        if (parameter != (int)parameter || (int)parameter < 1
+            || (int)parameter > QMSENSOR_MAX_MEDIAN || !((int)parameter & 1)) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    filters_[count_++].setup(type, parameter);
+    return true;
+}
+
+void QmSensorFilterChain::reset()
+{
+    for (int i = 0; i < count_; i++) {
+        filters_[i].reset();
+    }
+}
+
+void QmSensorFilterChain::apply(int &x, int &y, int &z)
+{
+    float xyz[3] = { (float)x, (float)y, (float)z };
+    for (int i = 0; i < count_; i++) {
+        filters_[i].apply(xyz);
+    }
+    x = qRound(xyz[0]);
+    y = qRound(xyz[1]);
+    z = qRound(xyz[2]);
+}
+
+} // namespace MeeGo
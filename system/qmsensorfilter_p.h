@@ -0,0 +1,89 @@
+/*!
+ * @file qmsensorfilter_p.h
+ * @brief Contains QmSensorFilterChain
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMSENSORFILTER_P_H
+#define QMSENSORFILTER_P_H
+
+#include "qmsensor.h"
+
+/* Filters in a chain, and samples in a median window */
+#define QMSENSOR_MAX_FILTERS 4
+#define QMSENSOR_MAX_MEDIAN 15
+
+namespace MeeGo
+{
+    /**
+     * A filter of XYZ samples. All the state is kept in the filter itself,
+     * so filtering never allocates.
+     */
+    class QmSensorFilter
+    {
+    public:
+        void setup(QmSensor::FilterType type, float parameter);
+        void reset();
+        void apply(float *xyz);
+
+    private:
+        void median(float *xyz);
+
+        QmSensor::FilterType type_;
+        float alpha_;
+        int window_;
+
+        bool primed_;
+        float state_[3];
+
+        float history_[3][QMSENSOR_MAX_MEDIAN];
+        int count_;
+        int next_;
+    };
+
+    /**
+     * The filters a sensor runs its samples through, see
+     * QmSensor::addFilter().
+     */
+    class QmSensorFilterChain
+    {
+    public:
+        QmSensorFilterChain() : count_(0) {}
+
+        bool add(QmSensor::FilterType type, qreal parameter);
+        void clear() { count_ = 0; }
+        void reset();
+        int count() const { return count_; }
+        bool isEmpty() const { return count_ == 0; }
+
+        /**
+         * Filters a sample in place.
+         */
+        void apply(int &x, int &y, int &z);
+
+    private:
+        QmSensorFilter filters_[QMSENSOR_MAX_FILTERS];
+        int count_;
+    };
+
+} // MeeGo namespace
+
+#endif // QMSENSORFILTER_P_H
@@ -0,0 +1,159 @@
+/*!
+ * @file qmsensorhub.cpp
+ * @brief QmSensorHub
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmsensorhub_p.h"
+#include "qmsensor_p.h"
+
+namespace MeeGo {
+
+QHash<QString, QmSensorHub*> QmSensorHub::hubs;
+QMutex QmSensorHub::hubs_mutex;
+
+QmSensorHub::QmSensorHub() : sensorIfc_(NULL), sessionType_(QmSensor::SessionTypeNone), counter(0), pending_(0)
+{
+}
+
+QmSensorHub::~QmSensorHub()
+{
+    delete sensorIfc_;
+}
+
+bool QmSensorHub::open(const QString &name, QmSensorPrivate *sensor, QmSensor::SessionType type)
+{
+    if (type == QmSensor::SessionTypeControl) {
+        sensorIfc_ = sensor->controlSession();
+        if (sensorIfc_) {
+            sessionType_ = QmSensor::SessionTypeControl;
+        }
+    }
+    if (!sensorIfc_) {
+        sensorIfc_ = const_cast<AbstractSensorChannelInterface*>(sensor->listenSession());
+        if (sensorIfc_) {
+            sessionType_ = QmSensor::SessionTypeListen;
+        }
+    }
+    if (!sensorIfc_) {
+        return false;
+    }
+    if (!connectSource()) {
+        delete sensorIfc_;
+        sensorIfc_ = NULL;
+        sessionType_ = QmSensor::SessionTypeNone;
+        return false;
+    }
+    name_ = name;
+    return true;
+}
+
+void QmSensorHub::unref_hub(QmSensorPrivate *sensor)
+{
+    QMutexLocker locker(&hubs_mutex);
+
+    if (running_.remove(sensor) && running_.isEmpty()) {
+        sensorIfc_->stop();
+    }
+    if (intervals_.remove(sensor)) {
+        applyInterval();
+    }
+    if (standbyOverrides_.remove(sensor) && standbyOverrides_.isEmpty()) {
+        sensorIfc_->setStandbyOverride(false);
+    }
+
+    if (--counter == 0) {
+        hubs.remove(name_);
+        disconnect(sensorIfc_, 0, this, 0);
+        // The session may be in the middle of delivering a sample
+        deleteLater();
+    }
+}
+
+void QmSensorHub::start(QmSensorPrivate *sensor)
+{
+    QMutexLocker locker(&hubs_mutex);
+    if (running_.isEmpty()) {
+        // XXX: Check for valid D-Bus reply, set error.
+        sensorIfc_->start();
+    }
+    running_.insert(sensor);
+}
+
+void QmSensorHub::stop(QmSensorPrivate *sensor)
+{
+    QMutexLocker locker(&hubs_mutex);
+    if (running_.remove(sensor) && running_.isEmpty()) {
+        // XXX: Check for valid D-Bus reply, set error.
+        sensorIfc_->stop();
+    }
+}
+
+void QmSensorHub::setInterval(QmSensorPrivate *sensor, int value)
+{
+    QMutexLocker locker(&hubs_mutex);
+    if (value > 0) {
+        intervals_.insert(sensor, value);
+    } else {
+        intervals_.remove(sensor);
+    }
+    applyInterval();
+}
+
+void QmSensorHub::applyInterval()
+{
+    // Zero lets sensord choose, when nobody asks for an interval
+    int shortest = 0;
+    foreach (int value, intervals_) {
+        if (shortest == 0 || value < shortest) {
+            shortest = value;
+        }
+    }
+    sensorIfc_->setInterval(shortest);
+}
+
+void QmSensorHub::setStandbyOverride(QmSensorPrivate *sensor, bool value)
+{
+    QMutexLocker locker(&hubs_mutex);
+    if (value) {
+        standbyOverrides_.insert(sensor);
+    } else {
+        standbyOverrides_.remove(sensor);
+    }
+    sensorIfc_->setStandbyOverride(!standbyOverrides_.isEmpty());
+}
+
+void QmSensorHub::announce()
+{
+    if (++pending_ >= QMSENSORHUB_RING_SIZE / 2) {
+        announcePending();
+    } else if (pending_ == 1) {
+        QMetaObject::invokeMethod(this, "announcePending", Qt::QueuedConnection);
+    }
+}
+
+void QmSensorHub::announcePending()
+{
+    if (pending_ > 0) {
+        pending_ = 0;
+        emit published();
+    }
+}
+
+} // namespace MeeGo
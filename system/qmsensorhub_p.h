@@ -0,0 +1,219 @@
+/*!
+ * @file qmsensorhub_p.h
+ * @brief Contains QmSensorHub
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMSENSORHUB_P_H
+#define QMSENSORHUB_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#include "qmsensor.h"
+#include "abstractsensor_i.h"
+#include "accelerometersensor_i.h"
+#include "compasssensor_i.h"
+#include "magnetometersensor_i.h"
+#include "qmsensorring_p.h"
+
+namespace MeeGo
+{
+    class QmSensorPrivate;
+
+    /**
+     * One sensord session of a sensor, shared by all the QmSensor objects
+     * of the process that use the sensor. The hub publishes the samples of
+     * the session into a ring, and announces them with #published() once
+     * the burst sensord sent them in is over, so that the readers can take
+     * them as one block. The sensor is running while any of the QmSensor
+     * objects runs it, at the shortest interval any of them asks for.
+     */
+    class QmSensorHub : public QObject
+    {
+        Q_OBJECT;
+
+    public:
+        /**
+         * Returns the hub of the sensor called name, creating it with a
+         * session of type opened through sensor if there is none. The
+         * session of an existing hub is shared as it is, so a sensor asking
+         * for a control session may get a listening one, as it would when
+         * sensord has given the control session to someone else.
+         *
+         * @return The hub, or NULL if no session could be opened
+         */
+        template <class Hub>
+        static QmSensorHub *get_hub(const QString &name, QmSensorPrivate *sensor,
+                                    QmSensor::SessionType type)
+        {
+            QMutexLocker locker(&hubs_mutex);
+            QmSensorHub *hub = hubs.value(name);
+            if (!hub) {
+                hub = new Hub();
+                if (!hub->open(name, sensor, type)) {
+                    delete hub;
+                    return NULL;
+                }
+                hubs.insert(name, hub);
+            }
+            ++hub->counter;
+            return hub;
+        }
+
+        /**
+         * Drops the reference of sensor, and the hub with its session
+         * along with the last reference.
+         */
+        void unref_hub(QmSensorPrivate *sensor);
+
+        AbstractSensorChannelInterface* sensorIfc() const { return sensorIfc_; }
+        QmSensor::SessionType sessionType() const { return sessionType_; }
+
+        /**
+         * The sensor runs while any of the sensors sharing it has started it.
+         */
+        void start(QmSensorPrivate *sensor);
+        void stop(QmSensorPrivate *sensor);
+
+        /**
+         * The sensor runs at the shortest interval set by the sensors sharing
+         * it, and stays on in standby if any of them overrides the standby.
+         */
+        void setInterval(QmSensorPrivate *sensor, int value);
+        void setStandbyOverride(QmSensorPrivate *sensor, bool value);
+
+    Q_SIGNALS:
+        void published();
+
+    protected:
+        QmSensorHub();
+        virtual ~QmSensorHub();
+
+        /**
+         * Connects the data signal of the session to the hub.
+         */
+        virtual bool connectSource() = 0;
+
+        /**
+         * Announces a sample pushed into the ring. The samples are announced
+         * together from the event loop after the burst, or at once when half
+         * of the ring is waiting, so that no reader loses any of them.
+         */
+        void announce();
+
+        AbstractSensorChannelInterface* sensorIfc_;
+
+    private Q_SLOTS:
+        void announcePending();
+
+    private:
+        bool open(const QString &name, QmSensorPrivate *sensor, QmSensor::SessionType type);
+        void applyInterval();
+
+        QString name_;
+        QmSensor::SessionType sessionType_;
+        int counter;
+        int pending_;
+
+        QSet<QmSensorPrivate*> running_;
+        QHash<QmSensorPrivate*, int> intervals_;
+        QSet<QmSensorPrivate*> standbyOverrides_;
+
+        static QHash<QString, QmSensorHub*> hubs;
+        static QMutex hubs_mutex;
+    };
+
+    /** Hub of the sensors with XYZ samples */
+    class QmXYZHub : public QmSensorHub
+    {
+        Q_OBJECT;
+
+    public:
+        QmSensorRing<TimedXyzData> ring;
+
+    protected:
+        bool connectSource()
+        {
+            return connect(sensorIfc_, SIGNAL(dataAvailable(const XYZ&)),
+                           this, SLOT(publish(const XYZ&)));
+        }
+
+    private Q_SLOTS:
+        void publish(const XYZ& data)
+        {
+            ring.push(data.XYZData());
+            announce();
+        }
+    };
+
+    /** Hub of the magnetometer */
+    class QmMagneticFieldHub : public QmSensorHub
+    {
+        Q_OBJECT;
+
+    public:
+        QmSensorRing<CalibratedMagneticFieldData> ring;
+
+    protected:
+        bool connectSource()
+        {
+            return connect(sensorIfc_, SIGNAL(dataAvailable(const MagneticField&)),
+                           this, SLOT(publish(const MagneticField&)));
+        }
+
+    private Q_SLOTS:
+        void publish(const MagneticField& data)
+        {
+            ring.push(data.data());
+            announce();
+        }
+    };
+
+    /** Hub of the compass */
+    class QmCompassHub : public QmSensorHub
+    {
+        Q_OBJECT;
+
+    public:
+        QmSensorRing<CompassData> ring;
+
+    protected:
+        bool connectSource()
+        {
+            return connect(sensorIfc_, SIGNAL(dataAvailable(const Compass&)),
+                           this, SLOT(publish(const Compass&)));
+        }
+
+    private Q_SLOTS:
+        void publish(const Compass& data)
+        {
+            ring.push(data.data());
+            announce();
+        }
+    };
+
+} // MeeGo namespace
+
+#endif // QMSENSORHUB_P_H
@@ -0,0 +1,100 @@
+/*!
+ * @file qmsensorring_p.h
+ * @brief Contains QmSensorRing
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMSENSORRING_P_H
+#define QMSENSORRING_P_H
+
+/* Samples kept for the readers of a hub, a power of two */
+#define QMSENSORHUB_RING_SIZE 64
+
+namespace MeeGo
+{
+    /**
+     * The latest samples of a sensor. One writer publishes the samples, and
+     * any number of readers read them at their own pace with cursors of
+     * their own, without locking. A reader that falls as far behind as the
+     * size of the ring loses the oldest samples.
+     */
+    template <typename T>
+    class QmSensorRing
+    {
+    public:
+        QmSensorRing() : head_(0) {}
+
+        void push(const T &sample)
+        {
+            ring_[head_ & (QMSENSORHUB_RING_SIZE - 1)] = sample;
+
+            // Publish the head only after the sample is complete
+            __sync_synchronize();
+            head_ = head_ + 1;
+        }
+
+        /**
+         * Cursor of a reader that starts with the next sample published.
+         */
+        unsigned int cursor() const
+        {
+            return head_;
+        }
+
+        /**
+         * Reads the sample at cursor and advances the cursor.
+         * @return \c false when there are no more samples
+         */
+        bool read(unsigned int &cursor, T &sample) const
+        {
+            for (;;) {
+                unsigned int head = head_;
+
+                // Read the sample only after seeing the head that published it
+                __sync_synchronize();
+
+                if (cursor == head) {
+                    return false;
+                }
+                // The writer reuses the slot of the oldest sample for the next
+                if (head - cursor >= QMSENSORHUB_RING_SIZE) {
+                    cursor = head - QMSENSORHUB_RING_SIZE + 1;
+                }
+
+                sample = ring_[cursor & (QMSENSORHUB_RING_SIZE - 1)];
+
+                // Retry if the writer reused the slot while it was copied
+                __sync_synchronize();
+                if (head_ - cursor < QMSENSORHUB_RING_SIZE) {
+                    cursor++;
+                    return true;
+                }
+            }
+        }
+
+    private:
+        T ring_[QMSENSORHUB_RING_SIZE];
+        volatile unsigned int head_;
+    };
+
+} // MeeGo namespace
+
+#endif // QMSENSORRING_P_H
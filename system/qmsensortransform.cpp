@@ -0,0 +1,201 @@
+/*!
+ * @file qmsensortransform.cpp
+ * @brief QmSensorTransform
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmsensortransform_p.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace MeeGo {
+
+#if defined(__SSE2__) && !defined(__ARM_NEON__)
+
+static inline __m128i abs4(__m128i v)
+{
+    __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+static inline __m128i select4(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* C remainder of v / 360, with the sign of v */
+static inline __m128i mod360(__m128i v)
+{
+    // The float quotient is off by at most one, which the steps below fix
+    __m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 360)));
+    __m128i q360 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(q, 8), _mm_slli_epi32(q, 6)),
+                                 _mm_add_epi32(_mm_slli_epi32(q, 5), _mm_slli_epi32(q, 3)));
+    __m128i r = _mm_sub_epi32(v, q360);
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i negative = _mm_srai_epi32(v, 31);
+    __m128i up = select4(negative, _mm_cmplt_epi32(r, _mm_set1_epi32(-359)), _mm_cmplt_epi32(r, zero));
+    __m128i down = select4(negative, _mm_cmpgt_epi32(r, zero), _mm_cmpgt_epi32(r, _mm_set1_epi32(359)));
+    r = _mm_add_epi32(r, _mm_and_si128(up, _mm_set1_epi32(360)));
+    return _mm_sub_epi32(r, _mm_and_si128(down, _mm_set1_epi32(360)));
+}
+
+#define LOAD4(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE4(p, v) _mm_storeu_si128((__m128i*)(p), v)
+
+#endif
+
+void QmSensorTransform::remapAccelerometer(const int *x, const int *y, const int *z,
+                                           int *outX, int *outY, int *outZ, int count)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t vx = vld1q_s32(x + i);
+        int32x4_t vy = vld1q_s32(y + i);
+        int32x4_t vz = vld1q_s32(z + i);
+        vst1q_s32(outX + i, vnegq_s32(vy));
+        vst1q_s32(outY + i, vx);
+        vst1q_s32(outZ + i, vz);
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128i vx = LOAD4(x + i);
+        __m128i vy = LOAD4(y + i);
+        __m128i vz = LOAD4(z + i);
+        STORE4(outX + i, _mm_sub_epi32(_mm_setzero_si128(), vy));
+        STORE4(outY + i, vx);
+        STORE4(outZ + i, vz);
+    }
+#endif
+
+    for (; i < count; i++) {
+        int sx = x[i], sy = y[i];
+        outX[i] = -sy;
+        outY[i] = sx;
+        outZ[i] = z[i];
+    }
+}
+
+void QmSensorTransform::foldRotation(const int *x, const int *y, const int *z,
+                                     int *outX, int *outY, int *outZ, int count)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    const int32x4_t v90 = vdupq_n_s32(90);
+    const int32x4_t v180 = vdupq_n_s32(180);
+    const int32x4_t v360 = vdupq_n_s32(360);
+    const int32x4_t zero = vdupq_n_s32(0);
+
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t vx = vld1q_s32(x + i);
+        int32x4_t vy = vld1q_s32(y + i);
+        int32x4_t vz = vld1q_s32(z + i);
+        uint32x4_t folded = vcgtq_s32(vabsq_s32(vy), v90);
+
+        // x: -y, or y -/+ 180 beyond the half sphere
+        int32x4_t toward = vbslq_s32(vcltq_s32(vy, zero), v180, vnegq_s32(v180));
+        vst1q_s32(outX + i, vbslq_s32(folded, vaddq_s32(toward, vy), vnegq_s32(vy)));
+
+        // y: x, or +/-(180 - |x|) beyond the half sphere
+        int32x4_t rest = vsubq_s32(v180, vabsq_s32(vx));
+        int32x4_t mirrored = vbslq_s32(vcgtq_s32(vx, zero), rest, vnegq_s32(rest));
+        vst1q_s32(outY + i, vbslq_s32(folded, mirrored, vx));
+
+        // z: ((z + 270) % 360) - 180, with the quotient fixed as with SSE2
+        int32x4_t t = vaddq_s32(vz, vdupq_n_s32(270));
+        int32x4_t q = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(t), 1.0f / 360));
+        int32x4_t r = vsubq_s32(t, vmulq_n_s32(q, 360));
+        uint32x4_t negative = vcltq_s32(t, zero);
+        uint32x4_t up = vbslq_u32(negative, vcltq_s32(r, vdupq_n_s32(-359)), vcltq_s32(r, zero));
+        uint32x4_t down = vbslq_u32(negative, vcgtq_s32(r, zero), vcgtq_s32(r, vdupq_n_s32(359)));
+        r = vaddq_s32(r, vandq_s32(vreinterpretq_s32_u32(up), v360));
+        r = vsubq_s32(r, vandq_s32(vreinterpretq_s32_u32(down), v360));
+        vst1q_s32(outZ + i, vsubq_s32(r, v180));
+    }
+#elif defined(__SSE2__)
+    const __m128i v90 = _mm_set1_epi32(90);
+    const __m128i v180 = _mm_set1_epi32(180);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i vx = LOAD4(x + i);
+        __m128i vy = LOAD4(y + i);
+        __m128i vz = LOAD4(z + i);
+        __m128i folded = _mm_cmpgt_epi32(abs4(vy), v90);
+
+        // x: -y, or y -/+ 180 beyond the half sphere
+        __m128i toward = _mm_add_epi32(_mm_set1_epi32(-180),
+                                       _mm_and_si128(_mm_srai_epi32(vy, 31), _mm_set1_epi32(360)));
+        STORE4(outX + i, select4(folded, _mm_add_epi32(toward, vy), _mm_sub_epi32(zero, vy)));
+
+        // y: x, or +/-(180 - |x|) beyond the half sphere
+        __m128i rest = _mm_sub_epi32(v180, abs4(vx));
+        __m128i mirrored = select4(_mm_cmpgt_epi32(vx, zero), rest, _mm_sub_epi32(zero, rest));
+        STORE4(outY + i, select4(folded, mirrored, vx));
+
+        // z: ((z + 270) % 360) - 180
+        __m128i t = _mm_add_epi32(vz, _mm_set1_epi32(270));
+        STORE4(outZ + i, _mm_sub_epi32(mod360(t), v180));
+    }
+#endif
+
+    for (; i < count; i++) {
+        foldRotationSample(x[i], y[i], z[i], outX[i], outY[i], outZ[i]);
+    }
+}
+
+void QmSensorTransform::convert(const int *in, float *out, int count, float factor)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), factor));
+    }
+#elif defined(__SSE2__)
+    const __m128 vfactor = _mm_set1_ps(factor);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(LOAD4(in + i)), vfactor));
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = in[i] * factor;
+    }
+}
+
+const char *QmSensorTransform::implementation()
+{
+#if defined(__ARM_NEON__)
+    return "NEON";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "C++";
+#endif
+}
+
+} // namespace MeeGo
@@ -0,0 +1,122 @@
+/*!
+ * @file qmsensortransform_p.h
+ * @brief Contains QmSensorTransform
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMSENSORTRANSFORM_P_H
+#define QMSENSORTRANSFORM_P_H
+
+#include <QtGlobal>
+#include <stdlib.h>
+
+/* Samples transformed at a time */
+#define QMSENSOR_BLOCK_SIZE 64
+
+/* Unit conversions for QmSensorTransform::convert() */
+#define QMSENSOR_MG_TO_MS2 0.00980665f
+#define QMSENSOR_DEG_TO_RAD 0.017453292f
+
+namespace MeeGo
+{
+    /**
+     * XYZ samples stored one axis after another, the layout the
+     * transforms work on.
+     */
+    class QmXYZBlock
+    {
+    public:
+        QmXYZBlock() : count(0) {}
+
+        /**
+         * @return \c true when the block is full
+         */
+        bool append(quint64 t, int sx, int sy, int sz)
+        {
+            timestamp[count] = t;
+            x[count] = sx;
+            y[count] = sy;
+            z[count] = sz;
+            return ++count == QMSENSOR_BLOCK_SIZE;
+        }
+
+        quint64 timestamp[QMSENSOR_BLOCK_SIZE];
+        int x[QMSENSOR_BLOCK_SIZE];
+        int y[QMSENSOR_BLOCK_SIZE];
+        int z[QMSENSOR_BLOCK_SIZE];
+        int count;
+    };
+
+    /**
+     * Transforms from the sensord axes to the ones of QmSensor, for whole
+     * arrays of samples at a time. The transforms use SSE2 or NEON when the
+     * library is built for them, and plain C++ otherwise, with the same
+     * results. The input and output arrays may be the same arrays.
+     */
+    class QmSensorTransform
+    {
+    public:
+        /**
+         * Accelerometer axes: x = -y, y = x, z = z.
+         */
+        static void remapAccelerometer(const int *x, const int *y, const int *z,
+                                       int *outX, int *outY, int *outZ, int count);
+
+        /**
+         * Rotation angles, in degrees: folds x and y to the half sphere of
+         * the definition of QmRotation, and turns z = 0 to north. Exact for
+         * angles below 2^23.
+         */
+        static void foldRotation(const int *x, const int *y, const int *z,
+                                 int *outX, int *outY, int *outZ, int count);
+
+        /**
+         * Scales values by factor, e.g. #QMSENSOR_MG_TO_MS2.
+         */
+        static void convert(const int *in, float *out, int count, float factor);
+
+        /**
+         * #foldRotation() for a single sample.
+         */
+        static void foldRotationSample(int x, int y, int z, int &outX, int &outY, int &outZ)
+        {
+            // Mangle X and Y to definition...
+            if (abs(y) <= 90) {
+                outX = -y;
+                outY = x;
+            } else {
+                outX = (y < 0 ? 1 : -1) * 180 + y;
+                outY = (x > 0 ? 1 : -1) * (180 - abs(x));
+            }
+
+            // ..and finally match z=0 to north.
+            outZ = (((z + 180) + 90) % 360) - 180;
+        }
+
+        /**
+         * Name of the instruction set the transforms use.
+         */
+        static const char *implementation();
+    };
+
+} // MeeGo namespace
+
+#endif // QMSENSORTRANSFORM_P_H
@@ -7,6 +7,7 @@ DEFINES += SYSTEM_LIBRARY
 QT = core network dbus
 
 QMAKE_CXXFLAGS += -Wall -Wno-psabi
+LIBS += -lrt
 
 CONFIG += link_pkgconfig
 PKGCONFIG += dsme dsme_dbus_if libiphb
@@ -51,11 +52,15 @@ HEADERS += mainpage.h \
     qmdevicemode_p.h \
     qmdisplaystate.h \
     qmdisplaystate_p.h \
+    qmfusion.h \
+    qmfusion_p.h \
+    qmfusionfilter_p.h \
     qmheartbeat.h \
     qmheartbeat_p.h \
     qmipcinterface_p.h \
     qmkeys.h \
     qmkeys_p.h \
+    qmkeydprotocol_p.h \
     qmled.h \
     qmlocks.h \
     qmlocks_p.h \
@@ -69,6 +74,10 @@ HEADERS += mainpage.h \
     qmrotation_p.h \
     qmsensor.h \
     qmsensor_p.h \
+    qmsensorfilter_p.h \
+    qmsensorhub_p.h \
+    qmsensorring_p.h \
+    qmsensortransform_p.h \
     qmsysteminformation.h \
     qmsysteminformation_p.h \
     qmsystemstate.h \
@@ -92,6 +101,8 @@ SOURCES += qmactivity.cpp \
     qmcompass.cpp \
     qmdevicemode.cpp \
     qmdisplaystate.cpp \
+    qmfusion.cpp \
+    qmfusionfilter.cpp \
     qmheartbeat.cpp \
     qmipcinterface.cpp \
     qmkeys.cpp \
@@ -105,6 +116,9 @@ SOURCES += qmactivity.cpp \
     qmproximity.cpp \
     qmtime.cpp \
     qmsensor.cpp \
+    qmsensorfilter.cpp \
+    qmsensorhub.cpp \
+    qmsensortransform.cpp \
     qmrotation.cpp \
     qmmagnetometer.cpp \
     qmwatchdog.cpp \
@@ -35,10 +35,18 @@ class SignalDump : public QObject {
     Q_OBJECT
 
 public:
-    SignalDump(QObject *parent = NULL) : QObject(parent) {}
+    SignalDump(QObject *parent = NULL) : QObject(parent), samples(0), batches(0), largestBatch(0) {}
+
+    int samples;
+    int batches;
+    int largestBatch;
 
 public slots:
-    void receive(const MeeGo::QmAccelerometerReading&) {}
+    void receive(const MeeGo::QmAccelerometerReading&) { samples++; }
+    void receiveBatch(const QVector<MeeGo::QmAccelerometerReading>& data) {
+        batches++;
+        largestBatch = qMax(largestBatch, data.size());
+    }
 };
 
 class TestClass : public QObject
@@ -70,6 +78,84 @@ private slots:
         QVERIFY2(sensor->stop(), sensor->lastError().toLocal8Bit());
     }
 
+    void testBatching() {
+        QVERIFY(connect(sensor, SIGNAL(dataBatchAvailable(const QVector<MeeGo::QmAccelerometerReading>&)),
+                &signalDump, SLOT(receiveBatch(const QVector<MeeGo::QmAccelerometerReading>&))));
+
+        sensor->setBatching(10, 1000);
+        QCOMPARE(sensor->batchCount(), 10);
+        QCOMPARE(sensor->batchInterval(), 1000);
+
+        signalDump.samples = 0;
+        QVERIFY2(sensor->start(), sensor->lastError().toLocal8Bit());
+        QTest::qWait(2000);
+        QVERIFY2(sensor->stop(), sensor->lastError().toLocal8Bit());
+
+        // While batching the samples only arrive in batches
+        QCOMPARE(signalDump.samples, 0);
+        QVERIFY(signalDump.batches > 0);
+        QVERIFY(signalDump.largestBatch <= 10);
+
+        sensor->setBatching(0, 0);
+        QCOMPARE(sensor->batchCount(), 0);
+        QCOMPARE(sensor->batchInterval(), 0);
+    }
+
+    void testSharedSession() {
+        // A second accelerometer in the process shares the session
+        MeeGo::QmAccelerometer other;
+        SignalDump otherDump;
+        QVERIFY(connect(&other, SIGNAL(dataAvailable(const MeeGo::QmAccelerometerReading&)),
+                &otherDump, SLOT(receive(const MeeGo::QmAccelerometerReading&))));
+        QVERIFY2(other.requestSession(MeeGo::QmSensor::SessionTypeListen) != MeeGo::QmSensor::SessionTypeNone,
+                 other.lastError().toLocal8Bit());
+
+        signalDump.samples = 0;
+        QVERIFY2(sensor->start(), sensor->lastError().toLocal8Bit());
+        QVERIFY2(other.start(), other.lastError().toLocal8Bit());
+        QTest::qWait(1000);
+
+        QVERIFY(signalDump.samples > 0);
+        QVERIFY(otherDump.samples > 0);
+
+        // Stopping one of them leaves the sensor running for the other
+        QVERIFY2(other.stop(), other.lastError().toLocal8Bit());
+        signalDump.samples = otherDump.samples = 0;
+        QTest::qWait(1000);
+
+        QVERIFY(signalDump.samples > 0);
+        QCOMPARE(otherDump.samples, 0);
+
+        QVERIFY2(sensor->stop(), sensor->lastError().toLocal8Bit());
+    }
+
+    void testFilters() {
+        QCOMPARE(sensor->filterCount(), 0);
+
+        // Invalid parameters are refused
+        QVERIFY(!sensor->addFilter(MeeGo::QmSensor::FilterLowPass, 0));
+        QVERIFY(!sensor->addFilter(MeeGo::QmSensor::FilterHighPass, 1.5));
+        QVERIFY(!sensor->addFilter(MeeGo::QmSensor::FilterMedian, 4));
+        QVERIFY(!sensor->addFilter(MeeGo::QmSensor::FilterMedian, 17));
+        QCOMPARE(sensor->filterCount(), 0);
+
+        QVERIFY2(sensor->addFilter(MeeGo::QmSensor::FilterMedian, 5), sensor->lastError().toLocal8Bit());
+        QVERIFY2(sensor->addFilter(MeeGo::QmSensor::FilterLowPass, 0.2), sensor->lastError().toLocal8Bit());
+        QVERIFY2(sensor->addFilter(MeeGo::QmSensor::FilterHighPass, 0.1), sensor->lastError().toLocal8Bit());
+        QVERIFY2(sensor->addFilter(MeeGo::QmSensor::FilterLowPass, 0.5), sensor->lastError().toLocal8Bit());
+        QVERIFY(!sensor->addFilter(MeeGo::QmSensor::FilterLowPass, 0.5));
+        QCOMPARE(sensor->filterCount(), 4);
+
+        signalDump.samples = 0;
+        QVERIFY2(sensor->start(), sensor->lastError().toLocal8Bit());
+        QTest::qWait(1000);
+        QVERIFY2(sensor->stop(), sensor->lastError().toLocal8Bit());
+        QVERIFY(signalDump.samples > 0);
+
+        sensor->clearFilters();
+        QCOMPARE(sensor->filterCount(), 0);
+    }
+
     void cleanupTestCase() {
         delete sensor;
     }
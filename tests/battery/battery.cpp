@@ -33,9 +33,12 @@ class SignalDump : public QObject {
     Q_OBJECT
 
 public:
-    SignalDump(QObject *parent = NULL) : QObject(parent), batteryCurrentSignal(false) {}
+    SignalDump(QObject *parent = NULL) : QObject(parent), batteryCurrentSignal(false),
+        batteryMeasurementsSignals(0), batteryMeasurementsCount(0) {}
 
     bool batteryCurrentSignal;
+    int batteryMeasurementsSignals;
+    int batteryMeasurementsCount;
 
 public slots:
     void slotChargingStateChanged(MeeGo::QmBattery::ChargingState){}
@@ -43,6 +46,10 @@ public slots:
     void slotBatteryStateChanged(MeeGo::QmBattery::BatteryState){}
     void slotBatteryRemainingCapacityChanged(int, int){}
     void slotBatteryCurrent(int) { batteryCurrentSignal = true; }
+    void slotBatteryMeasurements(const QList<MeeGo::QmBatteryMeasurement> &measurements) {
+        batteryMeasurementsSignals++;
+        batteryMeasurementsCount += measurements.count();
+    }
     
     /* Depreciated */
     void slotBatteryEnergyLevelChanged(int){}
@@ -125,6 +132,16 @@ private slots:
         (void)result;
     }
 
+    void testGetSnapshot() {
+        MeeGo::QmBatterySnapshot snapshot = battery->getSnapshot();
+        QVERIFY(snapshot.valid);
+        QCOMPARE(snapshot.chargerType, battery->getChargerType());
+        QCOMPARE(snapshot.chargingState, battery->getChargingState());
+        QCOMPARE(snapshot.batteryCondition, battery->getBatteryCondition());
+        QCOMPARE(snapshot.nominalCapacity, battery->getNominalCapacity());
+        QCOMPARE(snapshot.maxBars, battery->getMaxBars());
+    }
+
     void testAverageTalkCurrentNormal() {
         int result = battery->getAverageTalkCurrent(MeeGo::QmBattery::NormalMode);
         (void)result;
@@ -185,6 +202,15 @@ private slots:
         (void)result;
     }
 
+    void testRemainingTimeEstimate() {
+        /* The first query calibrates the local estimate the second one uses */
+        int first = battery->getRemainingIdleTime(MeeGo::QmBattery::NormalMode);
+        int second = battery->getRemainingIdleTime(MeeGo::QmBattery::NormalMode);
+        if (first >= 0) {
+            QVERIFY(qAbs(second - first) <= first / 100 + 1);
+        }
+    }
+
     void testRemainingChargingTime() {
         int result = battery->getRemainingChargingTime();
         (void)result;
@@ -207,6 +233,41 @@ private slots:
         QVERIFY(!signalDump.batteryCurrentSignal);
     }
 
+    void testMeasurementHistory() {
+        QList<MeeGo::QmBatteryMeasurement> history = battery->getMeasurementHistory();
+        QVERIFY(!history.isEmpty());
+        QCOMPARE(battery->getMeasurementHistory(1).count(), 1);
+        for (int i = 1; i < history.count(); i++) {
+            QVERIFY(history[i - 1].timestamp <= history[i].timestamp);
+        }
+
+        MeeGo::QmBatteryMeasurementStats stats = battery->getMeasurementStats(60 * 1000);
+        QVERIFY(stats.count > 0 && stats.count <= history.count());
+        QVERIFY(stats.minCurrent <= stats.meanCurrent && stats.meanCurrent <= stats.maxCurrent);
+        QVERIFY(stats.minVoltage <= stats.meanVoltage && stats.meanVoltage <= stats.maxVoltage);
+    }
+
+    void testMeasurementDeliveryInterval() {
+        QVERIFY(connect(battery, SIGNAL(batteryMeasurements(const QList<MeeGo::QmBatteryMeasurement>&)),
+                &signalDump, SLOT(slotBatteryMeasurements(const QList<MeeGo::QmBatteryMeasurement>&))));
+        QVERIFY(!battery->setMeasurementDeliveryInterval(-1));
+        QVERIFY(battery->setMeasurementDeliveryInterval(1000));
+
+        signalDump.batteryCurrentSignal = false;
+        signalDump.batteryMeasurementsSignals = 0;
+        signalDump.batteryMeasurementsCount = 0;
+        QVERIFY(battery->startCurrentMeasurement(MeeGo::QmBattery::RATE_250ms));
+        QTest::qWait(3500);
+        QVERIFY(battery->stopCurrentMeasurement());
+
+        /* About four measurements a signal, and no per measurement signals */
+        QVERIFY(signalDump.batteryMeasurementsSignals > 0);
+        QVERIFY(signalDump.batteryMeasurementsCount > signalDump.batteryMeasurementsSignals);
+        QVERIFY(!signalDump.batteryCurrentSignal);
+
+        QVERIFY(battery->setMeasurementDeliveryInterval(0));
+    }
+
     void testStartCurrentMeasurementMs1000() {
         signalDump.batteryCurrentSignal = false;
         bool result = battery->startCurrentMeasurement(MeeGo::QmBattery::RATE_1000ms);
@@ -0,0 +1,319 @@
+/**
+ * @file battery_benchmark.cpp
+ * @brief QmBattery benchmark against the BME mock
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <QEventLoop>
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QtAlgorithms>
+#include <qmbattery.h>
+#include <QTest>
+
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+#include "bme/bmeipc.h"
+}
+
+#include "bme_mock.h"
+
+using namespace MeeGo;
+
+/*
+ * The benchmark runs QmBattery against the BME mock linked into it, so it
+ * needs no battery hardware, and measures the latency of the getters, the
+ * time from a BME event to the QmBattery signal, and the CPU time spent
+ * on the current measurements at each measurement rate, with and without
+ * a delivery interval. It is configured through the environment, as
+ * QTest owns the arguments:
+ *
+ *   BATTERY_BENCH_ITERATIONS  number of calls of each getter
+ *   BATTERY_BENCH_EVENTS      number of events sent for the event latency
+ *   BATTERY_BENCH_SECONDS     how long to measure at each rate
+ *   BATTERY_BENCH_SCRIPT      a BME mock script to play, see bme_mock.h
+ */
+
+static const int DEFAULT_ITERATIONS = 10000;
+static const int DEFAULT_EVENTS = 200;
+static const int DEFAULT_SECONDS = 10;
+
+/* Delivery interval of the batched measurements */
+static const int DELIVERY_INTERVAL_MS = 1000;
+
+/* Time allowed for a signal to arrive after its event */
+static const int EVENT_TIMEOUT_MS = 1000;
+
+static int envValue(const char *name, int defaultValue)
+{
+    QByteArray value = qgetenv(name);
+    bool ok = false;
+    int result = value.toInt(&ok);
+    return (ok && result >= 0) ? result : defaultValue;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* CPU time of the calling thread, which runs QmBattery */
+static double threadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void printLatencies(const char *what, QVector<double> latencies)
+{
+    if (latencies.isEmpty()) {
+        return;
+    }
+    qSort(latencies.begin(), latencies.end());
+    int n = latencies.size();
+    printf("%s: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", what,
+           latencies.at(n / 2) * 1000,
+           latencies.at(qMin(n - 1, n * 99 / 100)) * 1000,
+           latencies.last() * 1000);
+}
+
+class ScriptPlayer : public QThread
+{
+public:
+    ScriptPlayer(const QByteArray &path) : path(path), result(-1) {}
+
+    QByteArray path;
+    int result;
+
+protected:
+    void run() {
+        result = bme_mock_play_script(path.constData());
+    }
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    QmBattery *battery;
+    QEventLoop *waiting;
+    int signalCount;
+    int measurementCount;
+
+public slots:
+    void remainingCapacityChanged(int, int) {
+        signalCount++;
+        if (waiting) {
+            waiting->quit();
+        }
+    }
+
+    void batteryCurrent(int) {
+        signalCount++;
+        measurementCount++;
+    }
+
+    void batteryMeasurements(const QList<MeeGo::QmBatteryMeasurement> &list) {
+        signalCount++;
+        measurementCount += list.count();
+    }
+
+private:
+    void measureRate(QmBattery::Period rate, const char *name, int interval) {
+        int seconds = qMax(envValue("BATTERY_BENCH_SECONDS", DEFAULT_SECONDS), 1);
+
+        QVERIFY(battery->setMeasurementDeliveryInterval(interval));
+        signalCount = measurementCount = 0;
+        int dropped = bme_mock_dropped_measurements();
+
+        double cpu = threadCpuTime();
+        QVERIFY(battery->startCurrentMeasurement(rate));
+        QTest::qWait(seconds * 1000);
+        QVERIFY(battery->stopCurrentMeasurement());
+        cpu = threadCpuTime() - cpu;
+
+        dropped = bme_mock_dropped_measurements() - dropped;
+        printf("%s, delivery interval %d ms: %d measurements in %d signals, "
+               "%.1f us of CPU per measurement, %d dropped\n",
+               name, interval, measurementCount, signalCount,
+               measurementCount ? cpu * 1e6 / measurementCount : 0.0, dropped);
+
+        QVERIFY(measurementCount > 0);
+    }
+
+private slots:
+    void initTestCase() {
+        waiting = 0;
+        battery = new QmBattery();
+        QVERIFY(battery);
+        QVERIFY(connect(battery, SIGNAL(batteryRemainingCapacityChanged(int, int)),
+                        this, SLOT(remainingCapacityChanged(int, int))));
+        QVERIFY(connect(battery, SIGNAL(batteryCurrent(int)),
+                        this, SLOT(batteryCurrent(int))));
+        QVERIFY(connect(battery, SIGNAL(batteryMeasurements(const QList<MeeGo::QmBatteryMeasurement>&)),
+                        this, SLOT(batteryMeasurements(const QList<MeeGo::QmBatteryMeasurement>&))));
+    }
+
+    void testGetterLatency() {
+        int iterations = qMax(envValue("BATTERY_BENCH_ITERATIONS", DEFAULT_ITERATIONS), 1);
+        volatile int sink = 0;
+
+        int queries = bme_mock_queries();
+        double start = now();
+        for (int i = 0; i < iterations; i++) {
+            sink += battery->getNominalCapacity();
+            sink += battery->getBatteryState();
+            sink += battery->getRemainingCapacitymAh();
+            sink += battery->getRemainingCapacityPct();
+            sink += battery->getRemainingCapacityBars();
+            sink += battery->getMaxBars();
+            sink += battery->getVoltage();
+            sink += battery->getBatteryCurrent();
+            sink += battery->getChargerType();
+            sink += battery->getChargingState();
+        }
+        double elapsed = now() - start;
+        printf("Getters: %.3f us per call, %.4f BME queries per call\n",
+               elapsed * 1e6 / (iterations * 10),
+               (double)(bme_mock_queries() - queries) / (iterations * 10));
+
+        queries = bme_mock_queries();
+        start = now();
+        for (int i = 0; i < iterations; i++) {
+            QmBatterySnapshot snapshot = battery->getSnapshot();
+            sink += snapshot.voltage;
+        }
+        elapsed = now() - start;
+        printf("getSnapshot: %.3f us per call, %.4f BME queries per call\n",
+               elapsed * 1e6 / iterations,
+               (double)(bme_mock_queries() - queries) / iterations);
+
+        queries = bme_mock_queries();
+        start = now();
+        for (int i = 0; i < iterations / 10 + 1; i++) {
+            sink += battery->getRemainingTalkTime(QmBattery::NormalMode);
+            sink += battery->getRemainingActiveTime(QmBattery::NormalMode);
+            sink += battery->getRemainingIdleTime(QmBattery::NormalMode);
+        }
+        elapsed = now() - start;
+        printf("Remaining times: %.3f us per call, %.4f BME queries per call\n",
+               elapsed * 1e6 / ((iterations / 10 + 1) * 3),
+               (double)(bme_mock_queries() - queries) / ((iterations / 10 + 1) * 3));
+    }
+
+    void testEventLatency() {
+        int count = qMax(envValue("BATTERY_BENCH_EVENTS", DEFAULT_EVENTS), 1);
+        QVector<double> latencies;
+        QEventLoop loop;
+        QTimer timeout;
+        int lost = 0;
+
+        timeout.setSingleShot(true);
+        connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+        waiting = &loop;
+
+        int queries = bme_mock_queries();
+        for (int i = 0; i < count; i++) {
+            signalCount = 0;
+            bme_mock_set_stat(BATTERY_LEVEL_PCT, 10 + i % 80);
+
+            double start = now();
+            bme_mock_send_event(BMEVENT_BATMON);
+            timeout.start(EVENT_TIMEOUT_MS);
+            loop.exec();
+            timeout.stop();
+
+            if (signalCount) {
+                latencies.append(now() - start);
+            } else {
+                lost++;
+            }
+        }
+        waiting = 0;
+
+        printLatencies("Event to signal latency", latencies);
+        printf("%.2f BME queries per event\n",
+               (double)(bme_mock_queries() - queries) / count);
+        if (lost) {
+            printf("%d events were not signaled\n", lost);
+        }
+
+        QCOMPARE(lost, 0);
+    }
+
+    void testMeasurement250ms() {
+        measureRate(QmBattery::RATE_250ms, "250 ms", 0);
+        measureRate(QmBattery::RATE_250ms, "250 ms", DELIVERY_INTERVAL_MS);
+    }
+
+    void testMeasurement1000ms() {
+        measureRate(QmBattery::RATE_1000ms, "1000 ms", 0);
+        measureRate(QmBattery::RATE_1000ms, "1000 ms", DELIVERY_INTERVAL_MS);
+    }
+
+    void testMeasurement5000ms() {
+        measureRate(QmBattery::RATE_5000ms, "5000 ms", 0);
+        measureRate(QmBattery::RATE_5000ms, "5000 ms", DELIVERY_INTERVAL_MS);
+        QVERIFY(battery->setMeasurementDeliveryInterval(0));
+    }
+
+    /* Plays BATTERY_BENCH_SCRIPT while measuring at the fastest rate */
+    void testScript() {
+        QByteArray path = qgetenv("BATTERY_BENCH_SCRIPT");
+
+        if (path.isEmpty()) {
+            printf("BATTERY_BENCH_SCRIPT is not set, nothing to play\n");
+            return;
+        }
+
+        signalCount = measurementCount = 0;
+        double cpu = threadCpuTime();
+        double start = now();
+        QVERIFY(battery->startCurrentMeasurement(QmBattery::RATE_250ms));
+
+        ScriptPlayer player(path);
+        player.start();
+        while (!player.isFinished()) {
+            QTest::qWait(10);
+        }
+
+        QVERIFY(battery->stopCurrentMeasurement());
+        printf("Played %s in %.3f s: %d signals, %d measurements, %.1f ms of CPU\n",
+               path.constData(), now() - start, signalCount, measurementCount,
+               (threadCpuTime() - cpu) * 1000);
+
+        QCOMPARE(player.result, 0);
+    }
+
+    void cleanupTestCase() {
+        delete battery;
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "battery_benchmark.moc"
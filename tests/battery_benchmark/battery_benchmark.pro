@@ -0,0 +1,13 @@
+QT -= gui
+
+TARGET = battery-benchmark-test
+SOURCES += battery_benchmark.cpp
+
+INCLUDEPATH += ../bme_mock
+LIBS += -L../bme_mock -lbme-mock -lrt -lpthread -ldl
+PRE_TARGETDEPS += ../bme_mock/libbme-mock.a
+QMAKE_LFLAGS += -rdynamic
+CONFIG += link_pkgconfig
+PKGCONFIG += bmeipc
+
+include(../common-install.pri)
@@ -0,0 +1,520 @@
+/**
+ * @file bme_mock.cpp
+ * @brief A stand-in for the BME server
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "bme_mock.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+extern "C" {
+#include "bme/bmeipc.h"
+#include "bme/bmemsg.h"
+#include "bme/em_isi.h"
+}
+
+/* Size of the measurement queue, as BME creates it */
+#define MEASUREMENT_QUEUE_SIZE 10
+
+/* An event connection, the client has the other end of the socket pair */
+struct EventConnection
+{
+    int clientFd;
+    int serverFd;
+    int mask;
+};
+
+#define MAX_EVENT_CONNECTIONS 16
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static bmestat_t stats;
+#define STAT_COUNT ((int)(sizeof(stats) / sizeof(stats[0])))
+
+static int measuredCurrent = -150;      /* mA */
+static int measuredVoltage = 3900;      /* mV */
+static int measuredTemperature = 300;   /* K */
+
+static EventConnection eventConnections[MAX_EVENT_CONNECTIONS];
+static int eventConnectionCount = 0;
+
+static char queueName[32];
+static mqd_t measurementQueue = (mqd_t)-1;
+static bool createdQueue = false;
+static pthread_t measurementThread;
+static bool measuring = false;
+static int measurementPeriodMs = 0;
+
+static int queries = 0;
+static int dropped = 0;
+
+static void removeQueue()
+{
+    if (createdQueue) {
+        mq_unlink(queueName);
+    }
+}
+
+/* A battery that is not charging, at two thirds */
+static void init()
+{
+    memset(&stats, 0, sizeof(stats));
+    stats[BATTERY_STATE] = BATTERY_STATE_OK;
+    stats[BATTERY_CAPA_MAX] = 1200;
+    stats[BATTERY_CAPA_NOW] = 800;
+    stats[BATTERY_LEVEL_PCT] = 66;
+    stats[BATTERY_LEVEL_NOW] = 5;
+    stats[BATTERY_LEVEL_MAX] = 8;
+    stats[BATTERY_VOLT_NOW] = 3900;
+    stats[BATTERY_CURRENT] = -150;
+    stats[CHARGER_TYPE] = CHARGER_TYPE_NONE;
+    stats[CHARGING_STATE] = CHARGING_STATE_STOPPED;
+    stats[BATTERY_CONDITION] = BATTERY_CONDITION_GOOD;
+
+    /* The queue exists before anyone asks for measurements, as with BME.
+       It is a queue of the process, never the one of a BME running on
+       the device, whose clients would read the mock measurements. */
+    struct mq_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = MEASUREMENT_QUEUE_SIZE;
+    attr.mq_msgsize = sizeof(bmeipc_meas_t);
+
+    snprintf(queueName, sizeof(queueName), "/bme-mock-%d", (int)getpid());
+    measurementQueue = mq_open(queueName, O_WRONLY | O_NONBLOCK | O_CREAT | O_EXCL, 0600, &attr);
+    if (measurementQueue != (mqd_t)-1) {
+        createdQueue = true;
+        atexit(removeQueue);
+    } else {
+        fprintf(stderr, "bme_mock: %s: %s\n", queueName, strerror(errno));
+    }
+}
+
+static int periodMs(unsigned int period)
+{
+    switch (period) {
+    case EM_MEASUREMENT_PERIOD_250MS:
+        return 250;
+    case EM_MEASUREMENT_PERIOD_1S:
+        return 1000;
+    case EM_MEASUREMENT_PERIOD_5S:
+    default:
+        return 5000;
+    }
+}
+
+static void *measure(void *)
+{
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        bool running = measuring;
+        int period = measurementPeriodMs;
+        bmeipc_meas_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.state = MEASUREMENTS_ON;
+        msg.bat_current = measuredCurrent;
+        msg.bat_voltage = measuredVoltage;
+        msg.bat_temp = measuredTemperature;
+        pthread_mutex_unlock(&lock);
+
+        if (!running) {
+            return 0;
+        }
+
+        gettimeofday(&msg.timestamp, 0);
+        if (mq_send(measurementQueue, (const char *)&msg, sizeof(msg), 0) == -1) {
+            __sync_fetch_and_add(&dropped, 1);
+        }
+
+        next.tv_nsec += (long)period * 1000000;
+        next.tv_sec += next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0) == EINTR) {
+        }
+    }
+}
+
+static void startMeasurements(int period)
+{
+    pthread_mutex_lock(&lock);
+    measurementPeriodMs = period;
+    bool start = !measuring;
+    measuring = true;
+    pthread_mutex_unlock(&lock);
+
+    if (start && pthread_create(&measurementThread, 0, measure, 0) != 0) {
+        pthread_mutex_lock(&lock);
+        measuring = false;
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+static void stopMeasurements()
+{
+    pthread_mutex_lock(&lock);
+    bool stop = measuring;
+    measuring = false;
+    pthread_mutex_unlock(&lock);
+
+    if (stop) {
+        pthread_join(measurementThread, 0);
+    }
+}
+
+/* Serves the queries of one bmeipc_open() connection until it is closed */
+static void *serve(void *arg)
+{
+    int fd = (long)arg;
+    char buf[512];
+    int elements = 0;   /* measurement request elements still to come */
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        __sync_fetch_and_add(&queries, 1);
+
+        if (elements > 0) {
+            const struct emsg_measurement_req_elem *elem = (const struct emsg_measurement_req_elem *)buf;
+            if (elem->type == EM_MEASUREMENT_TYPE_CURRENT) {
+                startMeasurements(periodMs(elem->period));
+            }
+            elements--;
+            continue;
+        }
+
+        const bmeipc_msg_t *msg = (const bmeipc_msg_t *)buf;
+
+        if (msg->type == BME_SYSMSG_GETSTAT) {
+            bmestat_t reply;
+            pthread_mutex_lock(&lock);
+            memcpy(&reply, &stats, sizeof(reply));
+            pthread_mutex_unlock(&lock);
+            send(fd, &reply, sizeof(reply), 0);
+        } else if (msg->type == EM_MEASUREMENT_REQ) {
+            const struct emsg_measurement_req *req = (const struct emsg_measurement_req *)buf;
+            if (req->measurement_action == EM_MEASUREMENT_ACTION_START) {
+                elements = req->channel_count;
+            } else {
+                stopMeasurements();
+            }
+        } else if (msg->type == EM_BATTERY_USETIME_REQ) {
+            union emsg_usetime_info info;
+            memset(&info, 0, sizeof(info));
+            memcpy(&info, buf, (size_t)n < sizeof(info.request) ? (size_t)n : sizeof(info.request));
+            int current = info.request.current;
+
+            pthread_mutex_lock(&lock);
+            int capacity = stats[BATTERY_CAPA_NOW];
+            pthread_mutex_unlock(&lock);
+
+            memset(&info, 0, sizeof(info));
+            info.reply.time = current > 0 ? capacity * 3600 / current : -1;
+            send(fd, &info, sizeof(info.reply), 0);
+        } else {
+            /* Unknown requests get an empty answer, which fails the query */
+            send(fd, buf, 0, 0);
+        }
+    }
+
+    close(fd);
+    return 0;
+}
+
+static void sendEvents(int events)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < eventConnectionCount; i++) {
+        if (eventConnections[i].mask & events) {
+            send(eventConnections[i].serverFd, &events, sizeof(events), MSG_DONTWAIT);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*------------ bmeipc client functions ------------*/
+
+extern "C" {
+
+/* The measurement queue of BME is opened by name, which is the queue of
+   the mock in this process */
+mqd_t mq_open(const char *name, int oflag, ...) __THROW
+{
+    typedef mqd_t (*MqOpen)(const char *, int, ...);
+    static MqOpen realMqOpen = 0;
+    mode_t mode = 0;
+    struct mq_attr *attr = 0;
+
+    if (!realMqOpen) {
+        realMqOpen = (MqOpen)dlsym(RTLD_NEXT, "mq_open");
+        if (!realMqOpen) {
+            errno = ENOSYS;
+            return (mqd_t)-1;
+        }
+    }
+
+    if (oflag & O_CREAT) {
+        va_list args;
+        va_start(args, oflag);
+        mode = (mode_t)va_arg(args, unsigned int);
+        attr = va_arg(args, struct mq_attr *);
+        va_end(args);
+    }
+
+    if (!strcmp(name, BMEIPC_MQNAME)) {
+        pthread_once(&once, init);
+        if (!createdQueue) {
+            errno = ENOENT;
+            return (mqd_t)-1;
+        }
+        name = queueName;
+    }
+
+    return (oflag & O_CREAT) ? realMqOpen(name, oflag, mode, attr) : realMqOpen(name, oflag);
+}
+
+int bmeipc_open(void)
+{
+    int fds[2];
+    pthread_t thread;
+
+    pthread_once(&once, init);
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1) {
+        return -1;
+    }
+    if (pthread_create(&thread, 0, serve, (void *)(long)fds[1]) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        errno = EAGAIN;
+        return -1;
+    }
+    pthread_detach(thread);
+    return fds[0];
+}
+
+void bmeipc_close(int sd)
+{
+    close(sd);
+}
+
+int bmeipc_query(int sd, const void *msg, int len, void *reply, int replylen)
+{
+    if (send(sd, msg, len, 0) != len) {
+        return -1;
+    }
+    if (!reply || replylen <= 0) {
+        return 0;
+    }
+
+    ssize_t n = recv(sd, reply, replylen, 0);
+    if (n <= 0) {
+        errno = n == 0 ? EPROTO : errno;
+        return -1;
+    }
+    return n;
+}
+
+int bmeipc_eopen(int mask)
+{
+    int fds[2];
+
+    pthread_once(&once, init);
+
+    pthread_mutex_lock(&lock);
+    if (eventConnectionCount == MAX_EVENT_CONNECTIONS) {
+        pthread_mutex_unlock(&lock);
+        errno = EMFILE;
+        return -1;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    EventConnection &connection = eventConnections[eventConnectionCount++];
+    connection.clientFd = fds[0];
+    connection.serverFd = fds[1];
+    connection.mask = mask;
+    pthread_mutex_unlock(&lock);
+
+    return fds[0];
+}
+
+void bmeipc_eclose(int sd)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < eventConnectionCount; i++) {
+        if (eventConnections[i].clientFd == sd) {
+            close(eventConnections[i].serverFd);
+            eventConnections[i] = eventConnections[--eventConnectionCount];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    close(sd);
+}
+
+int bmeipc_eread(int sd)
+{
+    int events;
+
+    if (recv(sd, &events, sizeof(events), 0) != sizeof(events)) {
+        return BMEVENT_ERROR;
+    }
+    return events;
+}
+
+/*------------ control functions ------------*/
+
+void bme_mock_set_stat(int index, int value)
+{
+    pthread_once(&once, init);
+
+    if (index >= 0 && index < STAT_COUNT) {
+        pthread_mutex_lock(&lock);
+        stats[index] = value;
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+int bme_mock_stat(int index)
+{
+    int value = 0;
+
+    pthread_once(&once, init);
+
+    if (index >= 0 && index < STAT_COUNT) {
+        pthread_mutex_lock(&lock);
+        value = stats[index];
+        pthread_mutex_unlock(&lock);
+    }
+    return value;
+}
+
+void bme_mock_send_event(int events)
+{
+    pthread_once(&once, init);
+    sendEvents(events);
+}
+
+void bme_mock_set_measurement(int current, int voltage, int temperature)
+{
+    pthread_mutex_lock(&lock);
+    measuredCurrent = current;
+    measuredVoltage = voltage;
+    measuredTemperature = temperature;
+    pthread_mutex_unlock(&lock);
+}
+
+int bme_mock_play_script(const char *path)
+{
+    char line[256];
+    int lineNumber = 0;
+
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        char command[32], name[32];
+        int a, b, c;
+
+        lineNumber++;
+
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') {
+            continue;
+        }
+
+        bool ok = false;
+        if (sscanf(start, "%31s", command) == 1) {
+            if (!strcmp(command, "stat")) {
+                ok = sscanf(start, "%*s %d %d", &a, &b) == 2 && a >= 0 && a < STAT_COUNT;
+                if (ok) {
+                    bme_mock_set_stat(a, b);
+                }
+            } else if (!strcmp(command, "event")) {
+                ok = sscanf(start, "%*s %31s", name) == 1;
+                if (!strcmp(name, "charger")) {
+                    a = BMEVENT_CHARGER;
+                } else if (!strcmp(name, "charge")) {
+                    a = BMEVENT_CHARGE;
+                } else if (!strcmp(name, "batmon")) {
+                    a = BMEVENT_BATMON;
+                } else {
+                    ok = ok && sscanf(name, "%i", &a) == 1;
+                }
+                if (ok) {
+                    bme_mock_send_event(a);
+                }
+            } else if (!strcmp(command, "measurement")) {
+                ok = sscanf(start, "%*s %d %d %d", &a, &b, &c) == 3;
+                if (ok) {
+                    bme_mock_set_measurement(a, b, c);
+                }
+            } else if (!strcmp(command, "wait")) {
+                ok = sscanf(start, "%*s %d", &a) == 1 && a >= 0;
+                if (ok) {
+                    usleep(a * 1000);
+                }
+            }
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s:%d: invalid command\n", path, lineNumber);
+            fclose(in);
+            return -1;
+        }
+    }
+
+    fclose(in);
+    return 0;
+}
+
+int bme_mock_queries(void)
+{
+    return queries;
+}
+
+int bme_mock_dropped_measurements(void)
+{
+    return dropped;
+}
+
+} // extern "C"
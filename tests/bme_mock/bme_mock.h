@@ -0,0 +1,68 @@
+/**
+ * @file bme_mock.h
+ * @brief A stand-in for the BME server
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef BME_MOCK_H
+#define BME_MOCK_H
+
+/*
+ * The mock is not a BME server but a static library that defines the
+ * bmeipc client functions, so that in a program linked with it QmBattery
+ * talks to the mock instead of BME. The mock serves the queries from a
+ * thread of its own over sockets, sends the events over sockets and the
+ * current measurements through a message queue, like BME does, so that
+ * the whole QmBattery path from the socket notifiers to the signals is
+ * used. The queue is a queue of the process, which the mock opens in
+ * place of the BME measurement queue, so a BME running on the device is
+ * left alone. Link the program with -rdynamic -ldl so that libqmsystem2
+ * finds the mock.
+ *
+ * The statistics, events and measurements are set through the functions
+ * below or played from a script, a text file with one command per line:
+ *
+ *     stat <index> <value>        set a bmestat_t statistic
+ *     event <mask>                send BMEVENT_* events, or charger,
+ *                                 charge or batmon
+ *     measurement <mA> <mV> <K>   set what the measurements report
+ *     wait <ms>                   sleep before the next command
+ *
+ * Lines starting with # are comments.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void bme_mock_set_stat(int index, int value);
+int bme_mock_stat(int index);
+void bme_mock_send_event(int events);
+void bme_mock_set_measurement(int current, int voltage, int temperature);
+int bme_mock_play_script(const char *path);
+
+/* Number of queries served, and measurements BME would have dropped */
+int bme_mock_queries(void);
+int bme_mock_dropped_measurements(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BME_MOCK_H
@@ -0,0 +1,8 @@
+TEMPLATE = lib
+CONFIG += staticlib link_pkgconfig
+CONFIG -= qt
+
+TARGET = bme-mock
+HEADERS += bme_mock.h
+SOURCES += bme_mock.cpp
+PKGCONFIG += bmeipc
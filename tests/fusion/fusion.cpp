@@ -0,0 +1,118 @@
+/**
+ * @file fusion.cpp
+ * @brief QmFusion tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QObject>
+#include <qmfusion.h>
+#include <qmaccelerometer.h>
+#include <QTest>
+
+#include <math.h>
+
+using namespace MeeGo;
+
+class SignalDump : public QObject {
+    Q_OBJECT
+
+public:
+    SignalDump(QObject *parent = NULL) : QObject(parent), readings(0), unitQuaternions(true) {}
+
+    int readings;
+    bool unitQuaternions;
+    MeeGo::QmFusionReading last;
+
+public slots:
+    void receive(const MeeGo::QmFusionReading& data) {
+        readings++;
+        qreal norm = sqrt(data.w * data.w + data.x * data.x + data.y * data.y + data.z * data.z);
+        if (fabs(norm - 1) > 1e-3) {
+            unitQuaternions = false;
+        }
+        last = data;
+    }
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    MeeGo::QmFusion *fusion;
+    SignalDump signalDump;
+
+private slots:
+    void initTestCase() {
+        fusion = new MeeGo::QmFusion();
+        QVERIFY(fusion);
+    }
+
+    void testConnectSignals() {
+        QVERIFY(connect(fusion, SIGNAL(dataAvailable(const MeeGo::QmFusionReading&)),
+                &signalDump, SLOT(receive(const MeeGo::QmFusionReading&))));
+    }
+
+    void testGain() {
+        QVERIFY(!fusion->setGain(0));
+        QVERIFY(!fusion->setGain(1.5));
+        QVERIFY(fusion->setGain(0.5));
+        QCOMPARE(fusion->gain(), (qreal)0.5);
+        QVERIFY(fusion->setGain(0.1));
+    }
+
+    void testStartStop() {
+        QVERIFY2(fusion->start(), fusion->lastError().toLocal8Bit());
+        QVERIFY(fusion->isRunning());
+        QTest::qWait(2000);
+        QVERIFY2(fusion->stop(), fusion->lastError().toLocal8Bit());
+        QVERIFY(!fusion->isRunning());
+
+        QVERIFY(signalDump.readings > 0);
+        QVERIFY(signalDump.unitQuaternions);
+        QVERIFY(signalDump.last.heading >= 0 && signalDump.last.heading < 360);
+        QVERIFY(signalDump.last.pitch >= -90 && signalDump.last.pitch <= 90);
+        QVERIFY(signalDump.last.roll >= -180 && signalDump.last.roll <= 180);
+        QCOMPARE(fusion->reading().timestamp, signalDump.last.timestamp);
+    }
+
+    void testSharedAccelerometer() {
+        // The fusion reads the same samples as an accelerometer of the process
+        MeeGo::QmAccelerometer accelerometer;
+        QVERIFY2(accelerometer.requestSession(MeeGo::QmSensor::SessionTypeListen) != MeeGo::QmSensor::SessionTypeNone,
+                 accelerometer.lastError().toLocal8Bit());
+        QVERIFY2(accelerometer.start(), accelerometer.lastError().toLocal8Bit());
+
+        signalDump.readings = 0;
+        QVERIFY2(fusion->start(), fusion->lastError().toLocal8Bit());
+        QTest::qWait(1000);
+        QVERIFY2(fusion->stop(), fusion->lastError().toLocal8Bit());
+        QVERIFY(signalDump.readings > 0);
+
+        QVERIFY2(accelerometer.stop(), accelerometer.lastError().toLocal8Bit());
+    }
+
+    void cleanupTestCase() {
+        delete fusion;
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "fusion.moc"
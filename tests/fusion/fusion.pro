@@ -0,0 +1,6 @@
+QT += dbus
+QT -= gui
+SOURCES += fusion.cpp
+
+TARGET = fusion-test
+include(../common-install.pri)
@@ -0,0 +1,147 @@
+/**
+ * @file fusionfilter.cpp
+ * @brief QmFusionFilter tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QObject>
+#include <QTest>
+
+#include "qmfusionfilter_p.h"
+
+#include <math.h>
+
+using namespace MeeGo;
+
+/* Magnetic field pointing north and down, as in the northern hemisphere */
+#define FIELD_NORTH 200
+#define FIELD_DOWN -400
+
+/* Degrees the synthetic samples may be off after rounding to integers */
+#define TOLERANCE 1.0
+
+/*
+ * Feeds the filter the samples of a device held still in known
+ * orientations. Accelerations are in the axes of QmAccelerometer, and the
+ * fields in the ones of QmMagnetometer, where x is the y of the
+ * accelerometer and y is its -x.
+ */
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    static bool near(qreal value, qreal expected) {
+        qreal diff = fabs(value - expected);
+        return diff <= TOLERANCE || fabs(diff - 360) <= TOLERANCE;
+    }
+
+private slots:
+    void testNoField() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        QVERIFY(!filter.update(0, 0, -1000, reading));
+    }
+
+    /* Free fall tells nothing of the orientation */
+    void testFreeFall() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setField(FIELD_NORTH, 0, FIELD_DOWN);
+        QVERIFY(!filter.update(0, 0, 0, reading));
+    }
+
+    /* Flat on the table, facing north: the identity */
+    void testFlatNorth() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setField(FIELD_NORTH, 0, FIELD_DOWN);
+        QVERIFY(filter.update(0, 0, -1000, reading));
+
+        QVERIFY(fabs(reading.w - 1) < 1e-6);
+        QVERIFY(fabs(reading.x) < 1e-6);
+        QVERIFY(fabs(reading.y) < 1e-6);
+        QVERIFY(fabs(reading.z) < 1e-6);
+        QVERIFY(near(reading.heading, 0));
+        QVERIFY(near(reading.pitch, 0));
+        QVERIFY(near(reading.roll, 0));
+    }
+
+    /* Flat, turned right to face east, so that north is along -x */
+    void testFlatEast() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setField(0, FIELD_NORTH, FIELD_DOWN);
+        QVERIFY(filter.update(0, 0, -1000, reading));
+
+        QVERIFY(near(reading.heading, 90));
+        QVERIFY(near(reading.pitch, 0));
+        QVERIFY(near(reading.roll, 0));
+    }
+
+    /* Facing north with the top raised by 30 degrees */
+    void testPitch() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setField(-27, 0, -446);
+        QVERIFY(filter.update(0, -500, -866, reading));
+
+        QVERIFY(near(reading.heading, 0));
+        QVERIFY(near(reading.pitch, 30));
+        QVERIFY(near(reading.roll, 0));
+    }
+
+    /* Facing north, rolled right by 30 degrees */
+    void testRoll() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setField(200, -200, -346);
+        QVERIFY(filter.update(500, 0, -866, reading));
+
+        QVERIFY(near(reading.heading, 0));
+        QVERIFY(near(reading.pitch, 0));
+        QVERIFY(near(reading.roll, 30));
+    }
+
+    /* Each sample moves the orientation by the gain of the way to it */
+    void testGain() {
+        QmFusionFilter filter;
+        QmFusionReading reading;
+        filter.setGain(0.5);
+
+        filter.setField(FIELD_NORTH, 0, FIELD_DOWN);
+        QVERIFY(filter.update(0, 0, -1000, reading));
+        QVERIFY(near(reading.heading, 0));
+
+        filter.setField(0, FIELD_NORTH, FIELD_DOWN);
+        QVERIFY(filter.update(0, 0, -1000, reading));
+        QVERIFY(near(reading.heading, 45));
+
+        // After a reset the first sample is taken as it is
+        filter.reset();
+        QVERIFY(!filter.update(0, 0, -1000, reading));
+        filter.setField(0, FIELD_NORTH, FIELD_DOWN);
+        QVERIFY(filter.update(0, 0, -1000, reading));
+        QVERIFY(near(reading.heading, 90));
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "fusionfilter.moc"
@@ -0,0 +1,9 @@
+QT -= gui
+
+TARGET = fusionfilter-test
+HEADERS += ../../system/qmfusionfilter_p.h
+SOURCES += fusionfilter.cpp \
+    ../../system/qmfusionfilter.cpp \
+    ../../system/qmsensortransform.cpp
+
+include(../common-install.pri)
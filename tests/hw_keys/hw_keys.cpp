@@ -27,14 +27,41 @@
 #include <QObject>
 #include <qmkeys.h>
 #include <QTest>
+#include <QTime>
+
+#include <linux/input.h>
+
+#include "keydtest.h"
 
 using namespace MeeGo;
 
+/* How long to wait for key events to arrive */
+static const int EVENT_TIMEOUT_MS = 2000;
+
 class SignalDump : public QObject {
     Q_OBJECT
 
 public:
-    SignalDump(QObject *parent = NULL) : QObject(parent) {}
+    SignalDump(QObject *parent = NULL) : QObject(parent), lastRequest(0), states(0), repeats(0) {}
+
+    int lastRequest;
+    int states;
+    QList<MeeGo::QmKeys::Key> keys;
+    QList<MeeGo::QmKeys::State> keyStates;
+    int repeats;
+
+    /* Waits until count key events have arrived in all */
+    void waitForKeys(int count) {
+        for (int waited = 0; keys.size() < count && waited < EVENT_TIMEOUT_MS; waited += 10) {
+            QTest::qWait(10);
+        }
+    }
+
+    void clear() {
+        keys.clear();
+        keyStates.clear();
+        repeats = 0;
+    }
 
 public slots:
     void cameraLauncherMoved(QmKeys::CameraKeyPosition){}
@@ -42,6 +69,17 @@ public slots:
     void lensCoverMoved(QmKeys::LensCoverPosition){}
     void volumeUpMoved(bool){}
     void volumeDownMoved(bool){}
+    void keyStateReceived(int request, MeeGo::QmKeys::Key, MeeGo::QmKeys::State){
+        lastRequest = request;
+        states++;
+    }
+    void keyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state){
+        keys.append(key);
+        keyStates.append(state);
+    }
+    void keyRepeated(MeeGo::QmKeys::Key, int count){
+        repeats += count;
+    }
 };
 
 
@@ -52,11 +90,20 @@ class TestClass : public QObject
 private:
     QmKeys *keys;
     SignalDump signalDump;
+    int uinput;
 
 private slots:
     void initTestCase() {
         keys = new QmKeys();
         QVERIFY(keys);
+
+        /* The arrow keys pass through qmkeyd untranslated from any device */
+        static const int testKeys[] = { KEY_UP, KEY_DOWN };
+        uinput = createKeyDevice("qmkeys test", testKeys, sizeof(testKeys) / sizeof(testKeys[0]));
+        QVERIFY2(uinput != -1, "Could not create a uinput device");
+
+        // Give qmkeyd time to notice the new device
+        QTest::qWait(1000);
     }
 
     void testConnectSignals() {
@@ -70,6 +117,10 @@ private slots:
                         &signalDump, SLOT(volumeUpMoved(bool))));
         QVERIFY(connect(keys, SIGNAL(volumeDownMoved(bool)),
                         &signalDump, SLOT(volumeDownMoved(bool))));
+        QVERIFY(connect(keys, SIGNAL(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                        &signalDump, SLOT(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State))));
+        QVERIFY(connect(keys, SIGNAL(keyRepeated(MeeGo::QmKeys::Key, int)),
+                        &signalDump, SLOT(keyRepeated(MeeGo::QmKeys::Key, int))));
     }
 
     void testGetSliderPosition(){
@@ -97,7 +148,188 @@ private slots:
         (void)result;
     }
 
+    void testSetKeyFilter(){
+        QList<QmKeys::Key> filter;
+        filter << QmKeys::UpKey;
+        keys->setKeyFilter(filter);
+        QTest::qWait(100);
+        signalDump.clear();
+
+        sendKey(uinput, KEY_DOWN, 1);
+        sendKey(uinput, KEY_DOWN, 0);
+        sendKey(uinput, KEY_UP, 1);
+        sendKey(uinput, KEY_UP, 0);
+        signalDump.waitForKeys(2);
+        // A filtered key that slipped through would arrive before the others
+        QTest::qWait(100);
+
+        QCOMPARE(signalDump.keys.size(), 2);
+        QCOMPARE(signalDump.keys.at(0), QmKeys::UpKey);
+        QCOMPARE(signalDump.keys.at(1), QmKeys::UpKey);
+
+        // The state of a filtered key can still be read
+        QCOMPARE(keys->getKeyState(QmKeys::DownKey), QmKeys::KeyUp);
+
+        keys->setKeyFilter(QList<QmKeys::Key>());
+        QTest::qWait(100);
+    }
+
+    void testGetKeyStates(){
+        QList<QmKeys::Key> list;
+        list << QmKeys::VolumeUp << QmKeys::Camera << QmKeys::PowerKey;
+        QMap<QmKeys::Key, QmKeys::State> result = keys->getKeyStates(list);
+        QCOMPARE(result.size(), list.size());
+    }
+
+    void testRequestKeyStates(){
+        QList<QmKeys::Key> list;
+        list << QmKeys::VolumeUp << QmKeys::Camera << QmKeys::PowerKey;
+        QVERIFY(connect(keys, SIGNAL(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                        &signalDump, SLOT(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State))));
+        int request = keys->requestKeyStates(list);
+        QVERIFY(request > 0);
+        for (int waited = 0; signalDump.states < list.size() && waited < 2000; waited += 10) {
+            QTest::qWait(10);
+        }
+        QCOMPARE(signalDump.states, list.size());
+        QCOMPARE(signalDump.lastRequest, request);
+    }
+
+    /* 30 repeats 10 ms apart, limited to 10 per second: a few keyEvent()
+       carry the repeats, and keyRepeated() accounts for all of them */
+    void testSetKeyRepeatRate(){
+        const int REPEATS = 30;
+        const int RATE = 10;
+
+        keys->setKeyRepeatRate(RATE);
+        signalDump.clear();
+
+        QTime time;
+        time.start();
+        sendKey(uinput, KEY_UP, 1);
+        for (int i = 0; i < REPEATS; i++) {
+            QTest::qWait(10);
+            sendKey(uinput, KEY_UP, 2);
+        }
+        sendKey(uinput, KEY_UP, 0);
+        int elapsed = time.elapsed();
+
+        for (int waited = 0; signalDump.keyStates.lastIndexOf(QmKeys::KeyUp) == -1 &&
+                             waited < EVENT_TIMEOUT_MS; waited += 10) {
+            QTest::qWait(10);
+        }
+        keys->setKeyRepeatRate(0);
+
+        // The press, the repeats let through and the release
+        QVERIFY(signalDump.keys.size() >= 2);
+        QCOMPARE(signalDump.keyStates.first(), QmKeys::KeyDown);
+        QCOMPARE(signalDump.keyStates.last(), QmKeys::KeyUp);
+        int emitted = signalDump.keys.size() - 2;
+
+        // One more for the repeats flushed by the release
+        QVERIFY(emitted >= 1);
+        QVERIFY(emitted <= elapsed * RATE / 1000 + 1);
+        QCOMPARE(signalDump.repeats, REPEATS);
+    }
+
+    /* Only the key given a rate is limited */
+    void testSetKeyRepeatRatePerKey(){
+        const int REPEATS = 10;
+
+        keys->setKeyRepeatRate(QmKeys::UpKey, 10);
+        signalDump.clear();
+
+        sendKey(uinput, KEY_DOWN, 1);
+        for (int i = 0; i < REPEATS; i++) {
+            QTest::qWait(10);
+            sendKey(uinput, KEY_DOWN, 2);
+        }
+        sendKey(uinput, KEY_DOWN, 0);
+        signalDump.waitForKeys(REPEATS + 2);
+        keys->setKeyRepeatRate(QmKeys::UpKey, 0);
+
+        QCOMPARE(signalDump.keys.size(), REPEATS + 2);
+        QCOMPARE(signalDump.keys.count(QmKeys::DownKey), REPEATS + 2);
+        QCOMPARE(signalDump.repeats, 0);
+    }
+
+    /* The merged repeats of a key that is held still are emitted once
+       the interval is over, not only when the key is released */
+    void testSetKeyRepeatRateHeld(){
+        const int RATE = 10;
+
+        keys->setKeyRepeatRate(QmKeys::UpKey, RATE);
+        signalDump.clear();
+
+        sendKey(uinput, KEY_UP, 1);
+        signalDump.waitForKeys(1);
+        sendKey(uinput, KEY_UP, 2);
+        sendKey(uinput, KEY_UP, 2);
+        signalDump.waitForKeys(2);
+
+        QCOMPARE(signalDump.keys.size(), 2);
+        QCOMPARE(signalDump.keyStates.at(1), QmKeys::KeyDown);
+        QCOMPARE(signalDump.repeats, 2);
+
+        sendKey(uinput, KEY_UP, 0);
+        signalDump.waitForKeys(3);
+        keys->setKeyRepeatRate(0);
+        QCOMPARE(signalDump.keys.size(), 3);
+        QCOMPARE(signalDump.keyStates.last(), QmKeys::KeyUp);
+    }
+
+    /* A QmKeys without a filter gets every key, even when it shares the
+       connection with QmKeys objects that have one */
+    void testSharedConnection(){
+        QList<QmKeys::Key> filter;
+        filter << QmKeys::UpKey;
+        keys->setKeyFilter(filter);
+
+        QmKeys *other = new QmKeys();
+        SignalDump otherDump;
+        QVERIFY(connect(other, SIGNAL(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                        &otherDump, SLOT(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State))));
+        // Let the subscriptions reach qmkeyd before the keys
+        QTest::qWait(100);
+
+        sendKey(uinput, KEY_DOWN, 1);
+        sendKey(uinput, KEY_DOWN, 0);
+        otherDump.waitForKeys(2);
+
+        QCOMPARE(otherDump.keys.size(), 2);
+        QCOMPARE(otherDump.keys.at(0), QmKeys::DownKey);
+        QCOMPARE(otherDump.keyStates.at(0), QmKeys::KeyDown);
+        QCOMPARE(otherDump.keys.at(1), QmKeys::DownKey);
+        QCOMPARE(otherDump.keyStates.at(1), QmKeys::KeyUp);
+
+        delete other;
+        keys->setKeyFilter(QList<QmKeys::Key>());
+    }
+
+    /* Made before qmkeyd has answered the hello of a new connection */
+    void testRequestKeyStatesOnConnect(){
+        // The only QmKeys goes, so that the next one connects again
+        delete keys;
+        keys = new QmKeys();
+
+        SignalDump dump;
+        QVERIFY(connect(keys, SIGNAL(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                        &dump, SLOT(keyStateReceived(int, MeeGo::QmKeys::Key, MeeGo::QmKeys::State))));
+        QList<QmKeys::Key> list;
+        list << QmKeys::VolumeUp << QmKeys::UpKey << QmKeys::PowerKey;
+        int request = keys->requestKeyStates(list);
+        QVERIFY(request > 0);
+        QCOMPARE(dump.states, 0);
+
+        for (int waited = 0; dump.states < list.size() && waited < EVENT_TIMEOUT_MS; waited += 10) {
+            QTest::qWait(10);
+        }
+        QCOMPARE(dump.states, list.size());
+        QCOMPARE(dump.lastRequest, request);
+    }
+
    void cleanupTestCase() {
+        destroyKeyDevice(uinput);
         delete keys;
     }
 };
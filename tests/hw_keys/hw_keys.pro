@@ -4,4 +4,5 @@ QT -=gui
 TARGET = hw_keys-test
 SOURCES += hw_keys.cpp
 
+include(../keydtest.pri)
 include(../common-install.pri)
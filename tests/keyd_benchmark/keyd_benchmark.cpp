@@ -0,0 +1,468 @@
+/**
+ * @file keyd_benchmark.cpp
+ * @brief qmkeyd latency benchmark
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QThread>
+#include <QVector>
+#include <QtAlgorithms>
+#include <qmkeys.h>
+#include <QTest>
+
+#include <linux/input.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "keydtest.h"
+
+using namespace MeeGo;
+
+/*
+ * The benchmark replays a key trace through uinput devices, which qmkeyd
+ * picks up like any other device, and measures the time from the write
+ * to uinput to the keyEvent() signal of each QmKeys client, as well as
+ * the CPU time qmkeyd spends per event. Run it as root against qmkeyd2.
+ * It is configured through the environment, as QTest owns the arguments:
+ *
+ *   KEYD_BENCH_TRACE    trace to replay, a built-in one is used without it
+ *   KEYD_BENCH_RATE     events per second, 0 replays with the recorded timing
+ *   KEYD_BENCH_CLIENTS  number of QmKeys clients
+ *   KEYD_BENCH_DEVICES  number of uinput devices the keys are spread over
+ *   KEYD_BENCH_REPEAT   number of times the trace is replayed
+ *   KEYD_BENCH_RECORD   device to record a trace from into KEYD_BENCH_TRACE
+ *   KEYD_BENCH_SECONDS  how long to record
+ *
+ * A trace is a text file with one key event per line,
+ *
+ *     <seconds> <code> <value>
+ *
+ * where seconds is the time of the event, code a key code and value 1 for
+ * a press or 0 for a release. Autorepeats and keys that do not map to
+ * exactly one QmKeys key are left out, as are lines starting with #.
+ */
+
+static const int DEFAULT_RATE = 200;
+static const int DEFAULT_CLIENTS = 4;
+static const int DEFAULT_DEVICES = 2;
+static const int DEFAULT_REPEAT = 1;
+static const int DEFAULT_RECORD_SECONDS = 10;
+
+/* Time allowed for the last events to arrive after the replay */
+static const int SETTLE_TIME_MS = 5000;
+
+/* Keys that qmkeyd passes through and QmKeys reports as one keyEvent() */
+static const struct {
+    __u16 code;
+    QmKeys::Key key;
+} benchKeys[] = {
+    { KEY_VOLUMEUP, QmKeys::VolumeUp },
+    { KEY_VOLUMEDOWN, QmKeys::VolumeDown },
+    { KEY_PHONE, QmKeys::Phone },
+    { KEY_PLAYPAUSE, QmKeys::PlayPause },
+    { KEY_STOPCD, QmKeys::Stop },
+    { KEY_MUTE, QmKeys::Mute },
+    { KEY_NEXTSONG, QmKeys::NextSong },
+    { KEY_PREVIOUSSONG, QmKeys::PreviousSong },
+    { KEY_PAUSECD, QmKeys::Pause },
+    { KEY_PLAYCD, QmKeys::Play },
+    { KEY_UP, QmKeys::UpKey },
+    { KEY_DOWN, QmKeys::DownKey },
+    { KEY_LEFT, QmKeys::LeftKey },
+    { KEY_RIGHT, QmKeys::RightKey },
+};
+
+static const int benchKeyCount = sizeof(benchKeys) / sizeof(benchKeys[0]);
+
+static int benchKeyIndex(int code)
+{
+    for (int i = 0; i < benchKeyCount; i++) {
+        if (benchKeys[i].code == code) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int envValue(const char *name, int defaultValue)
+{
+    QByteArray value = qgetenv(name);
+    bool ok = false;
+    int result = value.toInt(&ok);
+    return (ok && result >= 0) ? result : defaultValue;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Identifies the keyEvent() an event turns into */
+static int signature(QmKeys::Key key, QmKeys::State state)
+{
+    return key * 4 + state;
+}
+
+struct TraceEvent
+{
+    double time;        /* seconds from the start of the replay */
+    __u16 code;
+    __s32 value;
+    QmKeys::Key key;
+};
+
+/*
+ * The events to replay, and the time each one was written. The events
+ * are matched to the signals through their signatures: the n:th signal
+ * of a signature is the n:th event of it, which holds even when the
+ * events of different devices are delivered out of order.
+ */
+struct Trace
+{
+    Trace() : sent(0) {}
+    ~Trace() { delete[] sent; }
+
+    QVector<TraceEvent> events;
+    QHash<int, QVector<int> > bySignature;
+    double *sent;       /* written by the replayer, read by the clients */
+};
+
+class Replayer : public QThread
+{
+public:
+    Replayer(Trace *trace, const QVector<int> &devices) :
+        trace(trace), devices(devices) {}
+
+protected:
+    void run() {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < trace->events.size(); i++) {
+            const TraceEvent &event = trace->events.at(i);
+            struct timespec due = start;
+            due.tv_sec += (time_t)event.time;
+            due.tv_nsec += (long)((event.time - (time_t)event.time) * 1e9);
+            if (due.tv_nsec >= 1000000000) {
+                due.tv_sec++;
+                due.tv_nsec -= 1000000000;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, 0) != 0) {
+            }
+
+            /* A key stays on one device, so that its presses and releases pair up */
+            int fd = devices.at(event.code % devices.size());
+            trace->sent[i] = now();
+            __sync_synchronize();
+            sendKey(fd, event.code, event.value);
+        }
+    }
+
+private:
+    Trace *trace;
+    QVector<int> devices;
+};
+
+class BenchClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchClient(const Trace *trace) : received(0), trace(trace) {
+        keys = new QmKeys(this);
+        connect(keys, SIGNAL(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                this, SLOT(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)));
+    }
+
+    QVector<double> latencies;
+    int received;
+
+public slots:
+    void keyEvent(MeeGo::QmKeys::Key key, MeeGo::QmKeys::State state) {
+        double time = now();
+        int sig = signature(key, state);
+        int n = seen[sig]++;
+        const QVector<int> &events = trace->bySignature.value(sig);
+
+        received++;
+        if (n < events.size()) {
+            __sync_synchronize();
+            latencies.append(time - trace->sent[events.at(n)]);
+        }
+    }
+
+private:
+    QmKeys *keys;
+    const Trace *trace;
+    QHash<int, int> seen;
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    QVector<int> devices;
+
+    /* Presses and releases of the media keys, 100 ms apart */
+    static void builtinTrace(QVector<TraceEvent> &events) {
+        static const int codes[] = {
+            KEY_PLAYCD, KEY_PAUSECD, KEY_NEXTSONG, KEY_PREVIOUSSONG,
+            KEY_VOLUMEUP, KEY_VOLUMEDOWN, KEY_STOPCD, KEY_MUTE
+        };
+        double time = 0;
+
+        for (int round = 0; round < 64; round++) {
+            for (unsigned int i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+                for (int value = 1; value >= 0; value--) {
+                    TraceEvent event;
+                    event.time = time;
+                    event.code = codes[i];
+                    event.value = value;
+                    events.append(event);
+                    time += 0.1;
+                }
+            }
+        }
+    }
+
+    static bool loadTrace(const QByteArray &path, QVector<TraceEvent> &events) {
+        char line[128];
+        int skipped = 0;
+        double first = -1;
+
+        FILE *in = fopen(path.constData(), "r");
+        if (!in) {
+            perror(path.constData());
+            return false;
+        }
+
+        while (fgets(line, sizeof(line), in)) {
+            TraceEvent event;
+            unsigned int code;
+            int value;
+
+            if (line[0] == '#' || line[0] == '\n') {
+                continue;
+            }
+            if (sscanf(line, "%lf %u %d", &event.time, &code, &value) != 3) {
+                fprintf(stderr, "%s: invalid line %s", path.constData(), line);
+                fclose(in);
+                return false;
+            }
+            if (benchKeyIndex(code) == -1 || (value != 0 && value != 1)) {
+                skipped++;
+                continue;
+            }
+            if (first < 0) {
+                first = event.time;
+            }
+            event.time -= first;
+            event.code = code;
+            event.value = value;
+            events.append(event);
+        }
+        fclose(in);
+
+        if (skipped) {
+            printf("Left out %d events of %s\n", skipped, path.constData());
+        }
+        return true;
+    }
+
+    /* Repeats and paces the trace, and indexes the events by signature */
+    static void prepareTrace(Trace &trace, const QVector<TraceEvent> &source, int rate, int repeat) {
+        double length = source.isEmpty() ? 0 : source.last().time + 0.1;
+
+        for (int r = 0; r < repeat; r++) {
+            for (int i = 0; i < source.size(); i++) {
+                TraceEvent event = source.at(i);
+                int n = trace.events.size();
+
+                event.time = rate ? (double)n / rate : r * length + event.time;
+                event.key = benchKeys[benchKeyIndex(event.code)].key;
+                trace.events.append(event);
+                trace.bySignature[signature(event.key, event.value ? QmKeys::KeyDown : QmKeys::KeyUp)].append(n);
+            }
+        }
+        trace.sent = new double[trace.events.size()];
+    }
+
+private slots:
+    void initTestCase() {
+        int count = envValue("KEYD_BENCH_DEVICES", DEFAULT_DEVICES);
+        int codes[benchKeyCount];
+        for (int i = 0; i < benchKeyCount; i++) {
+            codes[i] = benchKeys[i].code;
+        }
+        for (int i = 0; i < qMax(count, 1); i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "qmkeyd benchmark %d", i);
+            /* Not a headset, the kernel would add autorepeats to long presses */
+            int fd = createKeyDevice(name, codes, benchKeyCount);
+            QVERIFY2(fd != -1, "Could not create a uinput device");
+            devices.append(fd);
+        }
+
+        // Give qmkeyd time to notice the new devices
+        QTest::qWait(1000);
+    }
+
+    /* Writes the key events of a real device into a trace for testReplay() */
+    void testRecord() {
+        QByteArray device = qgetenv("KEYD_BENCH_RECORD");
+        QByteArray path = qgetenv("KEYD_BENCH_TRACE");
+        int seconds = envValue("KEYD_BENCH_SECONDS", DEFAULT_RECORD_SECONDS);
+
+        if (device.isEmpty()) {
+            printf("KEYD_BENCH_RECORD is not set, nothing to record\n");
+            return;
+        }
+        QVERIFY2(!path.isEmpty(), "KEYD_BENCH_TRACE must name the trace to record");
+
+        int fd = open(device.constData(), O_RDONLY);
+        QVERIFY2(fd != -1, "Could not open the device to record");
+        FILE *out = fopen(path.constData(), "w");
+        if (!out) {
+            close(fd);
+            QFAIL("Could not create the trace");
+        }
+
+        fprintf(out, "# Recorded from %s\n", device.constData());
+        printf("Recording %s for %d s\n", device.constData(), seconds);
+
+        int recorded = 0;
+        double end = now() + seconds;
+        for (double left = seconds; left > 0; left = end - now()) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            struct input_event ev;
+
+            if (poll(&pfd, 1, (int)(left * 1000) + 1) <= 0) {
+                continue;
+            }
+            if (read(fd, &ev, sizeof(ev)) != sizeof(ev)) {
+                break;
+            }
+            if (ev.type == EV_KEY) {
+                fprintf(out, "%ld.%06ld %u %d\n", (long)ev.time.tv_sec, (long)ev.time.tv_usec, ev.code, ev.value);
+                recorded++;
+            }
+        }
+
+        close(fd);
+        QVERIFY(fclose(out) == 0);
+        printf("Recorded %d key events into %s\n", recorded, path.constData());
+    }
+
+    void testReplay() {
+        QVector<TraceEvent> source;
+        QByteArray path = qgetenv("KEYD_BENCH_TRACE");
+        int rate = envValue("KEYD_BENCH_RATE", DEFAULT_RATE);
+        int clientCount = qMax(envValue("KEYD_BENCH_CLIENTS", DEFAULT_CLIENTS), 1);
+        int repeat = qMax(envValue("KEYD_BENCH_REPEAT", DEFAULT_REPEAT), 1);
+
+        if (path.isEmpty()) {
+            builtinTrace(source);
+        } else {
+            QVERIFY2(loadTrace(path, source), "Could not read the trace");
+        }
+        QVERIFY2(!source.isEmpty(), "The trace has no events to replay");
+
+        Trace trace;
+        prepareTrace(trace, source, rate, repeat);
+        int expected = trace.events.size();
+
+        QList<BenchClient*> clients;
+        for (int i = 0; i < clientCount; i++) {
+            clients.append(new BenchClient(&trace));
+        }
+        QTest::qWait(500);
+
+        long ticks = keydCpuTicks();
+        double start = now();
+
+        Replayer replayer(&trace, devices);
+        replayer.start();
+        while (!replayer.isFinished()) {
+            QTest::qWait(10);
+        }
+
+        for (int waited = 0; waited < SETTLE_TIME_MS; waited += 10) {
+            bool done = true;
+            foreach (BenchClient *client, clients) {
+                done = done && client->received >= expected;
+            }
+            if (done) {
+                break;
+            }
+            QTest::qWait(10);
+        }
+
+        double elapsed = now() - start;
+        long used = (ticks != -1) ? keydCpuTicks() - ticks : -1;
+
+        QVector<double> latencies;
+        int lost = 0;
+        foreach (BenchClient *client, clients) {
+            latencies += client->latencies;
+            lost += expected - client->latencies.size();
+        }
+        qDeleteAll(clients);
+
+        printf("Replayed %d events to %d clients through %d devices in %.3f s, %.0f events/s\n",
+               expected, clientCount, devices.size(), elapsed, expected / elapsed);
+
+        if (!latencies.isEmpty()) {
+            qSort(latencies.begin(), latencies.end());
+            int n = latencies.size();
+            printf("Event to signal latency: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                   latencies.at(n / 2) * 1000,
+                   latencies.at(qMin(n - 1, n * 99 / 100)) * 1000,
+                   latencies.last() * 1000);
+        }
+        if (used != -1) {
+            printf("qmkeyd used %.1f us of CPU per event\n",
+                   used * 1e6 / sysconf(_SC_CLK_TCK) / expected);
+        }
+        if (lost) {
+            printf("%d events were not delivered\n", lost);
+        }
+
+        QCOMPARE(lost, 0);
+    }
+
+    void cleanupTestCase() {
+        foreach (int fd, devices) {
+            destroyKeyDevice(fd);
+        }
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "keyd_benchmark.moc"
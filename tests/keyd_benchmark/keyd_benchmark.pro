@@ -0,0 +1,8 @@
+QT -= gui
+
+TARGET = keyd-benchmark-test
+SOURCES += keyd_benchmark.cpp
+LIBS += -lrt
+
+include(../keydtest.pri)
+include(../common-install.pri)
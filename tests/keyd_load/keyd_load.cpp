@@ -0,0 +1,122 @@
+/**
+ * @file keyd_load.cpp
+ * @brief Synthetic qmkeyd load test
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <qmkeys.h>
+#include <QTest>
+
+#include <linux/input.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "keydtest.h"
+
+using namespace MeeGo;
+
+/* Number of press/release pairs sent in one burst */
+static const int BURST_SIZE = 1000;
+
+/* The burst is paced so that the evdev buffer of qmkeyd does not overflow */
+static const int CHUNK_SIZE = 4;
+static const int CHUNK_DELAY_US = 500;
+
+/*
+ * The test creates a uinput device with the media keys of a bluetooth
+ * headset, which qmkeyd picks up through its /dev/input watch like any
+ * other device that reports a supported key, and measures how
+ * fast qmkeyd delivers a burst of key events to a QmKeys client. Run it
+ * as root against qmkeyd2 with and without -e to compare the event loops.
+ */
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State) {
+        received++;
+    }
+
+private:
+    QmKeys *keys;
+    int uinput;
+    int received;
+
+    static double now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+private slots:
+    void initTestCase() {
+        received = 0;
+        keys = new QmKeys();
+        QVERIFY(connect(keys, SIGNAL(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State)),
+                        this, SLOT(keyEvent(MeeGo::QmKeys::Key, MeeGo::QmKeys::State))));
+        static const int headsetKeys[] = {
+            KEY_PAUSECD, KEY_PLAYCD, KEY_STOPCD, KEY_NEXTSONG,
+            KEY_FASTFORWARD, KEY_PREVIOUSSONG, KEY_REWIND
+        };
+        uinput = createKeyDevice("qmkeyd load test", headsetKeys,
+                                 sizeof(headsetKeys) / sizeof(headsetKeys[0]), true);
+        QVERIFY2(uinput != -1, "Could not create a uinput device");
+
+        // Give qmkeyd time to notice the new device
+        QTest::qWait(1000);
+    }
+
+    void testBurst() {
+        long ticks = keydCpuTicks();
+        double start = now();
+
+        for (int i = 0; i < BURST_SIZE; i++) {
+            sendKey(uinput, KEY_PLAYCD, 1);
+            sendKey(uinput, KEY_PLAYCD, 0);
+            if (i % CHUNK_SIZE == CHUNK_SIZE - 1) {
+                usleep(CHUNK_DELAY_US);
+            }
+        }
+
+        for (int waited = 0; received < 2 * BURST_SIZE && waited < 10000; waited += 10) {
+            QTest::qWait(10);
+        }
+
+        double elapsed = now() - start;
+        printf("%d of %d events in %.3f s, %.0f events/s\n",
+               received, 2 * BURST_SIZE, elapsed, received / elapsed);
+        if (ticks != -1) {
+            printf("qmkeyd used %.2f ms of CPU per 1000 events\n",
+                   (keydCpuTicks() - ticks) * 1000.0 / sysconf(_SC_CLK_TCK) / (2 * BURST_SIZE) * 1000);
+        }
+
+        QCOMPARE(received, 2 * BURST_SIZE);
+    }
+
+    void cleanupTestCase() {
+        destroyKeyDevice(uinput);
+        delete keys;
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "keyd_load.moc"
@@ -0,0 +1,7 @@
+QT -= gui
+
+TARGET = keyd-load-test
+SOURCES += keyd_load.cpp
+
+include(../keydtest.pri)
+include(../common-install.pri)
@@ -0,0 +1,68 @@
+/**
+ * @file keydprotocol.cpp
+ * @brief qmkeyd protocol helper tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <QTest>
+
+#include "qmkeydprotocol_p.h"
+
+#ifndef KEY_MEDIA
+#define KEY_MEDIA 226
+#endif
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testCodeMask() {
+        QCOMPARE(qmkeyd_code_mask(EV_SW, SW_KEYPAD_SLIDE), 1U);
+        QCOMPARE(qmkeyd_code_mask(EV_KEY, KEY_VOLUMEUP), 1U << 3);
+        QCOMPARE(qmkeyd_code_mask(EV_KEY, KEY_POWER), 1U << (QMKEYD_CODE_COUNT - 1));
+
+        // A code of the wrong type is not the same code
+        QCOMPARE(qmkeyd_code_mask(EV_SW, KEY_VOLUMEUP), 0U);
+        QCOMPARE(qmkeyd_code_mask(EV_KEY, KEY_MEDIA), 0U);
+    }
+
+    void testSubscribed() {
+        __u32 volumeUp = qmkeyd_code_mask(EV_KEY, KEY_VOLUMEUP);
+        __u32 volumeDown = qmkeyd_code_mask(EV_KEY, KEY_VOLUMEDOWN);
+
+        QVERIFY(qmkeyd_subscribed(QMKEYD_SUBSCRIBE_ALL, volumeUp));
+        QVERIFY(qmkeyd_subscribed(volumeUp, volumeUp));
+        QVERIFY(!qmkeyd_subscribed(volumeUp, volumeDown));
+        QVERIFY(!qmkeyd_subscribed(0, volumeUp));
+    }
+
+    /* Keys that cannot be subscribed to reach every client, filtered or not */
+    void testSubscribedUnmasked() {
+        __u32 media = qmkeyd_code_mask(EV_KEY, KEY_MEDIA);
+
+        QVERIFY(qmkeyd_subscribed(QMKEYD_SUBSCRIBE_ALL, media));
+        QVERIFY(qmkeyd_subscribed(qmkeyd_code_mask(EV_KEY, KEY_VOLUMEUP), media));
+        QVERIFY(qmkeyd_subscribed(0, media));
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "keydprotocol.moc"
@@ -0,0 +1,7 @@
+QT -= gui
+
+TARGET = keydprotocol-test
+HEADERS += ../../system/qmkeydprotocol_p.h
+SOURCES += keydprotocol.cpp
+
+include(../common-install.pri)
@@ -0,0 +1,134 @@
+/**
+ * @file keydtest.cpp
+ * @brief Helpers of the tests that drive qmkeyd through uinput devices
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "keydtest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QStringList>
+
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int createKeyDevice(const char *name, const int *codes, int count, bool headset)
+{
+    struct uinput_user_dev dev;
+
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd == -1) {
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_SYN);
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    if (headset) {
+        ioctl(fd, UI_SET_EVBIT, EV_REL);
+        ioctl(fd, UI_SET_EVBIT, EV_REP);
+        ioctl(fd, UI_SET_RELBIT, REL_X);
+    }
+    for (int i = 0; i < count; i++) {
+        ioctl(fd, UI_SET_KEYBIT, codes[i]);
+    }
+
+    memset(&dev, 0, sizeof(dev));
+    strncpy(dev.name, name, UINPUT_MAX_NAME_SIZE - 1);
+    dev.id.bustype = BUS_VIRTUAL;
+
+    if (write(fd, &dev, sizeof(dev)) != sizeof(dev) ||
+        ioctl(fd, UI_DEV_CREATE) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void destroyKeyDevice(int fd)
+{
+    if (fd != -1) {
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+    }
+}
+
+void sendInputEvent(int fd, __u16 type, __u16 code, __s32 value)
+{
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) {
+        perror("uinput write");
+    }
+}
+
+void sendKey(int fd, __u16 code, __s32 value)
+{
+    sendInputEvent(fd, EV_KEY, code, value);
+    sendInputEvent(fd, EV_SYN, SYN_REPORT, 0);
+}
+
+/* Both qmkeyd2 and qmkeyd2-qt5 */
+static int keydPid()
+{
+    QStringList entries = QDir("/proc").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+
+    foreach (const QString &entry, entries) {
+        bool ok = false;
+        int pid = entry.toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+        QFile comm(QString("/proc/%1/comm").arg(pid));
+        if (comm.open(QIODevice::ReadOnly) && comm.readAll().startsWith("qmkeyd")) {
+            return pid;
+        }
+    }
+    return -1;
+}
+
+long keydCpuTicks()
+{
+    int pid = keydPid();
+    if (pid == -1) {
+        return -1;
+    }
+
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    // utime and stime are the 14th and 15th fields, after the command name
+    QByteArray line = stat.readAll();
+    QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) {
+        return -1;
+    }
+    return fields.at(11).toLong() + fields.at(12).toLong();
+}
@@ -0,0 +1,52 @@
+/**
+ * @file keydtest.h
+ * @brief Helpers of the tests that drive qmkeyd through uinput devices
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef KEYDTEST_H
+#define KEYDTEST_H
+
+#include <linux/types.h>
+
+/*
+ * Creates a uinput device that reports the given key codes, and returns
+ * its descriptor, or -1 if it could not be created. qmkeyd picks the
+ * device up through its /dev/input watch. With headset set the device
+ * also reports relative and repeat events, which makes qmkeyd take it
+ * for a bluetooth headset; the kernel then autorepeats held keys.
+ */
+int createKeyDevice(const char *name, const int *codes, int count, bool headset = false);
+
+void destroyKeyDevice(int fd);
+
+/* Writes a single event into the device */
+void sendInputEvent(int fd, __u16 type, __u16 code, __s32 value);
+
+/* Writes a key event followed by an EV_SYN */
+void sendKey(int fd, __u16 code, __s32 value);
+
+/*
+ * CPU time used by qmkeyd so far, in clock ticks, or -1 if qmkeyd is not
+ * running. The process is looked up in /proc, so that the measurement
+ * does not add a client to qmkeyd.
+ */
+long keydCpuTicks();
+
+#endif // KEYDTEST_H
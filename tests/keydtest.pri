@@ -0,0 +1,4 @@
+# Helpers of the tests that drive qmkeyd through uinput devices
+INCLUDEPATH += ..
+HEADERS += ../keydtest.h
+SOURCES += ../keydtest.cpp
@@ -0,0 +1,151 @@
+/**
+ * @file keys_legacy.cpp
+ * @brief QmKeys tests against a qmkeyd that does not know the hello
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QSemaphore>
+#include <QTest>
+#include <QThread>
+#include <QTime>
+
+#include <linux/input.h>
+#include <string.h>
+
+#include "qmkeys.h"
+#include "qmkeys_p.h"
+
+using namespace MeeGo;
+
+/* Well below the second QmKeys waits for the answer to the hello */
+#define ANSWER_TIMEOUT_MS 500
+
+/*
+ * A qmkeyd from before the hello: each key or switch code sent to it is
+ * sent back with the state, key up, and anything else, the hello
+ * included, is dropped without an answer. It runs on a thread of its
+ * own, as the synchronous queries block the thread of the test.
+ */
+class LegacyServer : public QThread
+{
+public:
+    LegacyServer() : listening(false), stopping(false), queries(0) {}
+
+    bool start() {
+        QThread::start();
+        started.acquire();
+        return listening;
+    }
+
+    void stop() {
+        stopping = true;
+        wait();
+    }
+
+    volatile bool listening;
+    volatile bool stopping;
+    volatile int queries;
+
+protected:
+    void run() {
+        QLocalServer server;
+        QList<QLocalSocket*> clients;
+
+        QLocalServer::removeServer(SERVER_NAME);
+        listening = server.listen(SERVER_NAME);
+        started.release();
+
+        while (listening && !stopping) {
+            server.waitForNewConnection(10);
+            while (server.hasPendingConnections()) {
+                clients.append(server.nextPendingConnection());
+            }
+
+            foreach (QLocalSocket *client, clients) {
+                struct input_event ev;
+                client->waitForReadyRead(1);
+                while (client->bytesAvailable() >= (qint64)sizeof(ev) &&
+                       client->read((char*)&ev, sizeof(ev)) == sizeof(ev)) {
+                    if (ev.type == EV_KEY || ev.type == EV_SW) {
+                        ev.value = 0;
+                        client->write((const char*)&ev, sizeof(ev));
+                        client->waitForBytesWritten(ANSWER_TIMEOUT_MS);
+                        queries++;
+                    }
+                }
+            }
+        }
+
+        qDeleteAll(clients);
+    }
+
+private:
+    QSemaphore started;
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    LegacyServer server;
+    QmKeys *keys;
+
+private slots:
+    void initTestCase() {
+        QVERIFY(server.start());
+        keys = new QmKeys();
+    }
+
+    /* The query goes to the server at once, instead of waiting for the
+       snapshot that would follow an answer to the hello */
+    void testGetKeyStateBeforeHelloTimeout() {
+        QTime elapsed;
+        elapsed.start();
+        QCOMPARE(keys->getKeyState(QmKeys::VolumeUp), QmKeys::KeyUp);
+        QVERIFY2(elapsed.elapsed() < ANSWER_TIMEOUT_MS,
+                 QByteArray::number(elapsed.elapsed()));
+        QVERIFY(server.queries > 0);
+    }
+
+    void testGetKeyStatesBeforeHelloTimeout() {
+        QList<QmKeys::Key> asked;
+        asked << QmKeys::VolumeDown << QmKeys::KeyboardSlider;
+
+        QTime elapsed;
+        elapsed.start();
+        QMap<QmKeys::Key, QmKeys::State> states = keys->getKeyStates(asked);
+        QVERIFY2(elapsed.elapsed() < ANSWER_TIMEOUT_MS,
+                 QByteArray::number(elapsed.elapsed()));
+        QCOMPARE(states.value(QmKeys::VolumeDown), QmKeys::KeyUp);
+        QCOMPARE(states.value(QmKeys::KeyboardSlider), QmKeys::KeyUp);
+    }
+
+    void cleanupTestCase() {
+        delete keys;
+        server.stop();
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "keys_legacy.moc"
@@ -0,0 +1,15 @@
+QT += network
+QT -= gui
+
+TARGET = keys_legacy-test
+
+# The backend is built in against a server of the test, without the
+# state table of a qmkeyd that may be running
+DEFINES += SERVER_NAME=\\\"/tmp/qmkeyd-legacy-test\\\" \
+    QMKEYD_STATE_NAME=\\\"/qmkeyd-legacy-test-state\\\"
+HEADERS += ../../system/qmkeys.h \
+    ../../system/qmkeys_p.h
+SOURCES += keys_legacy.cpp \
+    ../../system/qmkeys.cpp
+
+include(../common-install.pri)
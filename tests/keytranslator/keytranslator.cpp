@@ -0,0 +1,235 @@
+/**
+ * @file keytranslator.cpp
+ * @brief KeyTranslator trace tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <QList>
+#include <QTest>
+
+#include "keytranslator.h"
+
+/* A recorded step: a key event, or a check of the deadline at the given
+   time, which stands for the long press timer firing at that moment */
+#define CHECK_DEADLINE -1
+
+struct TraceStep
+{
+    long sec;
+    long usec;
+    int value;
+};
+
+struct Translated
+{
+    __u16 code;
+    int value;
+    long sec;
+    long usec;
+};
+
+/*
+ * Replays recorded event traces through KeyTranslator. The translation
+ * depends on the event timestamps only, so the results must not depend
+ * on when the events are processed.
+ */
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void keyTranslated(struct input_event &ev) {
+        Translated t;
+        t.code = ev.code;
+        t.value = ev.value;
+        t.sec = ev.time.tv_sec;
+        t.usec = ev.time.tv_usec;
+        received.append(t);
+    }
+
+private:
+    KeyTranslator *translator;
+    QList<Translated> received;
+
+    void replay(const TraceStep *trace, int steps) {
+        for (int i = 0; i < steps; i++) {
+            if (trace[i].value == CHECK_DEADLINE) {
+                struct timeval now;
+                now.tv_sec = trace[i].sec;
+                now.tv_usec = trace[i].usec;
+                translator->checkDeadline(now);
+            } else {
+                struct input_event ev;
+                memset(&ev, 0, sizeof(ev));
+                ev.time.tv_sec = trace[i].sec;
+                ev.time.tv_usec = trace[i].usec;
+                ev.type = EV_KEY;
+                ev.code = KEY_REWIND;
+                ev.value = trace[i].value;
+                translator->handleEvent(ev);
+            }
+        }
+    }
+
+    void verify(const Translated *expected, int count) {
+        QCOMPARE(received.count(), count);
+        for (int i = 0; i < count; i++) {
+            QCOMPARE(received[i].code, expected[i].code);
+            QCOMPARE(received[i].value, expected[i].value);
+            QCOMPARE(received[i].sec, expected[i].sec);
+            QCOMPARE(received[i].usec, expected[i].usec);
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        translator = new KeyTranslator();
+        QVERIFY(translator);
+        translator->shortPressKey = KEY_PREVIOUSSONG;
+        translator->longPressKey = KEY_FASTFORWARD;
+        QVERIFY(connect(translator, SIGNAL(keyTranslated(struct input_event&)),
+                        this, SLOT(keyTranslated(struct input_event&))));
+    }
+
+    void init() {
+        received.clear();
+        translator->doublePressKey = 0;
+        translator->longPressThreshold = 1000;
+        translator->doublePressWindow = 300;
+    }
+
+    void testShortPress() {
+        const TraceStep trace[] = {
+            { 100, 0, 1 },
+            { 100, 999999, 0 },
+        };
+        const Translated expected[] = {
+            { KEY_PREVIOUSSONG, 1, 100, 0 },
+            { KEY_PREVIOUSSONG, 0, 100, 999999 },
+        };
+        replay(trace, 2);
+        verify(expected, 2);
+    }
+
+    void testLongPressByTimer() {
+        const TraceStep trace[] = {
+            { 200, 0, 1 },
+            { 200, 999999, CHECK_DEADLINE },
+            { 201, 5000, CHECK_DEADLINE },
+            { 203, 0, 0 },
+        };
+        const Translated expected[] = {
+            { KEY_FASTFORWARD, 1, 201, 0 },
+            { KEY_FASTFORWARD, 0, 203, 0 },
+        };
+        replay(trace, 4);
+        verify(expected, 2);
+    }
+
+    /* The timer was not serviced in time, e.g. under load */
+    void testLongPressLateTimer() {
+        const TraceStep trace[] = {
+            { 300, 0, 1 },
+            { 301, 0, 0 },
+            { 305, 0, CHECK_DEADLINE },
+        };
+        const Translated expected[] = {
+            { KEY_FASTFORWARD, 1, 301, 0 },
+            { KEY_FASTFORWARD, 0, 301, 0 },
+        };
+        replay(trace, 3);
+        verify(expected, 2);
+    }
+
+    void testRepeatsIgnored() {
+        const TraceStep trace[] = {
+            { 400, 0, 1 },
+            { 400, 250000, 2 },
+            { 400, 500000, 2 },
+            { 400, 600000, 0 },
+        };
+        const Translated expected[] = {
+            { KEY_PREVIOUSSONG, 1, 400, 0 },
+            { KEY_PREVIOUSSONG, 0, 400, 600000 },
+        };
+        replay(trace, 4);
+        verify(expected, 2);
+    }
+
+    void testThreshold() {
+        const TraceStep trace[] = {
+            { 500, 0, 1 },
+            { 500, 300000, 2 },
+            { 500, 400000, 0 },
+        };
+        const Translated expected[] = {
+            { KEY_FASTFORWARD, 1, 500, 300000 },
+            { KEY_FASTFORWARD, 0, 500, 400000 },
+        };
+        translator->longPressThreshold = 300;
+        replay(trace, 3);
+        verify(expected, 2);
+    }
+
+    void testDoublePress() {
+        const TraceStep trace[] = {
+            { 600, 0, 1 },
+            { 600, 100000, 0 },
+            { 600, 350000, 1 },
+            { 600, 450000, 0 },
+        };
+        const Translated expected[] = {
+            { KEY_NEXTSONG, 1, 600, 350000 },
+            { KEY_NEXTSONG, 0, 600, 450000 },
+        };
+        translator->doublePressKey = KEY_NEXTSONG;
+        replay(trace, 4);
+        verify(expected, 2);
+    }
+
+    /* A short press is reported once the double press window is over */
+    void testShortPressAfterWindow() {
+        const TraceStep trace[] = {
+            { 700, 0, 1 },
+            { 700, 100000, 0 },
+            { 700, 399999, CHECK_DEADLINE },
+            { 700, 400000, CHECK_DEADLINE },
+            { 701, 0, 1 },
+            { 701, 100000, 0 },
+            { 702, 0, CHECK_DEADLINE },
+        };
+        const Translated expected[] = {
+            { KEY_PREVIOUSSONG, 1, 700, 0 },
+            { KEY_PREVIOUSSONG, 0, 700, 100000 },
+            { KEY_PREVIOUSSONG, 1, 701, 0 },
+            { KEY_PREVIOUSSONG, 0, 701, 100000 },
+        };
+        translator->doublePressKey = KEY_NEXTSONG;
+        replay(trace, 7);
+        verify(expected, 4);
+    }
+
+    void cleanupTestCase() {
+        delete translator;
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "keytranslator.moc"
@@ -0,0 +1,9 @@
+QT -= gui
+
+TARGET = keytranslator-test
+INCLUDEPATH += ../../keyd
+HEADERS += ../../keyd/keytranslator.h
+SOURCES += keytranslator.cpp \
+    ../../keyd/keytranslator.cpp
+
+include(../common-install.pri)
@@ -0,0 +1,201 @@
+/**
+ * @file sensor_transform_benchmark.cpp
+ * @brief Benchmark of the sensor sample transforms
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include <QObject>
+#include <QVector>
+#include <QTest>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "qmsensortransform_p.h"
+
+using namespace MeeGo;
+
+/*
+ * Checks that the vectorized transforms give the same results as the
+ * transforms sample by sample, and compares their speed on blocks of
+ * QMSENSOR_BLOCK_SIZE samples, the size the sensors transform at a time.
+ * SENSOR_BENCH_BLOCKS in the environment sets the number of blocks.
+ */
+
+static const int DEFAULT_BLOCKS = 100000;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    int blocks;
+    QVector<int> x, y, z;
+    QVector<int> outX, outY, outZ;
+
+    void fill(int range) {
+        for (int i = 0; i < x.size(); i++) {
+            x[i] = rand() % (2 * range + 1) - range;
+            y[i] = rand() % (2 * range + 1) - range;
+            z[i] = rand() % (2 * range + 1) - range;
+        }
+    }
+
+    void report(const char *what, double vectorized, double scalar) {
+        double samples = (double)blocks * QMSENSOR_BLOCK_SIZE;
+        printf("%s: %.2f ns per sample with %s, %.2f ns one by one\n", what,
+               vectorized * 1e9 / samples, QmSensorTransform::implementation(),
+               scalar * 1e9 / samples);
+    }
+
+private slots:
+    void initTestCase() {
+        QByteArray value = qgetenv("SENSOR_BENCH_BLOCKS");
+        bool ok = false;
+        blocks = value.toInt(&ok);
+        if (!ok || blocks <= 0) {
+            blocks = DEFAULT_BLOCKS;
+        }
+
+        // Not a multiple of the vector width, to cover the remainders too
+        int count = 4099;
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        outX.resize(count);
+        outY.resize(count);
+        outZ.resize(count);
+        srand(1);
+    }
+
+    void testRemapAccelerometer() {
+        fill(4000);
+        QmSensorTransform::remapAccelerometer(x.constData(), y.constData(), z.constData(),
+                                              outX.data(), outY.data(), outZ.data(), x.size());
+        for (int i = 0; i < x.size(); i++) {
+            QCOMPARE(outX[i], -y[i]);
+            QCOMPARE(outY[i], x[i]);
+            QCOMPARE(outZ[i], z[i]);
+        }
+    }
+
+    void testFoldRotation_data() {
+        QTest::addColumn<int>("range");
+        QTest::newRow("sensord") << 180;
+        QTest::newRow("wide") << 1000;
+        QTest::newRow("large") << (1 << 22);
+    }
+
+    void testFoldRotation() {
+        QFETCH(int, range);
+        fill(range);
+        QmSensorTransform::foldRotation(x.constData(), y.constData(), z.constData(),
+                                        outX.data(), outY.data(), outZ.data(), x.size());
+        for (int i = 0; i < x.size(); i++) {
+            int rx, ry, rz;
+            QmSensorTransform::foldRotationSample(x[i], y[i], z[i], rx, ry, rz);
+            QCOMPARE(outX[i], rx);
+            QCOMPARE(outY[i], ry);
+            QCOMPARE(outZ[i], rz);
+        }
+    }
+
+    void testConvert() {
+        fill(4000);
+        QVector<float> out(x.size());
+        QmSensorTransform::convert(x.constData(), out.data(), x.size(), QMSENSOR_MG_TO_MS2);
+        for (int i = 0; i < x.size(); i++) {
+            QCOMPARE(out[i], x[i] * QMSENSOR_MG_TO_MS2);
+        }
+    }
+
+    void benchmarkTransforms() {
+        QmXYZBlock block;
+        volatile int sink = 0;
+        fill(180);
+        for (int i = 0; i < QMSENSOR_BLOCK_SIZE; i++) {
+            block.append(i, x[i], y[i], z[i]);
+        }
+
+        double start = now();
+        for (int b = 0; b < blocks; b++) {
+            QmSensorTransform::remapAccelerometer(block.x, block.y, block.z,
+                                                  block.x, block.y, block.z, block.count);
+            sink += block.x[b % QMSENSOR_BLOCK_SIZE];
+        }
+        double vectorized = now() - start;
+
+        start = now();
+        for (int b = 0; b < blocks; b++) {
+            for (int i = 0; i < block.count; i++) {
+                int sx = block.x[i];
+                block.x[i] = -block.y[i];
+                block.y[i] = sx;
+            }
+            sink += block.x[b % QMSENSOR_BLOCK_SIZE];
+        }
+        report("Accelerometer remapping", vectorized, now() - start);
+
+        start = now();
+        for (int b = 0; b < blocks; b++) {
+            QmSensorTransform::foldRotation(x.constData(), y.constData(), z.constData(),
+                                            block.x, block.y, block.z, block.count);
+            sink += block.z[b % QMSENSOR_BLOCK_SIZE];
+        }
+        vectorized = now() - start;
+
+        start = now();
+        for (int b = 0; b < blocks; b++) {
+            for (int i = 0; i < block.count; i++) {
+                QmSensorTransform::foldRotationSample(x[i], y[i], z[i],
+                                                      block.x[i], block.y[i], block.z[i]);
+            }
+            sink += block.z[b % QMSENSOR_BLOCK_SIZE];
+        }
+        report("Rotation folding", vectorized, now() - start);
+
+        float out[QMSENSOR_BLOCK_SIZE];
+        start = now();
+        for (int b = 0; b < blocks; b++) {
+            QmSensorTransform::convert(block.x, out, block.count, QMSENSOR_DEG_TO_RAD);
+            sink += (int)out[b % QMSENSOR_BLOCK_SIZE];
+        }
+        vectorized = now() - start;
+
+        start = now();
+        for (int b = 0; b < blocks; b++) {
+            for (int i = 0; i < block.count; i++) {
+                out[i] = block.x[i] * QMSENSOR_DEG_TO_RAD;
+            }
+            sink += (int)out[b % QMSENSOR_BLOCK_SIZE];
+        }
+        report("Conversion to radians", vectorized, now() - start);
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "sensor_transform_benchmark.moc"
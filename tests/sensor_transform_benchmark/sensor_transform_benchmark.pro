@@ -0,0 +1,7 @@
+QT -= gui
+
+TARGET = sensor-transform-benchmark-test
+SOURCES += sensor_transform_benchmark.cpp
+LIBS += -lrt
+
+include(../common-install.pri)
@@ -0,0 +1,158 @@
+/**
+ * @file sensorfilter.cpp
+ * @brief QmSensorFilterChain tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QObject>
+#include <QTest>
+
+#include "qmsensorfilter_p.h"
+
+using namespace MeeGo;
+
+/*
+ * Runs synthetic samples through the filter chain. The same value goes
+ * to every axis, scaled by the axis number and negated on y, so that an
+ * axis mixed up with another shows.
+ */
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    static int filter(QmSensorFilterChain &chain, int value) {
+        int x = value, y = -2 * value, z = 3 * value;
+        chain.apply(x, y, z);
+        if (y != -2 * x || z != 3 * x) {
+            qWarning("Axes filtered differently: %d %d %d", x, y, z);
+            return -1;
+        }
+        return x;
+    }
+
+private slots:
+    void testAdd() {
+        QmSensorFilterChain chain;
+
+        QVERIFY(!chain.add(QmSensor::FilterLowPass, 0));
+        QVERIFY(!chain.add(QmSensor::FilterHighPass, 1.5));
+        QVERIFY(!chain.add(QmSensor::FilterMedian, 4));
+        QVERIFY(!chain.add(QmSensor::FilterMedian, 2.5));
+        QVERIFY(!chain.add(QmSensor::FilterMedian, QMSENSOR_MAX_MEDIAN + 2));
+        QCOMPARE(chain.count(), 0);
+
+        for (int i = 0; i < QMSENSOR_MAX_FILTERS; i++) {
+            QVERIFY(chain.add(QmSensor::FilterLowPass, 1));
+        }
+        QVERIFY(!chain.add(QmSensor::FilterLowPass, 1));
+        QCOMPARE(chain.count(), QMSENSOR_MAX_FILTERS);
+
+        chain.clear();
+        QVERIFY(chain.isEmpty());
+    }
+
+    /* A single outlier never gets through a median of three */
+    void testMedianOutlier() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterMedian, 3));
+
+        const int samples[] = { 100, 100, 5000, 100, 100, 100 };
+        for (unsigned int i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+            QCOMPARE(filter(chain, samples[i]), 100);
+        }
+    }
+
+    /* The median follows a step once most of the window has it */
+    void testMedianStep() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterMedian, 5));
+
+        for (int i = 0; i < 5; i++) {
+            QCOMPARE(filter(chain, 0), 0);
+        }
+        QCOMPARE(filter(chain, 1000), 0);
+        QCOMPARE(filter(chain, 1000), 0);
+        QCOMPARE(filter(chain, 1000), 1000);
+    }
+
+    /* A constant signal is all slow part, nothing of it gets through */
+    void testHighPassConstant() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterHighPass, 0.1));
+
+        for (int i = 0; i < 100; i++) {
+            QCOMPARE(filter(chain, 981), 0);
+        }
+    }
+
+    /* After a step the output decays to zero as the state catches up */
+    void testHighPassStep() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterHighPass, 0.5));
+
+        QCOMPARE(filter(chain, 0), 0);
+        int expected = 1024;
+        for (int i = 0; i < 10; i++) {
+            expected /= 2;
+            QCOMPARE(filter(chain, 1024), expected);
+        }
+    }
+
+    /* With a share of one half, the output closes half of the gap to the
+       step with every sample: 500, 750, 875 and so on */
+    void testLowPassStep() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterLowPass, 0.5));
+
+        QCOMPARE(filter(chain, 0), 0);
+        int gap = 1024;
+        for (int i = 0; i < 10; i++) {
+            gap /= 2;
+            QCOMPARE(filter(chain, 1024), 1024 - gap);
+        }
+    }
+
+    /* The filters start over with the first sample after a reset */
+    void testReset() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterLowPass, 0.5));
+
+        QCOMPARE(filter(chain, 0), 0);
+        QCOMPARE(filter(chain, 1000), 500);
+        chain.reset();
+        QCOMPARE(filter(chain, 1000), 1000);
+    }
+
+    /* The median removes the outlier before the low-pass would smear it */
+    void testChain() {
+        QmSensorFilterChain chain;
+        QVERIFY(chain.add(QmSensor::FilterMedian, 3));
+        QVERIFY(chain.add(QmSensor::FilterLowPass, 0.5));
+
+        const int samples[] = { 100, 100, 5000, 100, 100 };
+        for (unsigned int i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+            QCOMPARE(filter(chain, samples[i]), 100);
+        }
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "sensorfilter.moc"
@@ -0,0 +1,8 @@
+QT -= gui
+
+TARGET = sensorfilter-test
+HEADERS += ../../system/qmsensorfilter_p.h
+SOURCES += sensorfilter.cpp \
+    ../../system/qmsensorfilter.cpp
+
+include(../common-install.pri)
@@ -0,0 +1,154 @@
+/**
+ * @file sensorhub.cpp
+ * @brief QmSensorHub tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QCoreApplication>
+#include <QObject>
+#include <QTest>
+
+#include "qmsensorhub_p.h"
+#include "qmsensortransform_p.h"
+
+using namespace MeeGo;
+
+/* Stands in for the session of sensord */
+class Source : public QObject
+{
+    Q_OBJECT
+
+public:
+    Source() : sent(0) {}
+
+    void send(int count) {
+        for (int i = 0; i < count; i++) {
+            sent++;
+            emit dataAvailable(XYZ(TimedXyzData(sent, sent, -sent, 0)));
+        }
+    }
+
+    int sent;
+
+Q_SIGNALS:
+    void dataAvailable(const XYZ& data);
+};
+
+/* Reads the hub into blocks like QmAccelerometerPrivate does */
+class Reader : public QObject
+{
+    Q_OBJECT
+
+public:
+    Reader(QmXYZHub &hub) : hub(hub), cursor(hub.ring.cursor()),
+                            samples(0), blocks(0), largest(0), ordered(true) {}
+
+    QmXYZHub &hub;
+    unsigned int cursor;
+    int samples;
+    int blocks;
+    int largest;
+    bool ordered;
+
+public Q_SLOTS:
+    void slotPublished() {
+        TimedXyzData sample;
+        while (hub.ring.read(cursor, sample)) {
+            if ((int)sample.timestamp_ != ++samples) {
+                ordered = false;
+            }
+            if (block.append(sample.timestamp_, sample.x_, sample.y_, sample.z_)) {
+                deliverBlock();
+            }
+        }
+        deliverBlock();
+    }
+
+private:
+    void deliverBlock() {
+        if (block.count > 0) {
+            blocks++;
+            largest = qMax(largest, block.count);
+            block.count = 0;
+        }
+    }
+
+    QmXYZBlock block;
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private:
+    QmXYZHub *hub;
+    Source *source;
+    Reader *reader;
+
+private slots:
+    void init() {
+        hub = new QmXYZHub();
+        source = new Source();
+        reader = new Reader(*hub);
+        QVERIFY(connect(source, SIGNAL(dataAvailable(const XYZ&)),
+                        hub, SLOT(publish(const XYZ&))));
+        QVERIFY(connect(hub, SIGNAL(published()), reader, SLOT(slotPublished())));
+    }
+
+    void cleanup() {
+        delete reader;
+        delete source;
+        delete hub;
+    }
+
+    void testBurst() {
+        // A burst is announced once it is over, as one block
+        source->send(10);
+        QCOMPARE(reader->samples, 0);
+        QCoreApplication::processEvents();
+        QCOMPARE(reader->samples, 10);
+        QCOMPARE(reader->blocks, 1);
+        QCOMPARE(reader->largest, 10);
+        QVERIFY(reader->ordered);
+    }
+
+    void testLongBurst() {
+        // A burst longer than the ring is announced in blocks without losses
+        source->send(QMSENSORHUB_RING_SIZE * 3 + 5);
+        QCoreApplication::processEvents();
+        QCOMPARE(reader->samples, QMSENSORHUB_RING_SIZE * 3 + 5);
+        QVERIFY(reader->largest > 1);
+        QVERIFY(reader->ordered);
+    }
+
+    void testSparse() {
+        // Samples that come one at a time are announced one at a time
+        for (int i = 1; i <= 3; i++) {
+            source->send(1);
+            QCoreApplication::processEvents();
+            QCOMPARE(reader->samples, i);
+            QCOMPARE(reader->blocks, i);
+        }
+        QCOMPARE(reader->largest, 1);
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "sensorhub.moc"
@@ -0,0 +1,11 @@
+QT += dbus
+QT -= gui
+
+CONFIG += link_pkgconfig
+equals(QT_MAJOR_VERSION, 4): PKGCONFIG += sensord
+equals(QT_MAJOR_VERSION, 5): PKGCONFIG += sensord-qt5
+
+TARGET = sensorhub-test
+SOURCES += sensorhub.cpp
+
+include(../common-install.pri)
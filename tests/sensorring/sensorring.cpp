@@ -0,0 +1,127 @@
+/**
+ * @file sensorring.cpp
+ * @brief QmSensorRing tests
+
+   <p>
+   Copyright (C) 2009-2011 Nokia Corporation
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+
+#include <QObject>
+#include <QThread>
+#include <QTest>
+
+#include "qmsensorring_p.h"
+
+using namespace MeeGo;
+
+/* Samples the writer thread publishes */
+static const int WRITER_SAMPLES = 1000000;
+
+class Writer : public QThread
+{
+public:
+    Writer(QmSensorRing<int> &ring) : ring(ring) {}
+
+protected:
+    void run() {
+        for (int i = 1; i <= WRITER_SAMPLES; i++) {
+            ring.push(i);
+        }
+    }
+
+private:
+    QmSensorRing<int> &ring;
+};
+
+class TestClass : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRead() {
+        QmSensorRing<int> ring;
+        unsigned int cursor = ring.cursor();
+        int sample = 0;
+
+        QVERIFY(!ring.read(cursor, sample));
+        for (int i = 1; i <= 10; i++) {
+            ring.push(i);
+        }
+        for (int i = 1; i <= 10; i++) {
+            QVERIFY(ring.read(cursor, sample));
+            QCOMPARE(sample, i);
+        }
+        QVERIFY(!ring.read(cursor, sample));
+    }
+
+    void testOverrun_data() {
+        QTest::addColumn<int>("pushed");
+        QTest::newRow("full") << QMSENSORHUB_RING_SIZE;
+        QTest::newRow("wrapped") << QMSENSORHUB_RING_SIZE * 3 + 5;
+    }
+
+    void testOverrun() {
+        QFETCH(int, pushed);
+        QmSensorRing<int> ring;
+        unsigned int cursor = ring.cursor();
+        int sample = 0;
+
+        for (int i = 1; i <= pushed; i++) {
+            ring.push(i);
+        }
+
+        // A reader that fell behind gets the samples still in the ring
+        int expected = pushed - QMSENSORHUB_RING_SIZE + 2;
+        for (; expected <= pushed; expected++) {
+            QVERIFY(ring.read(cursor, sample));
+            QCOMPARE(sample, expected);
+        }
+        QVERIFY(!ring.read(cursor, sample));
+    }
+
+    void testConcurrentWriter() {
+        QmSensorRing<int> ring;
+        unsigned int cursor = ring.cursor();
+        int sample = 0;
+        int previous = 0;
+        bool ordered = true;
+
+        Writer writer(ring);
+        writer.start();
+        for (;;) {
+            bool finished = writer.isFinished();
+            while (ring.read(cursor, sample)) {
+                // Lagging loses samples, but never reorders or repeats them
+                if (sample <= previous) {
+                    ordered = false;
+                }
+                previous = sample;
+            }
+            if (finished) {
+                break;
+            }
+        }
+        writer.wait();
+
+        QVERIFY(ordered);
+        QCOMPARE(previous, WRITER_SAMPLES);
+    }
+};
+
+QTEST_MAIN(TestClass)
+#include "sensorring.moc"
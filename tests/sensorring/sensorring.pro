@@ -0,0 +1,7 @@
+QT -= gui
+
+TARGET = sensorring-test
+HEADERS += ../../system/qmsensorring_p.h
+SOURCES += sensorring.cpp
+
+include(../common-install.pri)
@@ -11,13 +11,24 @@ SUBDIRS = accelerometer \
           compass \
           devicemode \
           displaystate \
+          fusion \
+          fusionfilter \
           heartbeat \
           hw_keys \
+          keyd_load \
+          keyd_benchmark \
+          keydprotocol \
+          keys_legacy \
+          keytranslator \
           led \
           locks \
           orientation \
           proximity \
           rotation \
+          sensor_transform_benchmark \
+          sensorring \
+          sensorhub \
+          sensorfilter \
           magnetometer \
           system \
           systeminformation \
@@ -44,7 +55,10 @@ SUBDIRS = accelerometer \
 
 linux-g++-maemo {
     SUBDIRS += battery \
+               bme_mock \
+               battery_benchmark \
                thermal
+    battery_benchmark.depends = bme_mock
 }
 
 # Test definition installation